@@ -0,0 +1,129 @@
+#ifndef _BENCH
+#define _BENCH
+
+/*
+Minimal harness for the microbenchmarks in this directory.
+
+bench_run() calls a function in batches large enough for the clock to be
+accurate, times many batches and reports the mean, median and tail time per
+call, and on x86 the time stamp counter cycles per processed sample. Results
+are printed as a table, and appended as one JSON object per line to the file
+named by the BENCH_JSON environment variable, so that results of two builds can
+be diffed.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_CYCLES 1
+#else
+#define BENCH_HAS_CYCLES 0
+#endif
+
+// Amount of timed batches per benchmark.
+#define BENCH_RUNS 200
+// Shortest time of a batch in nanoseconds, so clock overhead stays negligible.
+#define BENCH_MIN_BATCH_TIME 50000.0
+// Time spent calling the function before timing, in nanoseconds.
+#define BENCH_WARMUP_TIME 50000000.0
+
+typedef void (*BenchFunction)(void *context);
+
+typedef struct {
+    // Nanoseconds per call.
+    double mean;
+    double p50;
+    double p95;
+    double p99;
+    // Time stamp counter cycles per sample, 0 if not known.
+    double cycles_per_sample;
+    uint32_t batch;
+} BenchResult;
+
+// Results write here so that the compiler keeps the benchmarked work.
+static volatile float bench_sink;
+
+static inline double bench_now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+static inline uint64_t bench_cycles(void) {
+#if BENCH_HAS_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static int bench_compare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Times `function` and reports it as `name`. Each call processes
+// `samples_per_call` audio samples, used for cycles per sample.
+static BenchResult bench_run(const char *name, BenchFunction function,
+                             void *context, size_t samples_per_call) {
+    BenchResult result = {.batch = 1};
+
+    double start = bench_now();
+    uint64_t calls = 0;
+    while (bench_now() - start < BENCH_WARMUP_TIME) {
+        function(context);
+        calls++;
+    }
+    double call_time = (bench_now() - start) / calls;
+    while (result.batch * call_time < BENCH_MIN_BATCH_TIME)
+        result.batch *= 2;
+
+    static double times[BENCH_RUNS];
+    uint64_t cycles = 0;
+    for (size_t run = 0; run < BENCH_RUNS; run++) {
+        uint64_t cycles_start = bench_cycles();
+        double run_start = bench_now();
+        for (uint32_t i = 0; i < result.batch; i++)
+            function(context);
+        times[run] = (bench_now() - run_start) / result.batch;
+        cycles += bench_cycles() - cycles_start;
+        result.mean += times[run] / BENCH_RUNS;
+    }
+
+    qsort(times, BENCH_RUNS, sizeof(double), bench_compare);
+    result.p50 = times[BENCH_RUNS / 2];
+    result.p95 = times[BENCH_RUNS * 95 / 100];
+    result.p99 = times[BENCH_RUNS * 99 / 100];
+    if (BENCH_HAS_CYCLES && samples_per_call)
+        result.cycles_per_sample =
+            (double)cycles / ((double)BENCH_RUNS * result.batch) /
+            samples_per_call;
+
+    printf("%-28s %10.0f ns/op  p50 %10.0f  p95 %10.0f  p99 %10.0f", name,
+           result.mean, result.p50, result.p95, result.p99);
+    if (result.cycles_per_sample)
+        printf("  %7.2f cycles/sample", result.cycles_per_sample);
+    printf("\n");
+
+    const char *json_path = getenv("BENCH_JSON");
+    FILE *json = json_path ? fopen(json_path, "a") : 0;
+    if (json) {
+        fprintf(json,
+                "{\"name\": \"%s\", \"ns_per_op\": %.1f, \"p50\": %.1f, "
+                "\"p95\": %.1f, \"p99\": %.1f, \"samples_per_op\": %zu, "
+                "\"cycles_per_sample\": %.3f, \"batch\": %u, "
+                "\"runs\": %d}\n",
+                name, result.mean, result.p50, result.p95, result.p99,
+                samples_per_call, result.cycles_per_sample, result.batch,
+                BENCH_RUNS);
+        fclose(json);
+    }
+
+    return result;
+}
+
+#endif
@@ -0,0 +1,231 @@
+/*
+Microbenchmarks of the analysis hot path: the FFT at each supported size, next
+to the FFTPACK transform it replaces for power of two sizes, the windowing, the
+band reduction, the harmony estimation, the constant-Q transform, the loudness
+metering of fed frames, and a whole hop through analyze_feed_frames() and
+analyze_get_metrics() at common settings.
+*/
+
+#include "analyze.h"
+#include "bands.h"
+#include "bench.h"
+#include "cqt.h"
+#include "dsp.h"
+#include "fft.h"
+#include "harmony.h"
+#include "loudness.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_RATE 48000
+#define CHANNELS 2
+
+typedef struct {
+    FFTTransformer *transformer;
+    const float *window;
+    const float *input;
+    float *buffer;
+    size_t size;
+} TransformContext;
+
+typedef struct {
+    const BandLayout *layout;
+    const float *spectrum;
+    float *bands;
+} BandContext;
+
+typedef struct {
+    HarmonyEstimator estimator;
+    const float *spectrum;
+    Harmony harmony;
+} HarmonyContext;
+
+typedef struct {
+    float *frames;
+    uint32_t hop_size;
+} PipelineContext;
+
+static float signal[MAX_INPUT_SIZE * CHANNELS];
+static AudioMetrics metrics;
+
+// A chord with a little noise, so the spectrum is neither empty nor flat.
+static void fill_signal(void) {
+    for (size_t i = 0; i < MAX_INPUT_SIZE * CHANNELS; i++) {
+        float t = (float)(i / CHANNELS) / SAMPLE_RATE;
+        signal[i] = 0.3 * sinf(2 * M_PI * 110 * t) +
+                    0.2 * sinf(2 * M_PI * 440 * t) +
+                    0.1 * sinf(2 * M_PI * 3520 * t) +
+                    (rand() / (float)RAND_MAX - 0.5) * 0.05;
+    }
+}
+
+// The transform works in place, so the input is copied first.
+static void bench_fft(void *context) {
+    TransformContext *c = context;
+    memcpy(c->buffer, c->input, c->size * sizeof(float));
+    fft_forward(c->transformer, c->buffer);
+    bench_sink = c->buffer[1];
+}
+
+// The FFTPACK transform that fft_forward() uses for sizes without a plan.
+static void bench_fftpack(void *context) {
+    TransformContext *c = context;
+    memcpy(c->buffer, c->input, c->size * sizeof(float));
+    __fft_real_forward(c->size, c->buffer, c->transformer->wsave,
+                       c->transformer->ifac);
+    for (size_t i = 0; i < c->size; i++)
+        c->buffer[i] /= c->size;
+    bench_sink = c->buffer[1];
+}
+
+static void bench_window(void *context) {
+    TransformContext *c = context;
+    dsp_apply_window(c->buffer, c->input, c->window, c->size);
+    bench_sink = c->buffer[1];
+}
+
+static void bench_bands(void *context) {
+    BandContext *c = context;
+    bands_apply(c->layout, c->spectrum, c->bands);
+    bench_sink = c->bands[0];
+}
+
+static void bench_harmony(void *context) {
+    HarmonyContext *c = context;
+    harmony_process(&c->estimator, c->spectrum, &c->harmony);
+    bench_sink = c->harmony.chroma[0];
+}
+
+// One hop of new audio and a transform of the history.
+static void bench_cqt(void *context) {
+    ConstantQ *cqt = context;
+    static float bins[MAX_CQT_BINS];
+    cqt_feed(cqt, signal, DEFAULT_HOP_SIZE, CHANNELS);
+    cqt_process(cqt, bins);
+    bench_sink = bins[0];
+}
+
+static void bench_loudness(void *context) {
+    LoudnessMeter *meter = context;
+    loudness_feed(meter, signal, DEFAULT_HOP_SIZE, CHANNELS);
+    bench_sink = meter->block_peak;
+}
+
+static void bench_pipeline(void *context) {
+    PipelineContext *c = context;
+    analyze_feed_frames(c->frames, c->hop_size, CHANNELS);
+    analyze_get_metrics(&metrics);
+    bench_sink = metrics.frequencies[1];
+}
+
+int main(void) {
+    fill_signal();
+    float *buffer = malloc(MAX_INPUT_SIZE * sizeof(float));
+    if (!buffer)
+        abort();
+    char name[64];
+
+    for (size_t size = MIN_INPUT_SIZE; size <= MAX_INPUT_SIZE; size *= 2) {
+        TransformContext context = {
+            .transformer = create_fft_transformer(size, FFT_SCALED_OUTPUT),
+            .input = signal,
+            .buffer = buffer,
+            .size = size,
+        };
+        snprintf(name, sizeof(name), "fft_forward/%zu", size);
+        bench_run(name, bench_fft, &context, size);
+        snprintf(name, sizeof(name), "fftpack/%zu", size);
+        bench_run(name, bench_fftpack, &context, size);
+        free_fft_transformer(context.transformer);
+    }
+
+    for (size_t size = 1024; size <= 4096; size *= 4) {
+        float *window = dsp_window_create(HANNING, size);
+        if (!window)
+            abort();
+        TransformContext context = {
+            .window = window,
+            .input = signal,
+            .buffer = buffer,
+            .size = size,
+        };
+        snprintf(name, sizeof(name), "window/%zu", size);
+        bench_run(name, bench_window, &context, size);
+        free(window);
+    }
+
+    const uint32_t frequency_count = DEFAULT_INPUT_SIZE / 2;
+    const float resolution = (float)SAMPLE_RATE / DEFAULT_INPUT_SIZE;
+    float spectrum[DEFAULT_INPUT_SIZE / 2];
+    dsp_magnitudes(spectrum, signal, frequency_count);
+    BandLayout log_bands, mel_bands, third_octave_bands;
+    if (bands_create_log(&log_bands, DEFAULT_LOG_BAND_COUNT,
+                         BANDS_MIN_FREQUENCY, BANDS_MAX_FREQUENCY,
+                         frequency_count, resolution) ||
+        bands_create_mel(&mel_bands, DEFAULT_MEL_BAND_COUNT,
+                         BANDS_MIN_FREQUENCY, BANDS_MAX_FREQUENCY,
+                         frequency_count, resolution) ||
+        bands_create_third_octave(&third_octave_bands, frequency_count,
+                                  resolution))
+        return 1;
+    float bands[MAX_BANDS];
+    BandContext band_contexts[] = {
+        {&log_bands, spectrum, bands},
+        {&mel_bands, spectrum, bands},
+        {&third_octave_bands, spectrum, bands},
+    };
+    bench_run("bands/log", bench_bands, &band_contexts[0], frequency_count);
+    bench_run("bands/mel", bench_bands, &band_contexts[1], frequency_count);
+    bench_run("bands/third_octave", bench_bands, &band_contexts[2],
+              frequency_count);
+
+    HarmonyContext harmony_context = {.spectrum = spectrum};
+    if (harmony_init(&harmony_context.estimator, frequency_count, resolution,
+                     (float)DEFAULT_HOP_SIZE / SAMPLE_RATE))
+        return 1;
+    bench_run("harmony", bench_harmony, &harmony_context, frequency_count);
+    harmony_free(&harmony_context.estimator);
+    bands_free(&log_bands);
+    bands_free(&mel_bands);
+    bands_free(&third_octave_bands);
+
+    for (uint32_t bins_per_octave = 12; bins_per_octave <= 24;
+         bins_per_octave *= 2) {
+        ConstantQ cqt;
+        if (cqt_init(&cqt, bins_per_octave, bins_per_octave * CQT_OCTAVES,
+                     CQT_MIN_FREQUENCY, SAMPLE_RATE))
+            return 1;
+        snprintf(name, sizeof(name), "cqt/%u", bins_per_octave);
+        bench_run(name, bench_cqt, &cqt, DEFAULT_HOP_SIZE);
+        cqt_free(&cqt);
+    }
+
+    static LoudnessMeter meter;
+    if (loudness_init(&meter, CHANNELS, SAMPLE_RATE))
+        return 1;
+    bench_run("loudness", bench_loudness, &meter, DEFAULT_HOP_SIZE);
+
+    const uint32_t input_sizes[] = {1024, 4096};
+    for (size_t i = 0; i < sizeof(input_sizes) / sizeof(*input_sizes); i++) {
+        AnalyzeConfig config = {
+            .window = HANNING,
+            .input_size = input_sizes[i],
+            .hop_size = input_sizes[i] / 2,
+            .channels = CHANNELS,
+            .log_band_count = DEFAULT_LOG_BAND_COUNT,
+            .mel_band_count = DEFAULT_MEL_BAND_COUNT,
+        };
+        analyze_init(&config);
+        analyze_set_sample_rate(SAMPLE_RATE);
+        PipelineContext context = {signal, config.hop_size};
+        snprintf(name, sizeof(name), "analyze_hop/%u", config.input_size);
+        bench_run(name, bench_pipeline, &context, config.hop_size);
+        analyze_deinit();
+    }
+
+    free(buffer);
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*
+Microbenchmark of the windowing and magnitude stage of analyze_get_metrics(),
+comparing the previous per-sample cosf() and double precision sqrt()
+implementation with the window table and vectorized kernels in dsp.c.
+*/
+
+#include "dsp.h"
+#include "fft.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define INPUT_SIZE 1024
+#define BIN_COUNT (INPUT_SIZE / 2)
+#define ITERATIONS 20000
+
+static float samples[INPUT_SIZE];
+static float buffer[INPUT_SIZE];
+static float magnitudes[BIN_COUNT];
+
+static inline double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+static inline float hanning(int i, int nn) {
+    return (0.5 * (1.0 - cosf(2.0 * M_PI * (float)i / (float)(nn - 1))));
+}
+
+static float before(void) {
+    for (size_t i = 0; i < INPUT_SIZE; i++)
+        buffer[i] = samples[i] * hanning(i, INPUT_SIZE);
+
+    float maximum = 0.001;
+    for (size_t i = 0; i < BIN_COUNT; i++) {
+        float cos_comp = buffer[i * 2];
+        float sin_comp = buffer[i * 2 + 1];
+        float mag = sqrt((cos_comp * cos_comp) + (sin_comp * sin_comp));
+        magnitudes[i] = mag / maximum;
+        if (maximum < mag)
+            maximum = mag;
+    }
+    return magnitudes[BIN_COUNT - 1];
+}
+
+static float after(const float *window) {
+    dsp_apply_window(buffer, samples, window, INPUT_SIZE);
+    float maximum = dsp_magnitudes(magnitudes, buffer, BIN_COUNT);
+    dsp_scale(magnitudes, BIN_COUNT, 1.0 / maximum);
+    return magnitudes[BIN_COUNT - 1];
+}
+
+int main(void) {
+    for (size_t i = 0; i < INPUT_SIZE; i++)
+        samples[i] = sinf(i * 0.05) + (rand() / (float)RAND_MAX - 0.5) * 0.1;
+
+    float *window = dsp_window_create(HANNING, INPUT_SIZE);
+    if (!window)
+        return 1;
+
+    // Keeps the compiler from optimizing the loops away
+    volatile float sink = 0;
+
+    double start = now();
+    for (size_t i = 0; i < ITERATIONS; i++)
+        sink += before();
+    double before_ns = (now() - start) / ITERATIONS;
+
+    start = now();
+    for (size_t i = 0; i < ITERATIONS; i++)
+        sink += after(window);
+    double after_ns = (now() - start) / ITERATIONS;
+
+    printf("window + magnitudes (%d samples)\n", INPUT_SIZE);
+    printf("  before: %8.0f ns/frame\n", before_ns);
+    printf("  after:  %8.0f ns/frame\n", after_ns);
+    printf("  speedup: %.1fx\n", before_ns / after_ns);
+
+    free(window);
+    (void)sink;
+    return 0;
+}
@@ -33,6 +33,8 @@
 #ifndef _fft_h
 #define _fft_h
 
+#include "fft_pow2.h"
+
 #include <stdlib.h>
 
 #ifdef __cplusplus
@@ -56,6 +58,7 @@ typedef struct {
     FFT_PRECISION *wsave;
     int *ifac;
     int scale_output; // 1 for scale and 0 for not scale
+    FFTPow2Plan *pow2; // forward transforms of power of two sizes, or 0
 
 } FFTTransformer;
 
@@ -1583,17 +1583,33 @@ FFTTransformer *create_fft_transformer(int signal_length, int scale_output) {
         transformer->scale_output = FFT_UNSCALED_OUTPUT;
 
     __fft_real_init(transformer->n, transformer->wsave, transformer->ifac);
+#if USE_DOUBLE_PRECISION
+    transformer->pow2 = 0;
+#else
+    transformer->pow2 = fft_pow2_create(signal_length);
+#endif
 
     return transformer;
 }
 
 void free_fft_transformer(FFTTransformer *transformer) {
+    fft_pow2_free(transformer->pow2);
     free(transformer->wsave);
     free(transformer->ifac);
     free(transformer);
 }
 
 void fft_forward(FFTTransformer *transformer, FFT_PRECISION *input) {
+#if !USE_DOUBLE_PRECISION
+    if (transformer->pow2) {
+        fft_pow2_forward(transformer->pow2, input,
+                         transformer->scale_output == FFT_SCALED_OUTPUT
+                             ? 1.0f / transformer->n
+                             : 1.0f);
+        return;
+    }
+#endif
+
     __fft_real_forward(transformer->n, input, transformer->wsave,
                        transformer->ifac);
     // Rescale output for valid region
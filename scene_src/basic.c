@@ -25,8 +25,12 @@ https://github.com/TatuLaras/firewatch?tab=readme-ov-file#load-files-from-curren
 // included.
 #include "scene_common.h"
 
+#include <string.h>
+
 #define LINE_WIDTH 3
 
+static float bg_whiteness = 0;
+
 // For every visualization, the following three functions need to be defined.
 
 // Runs when your visualization is loaded.
@@ -39,29 +43,66 @@ int scene_init(void) {
 // Here you can initialize things that your visualization needs.
 void scene_deinit(void) {}
 
+// The next two functions are optional. When your visualization is reloaded
+// after a change, they carry its state over to the new version, so that
+// animations continue where they were instead of starting over.
+
+// Runs before the old version is unloaded. Write at most `size` bytes into
+// `out_state` and return how many you wrote.
+size_t scene_save_state(void *out_state, size_t size) {
+    if (size < sizeof(bg_whiteness))
+        return 0;
+    memcpy(out_state, &bg_whiteness, sizeof(bg_whiteness));
+    return sizeof(bg_whiteness);
+}
+
+// Runs after scene_init() of the new version with what the old one wrote.
+// Check `size` in case the state has changed between versions.
+void scene_restore_state(const void *state, size_t size) {
+    if (size == sizeof(bg_whiteness))
+        memcpy(&bg_whiteness, state, size);
+}
+
 /*
 Runs each frame.
-Draw your visualization here.
+Draw your visualization here. Muscini calls BeginDrawing() before and
+EndDrawing() after this, so do not call them yourself.
 
 The param `metrics` contains the musical information that you can utilize in
 your visualization.
 
 typedef struct {
-    // Relative amplitudes of frequencies in the signal.
-    float frequencies[FREQUENCY_COUNT];
+    // Relative amplitudes of frequencies in the signal. Only the first
+    // `frequency_count` values are used.
+    float frequencies[MAX_FREQUENCY_COUNT];
+    // Amount of used values in `frequencies`.
+    uint32_t frequency_count;
+    // Width of each frequency bin in Hz, see analyze_bin_frequency().
+    float frequency_resolution;
+    // Levels of log-spaced bands and of the whole signal between 0.0 and 1.0,
+    // already smoothed with attack and release times in milliseconds, so they
+    // look the same at any frame rate.
+    float band_envelopes[MAX_BANDS];
+    uint32_t log_band_count;
+    float level_envelope;
+    // Strength of kick, snare and hi-hat onsets, indexed by ONSET_KICK,
+    // ONSET_SNARE and ONSET_HAT. Between 0.0 (no onset) and 1.0.
+    float onsets[ONSET_BAND_COUNT];
+    // MIDI notes and onsets since the previous frame, with their offset in
+    // seconds from the frame, see sc_beat_decay() in scene_common.h.
+    FrameEvent events[MAX_FRAME_EVENTS];
+    uint32_t event_count;
     // Will be 1.0 if a beat has just occurred, otherwise 0.0.
     float beat;
 } AudioMetrics;
 
+The size of the FFT is configurable from the command line, so use
+`frequency_count` instead of assuming a fixed amount of frequencies.
+
 */
 void scene_update(AudioMetrics *metrics) {
-
-    // Remember to draw between BeingDrawing() and EndDrawing()
-    BeginDrawing();
-
     // Flash background with white on each "beat", with some fade out time.
-    static float bg_whiteness = 0;
-    sc_decay(&bg_whiteness, metrics->beat, 0.25);
+    sc_beat_decay(&bg_whiteness, metrics, 0.25);
 
     ClearBackground((Color){bg_whiteness * 255, bg_whiteness * 255,
                             bg_whiteness * 255, 255});
@@ -71,7 +112,7 @@ void scene_update(AudioMetrics *metrics) {
     uint32_t screen_height = GetScreenHeight();
     float horizontal = 0;
 
-    for (uint16_t i = 0; i < FREQUENCY_COUNT; i++) {
+    for (uint16_t i = 0; i < metrics->frequency_count; i++) {
 
         horizontal += LINE_WIDTH;
 
@@ -80,6 +121,4 @@ void scene_update(AudioMetrics *metrics) {
                    (Vector2){horizontal, screen_height}, LINE_WIDTH,
                    (Color){240, 20, 20, 255});
     }
-
-    EndDrawing();
 }
@@ -121,13 +121,11 @@ void scene_update(AudioMetrics *metrics) {
             (Vector2){0}, 0, WHITE);
         EndShaderMode();
     }
-    EndTextureMode();
+    sc_end_texture_mode();
 
-    BeginDrawing();
     DrawTexturePro(scene_render_target.texture,
                    (Rectangle){.width = scene_render_target.texture.width,
                                .height = scene_render_target.texture.height},
                    (Rectangle){.width = screen_width, .height = screen_height},
                    (Vector2){0}, 0, WHITE);
-    EndDrawing();
 }
@@ -9,13 +9,16 @@
 #include <stdint.h>
 #include <stdio.h>
 
+// Size of the frequencies array in rabbit_hole/main.frag
+#define SHADER_FREQUENCY_COUNT 512
+
 static Shader shader = {0};
 static Texture texture = {0};
 static int loc_screen_width = 0;
 static int loc_screen_height = 0;
 static int loc_time = 0;
 static int loc_beat = 0;
-static int frequencies_locs[FREQUENCY_COUNT] = {0};
+static int frequencies_locs[SHADER_FREQUENCY_COUNT] = {0};
 
 static inline void load_shader(const char *filepath, uint64_t cookie) {
     if (shader.id)
@@ -32,7 +35,7 @@ static inline void load_shader(const char *filepath, uint64_t cookie) {
     loc_time = GetShaderLocation(shader, "time");
     loc_beat = GetShaderLocation(shader, "progress");
 
-    for (size_t i = 0; i < FREQUENCY_COUNT; i++) {
+    for (size_t i = 0; i < SHADER_FREQUENCY_COUNT; i++) {
         frequencies_locs[i] =
             GetShaderLocation(shader, TextFormat("frequencies[%i]", i));
     }
@@ -82,15 +85,16 @@ void scene_update(AudioMetrics *metrics) {
     static float beat = 0;
     sc_decay(&beat, metrics->beat, 0.8);
 
-    progress = fmod(progress + beat, 100);
+    // Advances by `beat` 60 times a second whatever the frame rate
+    progress = fmod(progress + beat * 60 * GetFrameTime(), 100);
     SetShaderValue(shader, loc_beat, &progress, SHADER_UNIFORM_FLOAT);
 
-    for (uint16_t i = 0; i < FREQUENCY_COUNT; i++) {
+    for (uint16_t i = 0;
+         i < SHADER_FREQUENCY_COUNT && i < metrics->frequency_count; i++) {
         SetShaderValue(shader, frequencies_locs[i], metrics->frequencies + i,
                        SHADER_UNIFORM_FLOAT);
     }
 
-    BeginDrawing();
     ClearBackground(BLACK);
     if (shader.id) {
         BeginShaderMode(shader);
@@ -101,5 +105,4 @@ void scene_update(AudioMetrics *metrics) {
             (Vector2){0}, 0, WHITE);
         EndShaderMode();
     }
-    EndDrawing();
 }
@@ -2,55 +2,102 @@
 #define _SCENE_COMMON
 
 #include "analyze.h"
+#include "profiler.h"
+#include "scenes.h"
 #include <assert.h>
+#include <math.h>
 #include <raylib.h>
 #include <stdint.h>
 
 #define RESOURCE(path) "scene_src/" path
 
-// Average relative amplitude of a range of frequencies (index).
+// Profiles the rest of the enclosing block as the scope `name`, which shows up
+// in traces written with `muscini --trace`, e.g.
+//
+//     {
+//         SC_PROFILE_SCOPE("particles");
+//         update_particles();
+//     }
+#define SC_PROFILE_SCOPE(name) PROFILE_SCOPE(name)
+
+// Ends drawing into a render texture of the scene and goes back to drawing the
+// frame. Use this instead of EndTextureMode() before drawing to the screen,
+// so that the scene also shows up while crossfaded (see scenes.h).
+static inline void sc_end_texture_mode(void) { scenes_end_texture_mode(); }
+
+// Average relative amplitude of a range of frequencies (index), inclusive.
 // Useful for e.g. determing how much bass, mid-range or treble frequencies the
-// audio contains.
-static inline float sc_range_average(float *frequencies, uint16_t from_i,
-                                     uint16_t to_i) {
-    assert(from_i < FREQUENCY_COUNT);
-    assert(to_i < FREQUENCY_COUNT);
-    if (from_i >= FREQUENCY_COUNT || to_i >= FREQUENCY_COUNT)
+// audio contains. Constant time regardless of the size of the range.
+static inline float sc_bin_range_average(AudioMetrics *metrics,
+                                         uint16_t from_i, uint16_t to_i) {
+    assert(from_i <= to_i);
+    assert(to_i < metrics->frequency_count);
+    if (from_i > to_i || to_i >= metrics->frequency_count)
+        return 0;
+
+    return (metrics->frequency_sums[to_i + 1] -
+            metrics->frequency_sums[from_i]) /
+           (to_i - from_i + 1);
+}
+
+// Same as sc_bin_range_average(), but with the range given in Hz.
+static inline float sc_frequency_range_average(AudioMetrics *metrics,
+                                               float from_hz, float to_hz) {
+    return sc_bin_range_average(metrics,
+                                analyze_frequency_bin(metrics, from_hz),
+                                analyze_frequency_bin(metrics, to_hz));
+}
+
+// Deprecated, kept for scenes written before sc_bin_range_average(), which
+// takes the whole AudioMetrics and does not loop over the range.
+__attribute__((deprecated("use sc_bin_range_average()"))) static inline float
+sc_range_average(float *frequencies, uint16_t from_i, uint16_t to_i) {
+    assert(from_i <= to_i);
+    assert(to_i < MAX_FREQUENCY_COUNT);
+    if (from_i > to_i || to_i >= MAX_FREQUENCY_COUNT)
         return 0;
 
     float sum = 0;
-    const float multiplier = 1.0 / (to_i - from_i + 1);
-    for (uint16_t i = from_i; i <= to_i; i++) {
-        sum += frequencies[i] * multiplier;
-    }
-    return sum;
+    for (uint16_t i = from_i; i <= to_i; i++)
+        sum += frequencies[i];
+    return sum / (to_i - from_i + 1);
 }
 
-// Loudest relative amplitude in a range of frequencies (index).
-static inline size_t
-sc_range_loudest_frequency(float *frequencies, uint16_t from_i, uint16_t to_i) {
-    assert(from_i < FREQUENCY_COUNT);
-    assert(to_i < FREQUENCY_COUNT);
-    if (from_i >= FREQUENCY_COUNT || to_i >= FREQUENCY_COUNT)
+// Position of the loudest relative amplitude in a range of frequencies
+// (index), from 0.0 at `from_i` to 1.0 at `to_i`. Higher frequencies are
+// weighted more to make up for their usually lower amplitude.
+static inline float sc_range_loudest_frequency(float *frequencies,
+                                               uint16_t from_i,
+                                               uint16_t to_i) {
+    assert(from_i < to_i);
+    assert(to_i < MAX_FREQUENCY_COUNT);
+    if (from_i >= to_i || to_i >= MAX_FREQUENCY_COUNT)
         return 0;
 
     float max = 0;
-    size_t max_i = 0;
+    size_t max_i = from_i;
     for (uint16_t i = from_i; i <= to_i; i++) {
         if (max < frequencies[i] * i) {
             max = frequencies[i] * i;
             max_i = i;
         }
     }
-    return max_i / (to_i - from_i);
+    return (float)(max_i - from_i) / (to_i - from_i);
+}
+
+// Moves `out_value` towards `new` by about two thirds of the way every `time`
+// seconds, whatever the frame rate. Basically a low-pass filter, useful for
+// smoothing out jittery values. Band levels are already smoothed this way in
+// `band_envelopes` and `level_envelope` of AudioMetrics.
+static inline void sc_smooth(float *out_value, float new, float time) {
+    *out_value += (new - *out_value) * (1 - expf(-GetFrameTime() / time));
 }
 
-// Takes a rolling average with window size of `window` of values in `new`, and
-// writes that average into `out_value`. Basically a low-pass filter, useful for
-// smoothing out jittery values.
-static inline void sc_rolling_average(float *out_value, float new,
-                                      float window) {
-    *out_value = (*out_value) * (window - 1) / window + new / window;
+// Deprecated, kept for scenes written before sc_smooth(). Smooths over about
+// `window` frames at 60 frames per second, whatever the actual frame rate.
+__attribute__((deprecated("use sc_smooth()"))) static inline void
+sc_rolling_average(float *out_value, float new, float window) {
+    sc_smooth(out_value, new, window / 60.0f);
 }
 
 // Instantly reacts to new values of `new`, but only reducing the value
@@ -62,4 +109,20 @@ static inline void sc_decay(float *out_value, float new, float time) {
         *out_value -= (1.0 / time) * GetFrameTime();
 }
 
+// Like sc_decay() for beats, but each beat starts decaying from the moment it
+// occurred within the frame rather than from the frame itself, so that flashes
+// keep the timing of the music regardless of the frame rate.
+static inline void sc_beat_decay(float *out_value, AudioMetrics *metrics,
+                                 float time) {
+    sc_decay(out_value, 0, time);
+    for (uint32_t i = 0; i < metrics->event_count; i++) {
+        if (!metrics->events[i].beat)
+            continue;
+        // The offset is negative for events before the frame
+        float value = 1.0 + metrics->events[i].offset / time;
+        if (value > *out_value)
+            *out_value = value;
+    }
+}
+
 #endif
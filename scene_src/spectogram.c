@@ -12,8 +12,9 @@
 static uint32_t row = 0;
 static uint8_t hold = 0;
 static uint8_t slice_mode = 0;
+// Amount of frequencies in the metrics the image was created for.
+static uint32_t frequency_count = 0;
 static Image image = {
-    .width = FREQUENCY_COUNT,
     .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
     .mipmaps = 1,
 };
@@ -22,7 +23,7 @@ static float max = 0;
 static float cut_height = 0;
 static uint8_t slice_line_width = 2;
 
-static float frozen_frequencies[FREQUENCY_COUNT] = {0};
+static float frozen_frequencies[MAX_FREQUENCY_COUNT] = {0};
 static float frozen_max = 0;
 
 int scene_init(void) {
@@ -47,11 +48,15 @@ void scene_update(AudioMetrics *metrics) {
     uint32_t screen_height = GetScreenHeight();
     uint32_t screen_width = GetScreenWidth();
 
-    if (!image.data || IsWindowResized()) {
+    if (!image.data || IsWindowResized() ||
+        frequency_count != metrics->frequency_count) {
         if (image.data)
             free(image.data);
-        image.data = (uint32_t *)calloc(1, FREQUENCY_COUNT * screen_width *
+        frequency_count = metrics->frequency_count;
+        image.width = frequency_count;
+        image.data = (uint32_t *)calloc(1, frequency_count * screen_width *
                                                sizeof(uint32_t));
+        row = 0;
         image.height = screen_width - 1;
 
         if (texture.id)
@@ -65,7 +70,7 @@ void scene_update(AudioMetrics *metrics) {
         hold = !hold;
         frozen_max = max;
         memcpy(frozen_frequencies, metrics->frequencies,
-               FREQUENCY_COUNT * sizeof(float));
+               frequency_count * sizeof(float));
     }
 
     if (IsKeyPressed(KEY_C)) {
@@ -73,7 +78,7 @@ void scene_update(AudioMetrics *metrics) {
         if (cut_height > 0)
             cut_height = 0;
         else
-            cut_height = ((mouse.y) / screen_height) * FREQUENCY_COUNT;
+            cut_height = ((mouse.y) / screen_height) * frequency_count;
     }
 
     if (IsKeyPressed(KEY_S))
@@ -92,23 +97,21 @@ void scene_update(AudioMetrics *metrics) {
 
     if (!hold) {
         max = 0;
-        for (uint32_t i = 0; i < FREQUENCY_COUNT; i++)
+        for (uint32_t i = 0; i < frequency_count; i++)
             if (max < metrics->frequencies[i])
                 max = metrics->frequencies[i];
 
-        for (uint32_t x = 0; x < FREQUENCY_COUNT; x++) {
-            ((uint32_t *)image.data)[row * FREQUENCY_COUNT + x] =
+        for (uint32_t x = 0; x < frequency_count; x++) {
+            ((uint32_t *)image.data)[row * frequency_count + x] =
                 intensity_color(metrics->frequencies[x]);
         }
         row = (row + 1) % (image.height);
         UpdateTexture(texture, image.data);
     }
 
-    BeginDrawing();
-
     ClearBackground(BLACK);
 
-    for (uint16_t i = 0; i < FREQUENCY_COUNT; i++) {
+    for (uint16_t i = 0; i < frequency_count; i++) {
         if (slice_mode) {
             float *slice;
             float maximum = max;
@@ -153,6 +156,4 @@ void scene_update(AudioMetrics *metrics) {
         DrawTexturePro(texture, src, dest, (Vector2){0}, -90, WHITE);
         DrawTexturePro(texture, src_left, dest_left, (Vector2){0}, -90, WHITE);
     }
-
-    EndDrawing();
 }
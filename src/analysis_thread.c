@@ -0,0 +1,106 @@
+#include "analysis_thread.h"
+#include "profiler.h"
+#include "triple_buffer.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define NANOSECONDS_IN_SECOND 1000000000L
+
+static AudioMetrics buffers[3] = {0};
+static TripleBuffer metrics_buffer = {0};
+// Metrics kept up to date by the analysis thread, since analyze_get_metrics()
+// only updates the frequencies when there was a new hop to process.
+static AudioMetrics working_metrics = {0};
+
+// Where results are published, if anywhere.
+static MetricsShm *publish_shm = 0;
+
+static pthread_t thread_id = 0;
+static _Atomic int running = 0;
+static long period = 0;
+
+static inline void advance(struct timespec *time, long nanoseconds) {
+    time->tv_nsec += nanoseconds;
+    while (time->tv_nsec >= NANOSECONDS_IN_SECOND) {
+        time->tv_nsec -= NANOSECONDS_IN_SECOND;
+        time->tv_sec++;
+    }
+}
+
+static inline int is_before(struct timespec *a, struct timespec *b) {
+    return a->tv_sec < b->tv_sec ||
+           (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+static void *analysis_loop(void *arg) {
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    profiler_set_thread_name("analysis");
+
+    while (atomic_load_explicit(&running, memory_order_relaxed)) {
+        uint64_t begin = profiler_begin();
+        uint32_t hops = analyze_get_metrics(&working_metrics);
+        profiler_end("analyze_get_metrics", begin);
+        if (publish_shm) {
+            analyze_drain_events(&working_metrics);
+            // Events without a new result are published too, rather than
+            // held back until the next one
+            if (hops || working_metrics.event_count || working_metrics.beat)
+                metricsshm_publish(publish_shm, &working_metrics);
+        }
+        if (hops) {
+            memcpy(triplebuffer_back(&metrics_buffer), &working_metrics,
+                   sizeof(AudioMetrics));
+            triplebuffer_publish(&metrics_buffer);
+        }
+
+        advance(&next, period);
+
+        // Don't try to catch up on missed deadlines, just carry on from now
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (is_before(&next, &now))
+            next = now;
+
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, 0);
+    }
+
+    (void)arg;
+    return 0;
+}
+
+int analysisthread_start(uint32_t rate, MetricsShm *publish) {
+    if (rate == 0)
+        return 1;
+    period = NANOSECONDS_IN_SECOND / rate;
+    publish_shm = publish;
+
+    // Make sure the render thread gets valid metrics before the first result
+    analyze_get_metrics(&working_metrics);
+    for (size_t i = 0; i < 3; i++)
+        buffers[i] = working_metrics;
+    triplebuffer_init(&metrics_buffer, buffers, buffers + 1, buffers + 2);
+
+    atomic_store(&running, 1);
+    if (pthread_create(&thread_id, 0, &analysis_loop, 0)) {
+        perror("ERROR: could not create analysis thread");
+        atomic_store(&running, 0);
+        return 1;
+    }
+    return 0;
+}
+
+void analysisthread_stop(void) {
+    if (!atomic_load(&running))
+        return;
+    atomic_store(&running, 0);
+    pthread_join(thread_id, 0);
+}
+
+AudioMetrics *analysisthread_get_metrics(void) {
+    return triplebuffer_front(&metrics_buffer);
+}
@@ -0,0 +1,28 @@
+#ifndef _ANALYSIS_THREAD
+#define _ANALYSIS_THREAD
+
+/*
+Runs the audio analysis on a dedicated thread at a fixed rate, decoupled from
+rendering. Results are handed to the render thread through a triple buffer, so
+fetching them never blocks and a slow frame does not hold back the analysis.
+*/
+
+#include "analyze.h"
+#include "metrics_shm.h"
+
+// Starts calling analyze_get_metrics() `rate` times per second on a separate
+// thread. analyze_init() needs to have been called. If `publish` is not 0, each
+// new result is published to it along with the events and beats since the
+// previous one, which are then drained on the analysis thread instead of by
+// analyze_drain_events() on the render thread. Returns 0 on success.
+int analysisthread_start(uint32_t rate, MetricsShm *publish);
+// Stops the analysis thread.
+void analysisthread_stop(void);
+
+// Returns the freshest complete metrics without blocking. The returned metrics
+// stay valid until the next call. Events and beats are not included, pass the
+// metrics to analyze_drain_events() for them, or read them from the shared
+// memory if they are published.
+AudioMetrics *analysisthread_get_metrics(void);
+
+#endif
@@ -1,100 +1,256 @@
 #include "analyze.h"
-#include "fft.h"
+#include "analyzer.h"
+#include "event_queue.h"
+#include "sample_ring.h"
 #include <assert.h>
-#include <math.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define MAXIMUM_VALUE_DECAY_RATE 0.00002
-#define SMOOTHING_AVERAGING_WINDOW 2
-#define SMOOTH_REALTIME_WINDOW 12
-#define BEAT_TRESHOLD 0.008
+// Room for several windows so that a slow frame does not lose the windows the
+// analysis is about to read.
+#define RING_WINDOWS 8
 
-static float samples_l[INPUT_SIZE] = {0};
-static size_t samples_l_used = 0;
-static int get_beat_from_midi = 0;
-static int beat_received = 0;
+static SampleRing samples = {0};
+static EventQueue events = {0};
+static _Atomic int get_beat_from_midi = 0;
+static Analyzer analyzer = {0};
+static LoudnessMeter loudness;
 
-static FFTTransformer *transformer = 0;
+static uint32_t input_size = DEFAULT_INPUT_SIZE;
+static uint32_t hop_size = DEFAULT_HOP_SIZE;
+static uint32_t sample_rate = DEFAULT_SAMPLE_RATE;
+// Rate given to analyze_set_sample_rate() that analyze_get_metrics() has yet
+// to switch to, or 0. Loudness is not metered meanwhile.
+static _Atomic uint32_t pending_sample_rate = 0;
+static uint32_t channel_count = 1;
+// Absolute frame position where the next window to be analyzed ends.
+static uint64_t next_window_end = 0;
+// Delay of metrics and events, see AnalyzeConfig.delay. Only a positive delay
+// holds frames back.
+static int64_t delay_ns = 0;
+static uint64_t delay_frames = 0;
+// Events drained from the queue that are not yet due because of the delay.
+// Only accessed by the render thread.
+static Event pending_events[EVENT_QUEUE_CAPACITY];
+static size_t pending_event_count = 0;
+
+// Interleaved frames of the window being analyzed.
+static float *frame_buffer = 0;
 
 void analyze_feed_frames(float *frames, uint32_t frame_count,
                          uint8_t channels) {
-    for (size_t i = 0; i < frame_count * channels; i += channels)
-        samples_l[samples_l_used++ % INPUT_SIZE] = frames[i];
+    assert(channels >= channel_count);
+    samplering_write(&samples, frames, frame_count, channels,
+                     eventqueue_now());
+    if (!atomic_load_explicit(&pending_sample_rate, memory_order_acquire))
+        loudness_feed(&loudness, frames, frame_count, channels);
 }
 
-void analyze_init(void) {
-    transformer = create_fft_transformer(INPUT_SIZE, FFT_SCALED_OUTPUT);
-    assert(transformer);
+// Where analyze_feed_begin() lets the producer write frames.
+static float *feed_target = 0;
+
+float *analyze_feed_begin(uint32_t *in_out_frame_count) {
+    size_t count = *in_out_frame_count;
+    feed_target = samplering_write_begin(&samples, &count);
+    *in_out_frame_count = count;
+    return feed_target;
 }
 
-void analyze_deinit(void) {
-    free_fft_transformer(transformer);
+void analyze_feed_commit(uint32_t frame_count) {
+    samplering_write_commit(&samples, frame_count, eventqueue_now());
+    if (!atomic_load_explicit(&pending_sample_rate, memory_order_acquire))
+        loudness_feed(&loudness, feed_target, frame_count, channel_count);
 }
 
-// From fft.c
-static inline float hanning(int i, int nn) {
-    return (0.5 * (1.0 - cosf(2.0 * M_PI * (float)i / (float)(nn - 1))));
+static inline void update_delay_frames(void) {
+    delay_frames = delay_ns > 0 ? delay_ns * sample_rate / 1000000000 : 0;
 }
 
-static inline void rolling_average(float *out_value, float new, float window) {
-    *out_value = (*out_value) * (window - 1) / window + new / window;
+void analyze_init(const AnalyzeConfig *config) {
+    assert(config->input_size >= MIN_INPUT_SIZE);
+    assert(config->input_size <= MAX_INPUT_SIZE);
+    assert(config->hop_size > 0 && config->hop_size <= config->input_size);
+    assert(config->channels > 0 && config->channels <= MAX_CHANNELS);
+    assert(config->log_band_count > 0 && config->log_band_count <= MAX_BANDS);
+    assert(config->mel_band_count > 0 && config->mel_band_count <= MAX_BANDS);
+    assert(config->cqt_bins_per_octave <= MAX_CQT_BINS_PER_OCTAVE);
+    assert(config->delay >= -MAX_DELAY && config->delay <= MAX_DELAY);
+
+    input_size = config->input_size;
+    hop_size = config->hop_size;
+    channel_count = config->channels;
+    next_window_end = hop_size;
+    delay_ns = (int64_t)config->delay * 1000000;
+    pending_event_count = 0;
+    update_delay_frames();
+
+    if (analyzer_init(&analyzer, config, sample_rate) ||
+        loudness_init(&loudness, channel_count, sample_rate))
+        abort();
+    frame_buffer = malloc(input_size * channel_count * sizeof(float));
+    if (!frame_buffer)
+        abort();
+    // The ring also holds the frames held back by the delay, at any rate
+    size_t ring_capacity = input_size * RING_WINDOWS;
+    if (config->delay > 0)
+        ring_capacity += (size_t)config->delay * MAX_SAMPLE_RATE / 1000;
+    if (samplering_init(&samples, ring_capacity, channel_count) ||
+        eventqueue_init(&events, EVENT_QUEUE_CAPACITY))
+        abort();
 }
 
-void analyze_get_metrics(AudioMetrics *out_metrics) {
-    assert(transformer);
-    assert(out_metrics);
+void analyze_deinit(void) {
+    analyzer_free(&analyzer);
+    samplering_free(&samples);
+    eventqueue_free(&events);
+    free(frame_buffer);
+    frame_buffer = 0;
+}
+
+void analyze_set_sample_rate(uint32_t rate) {
+    assert(rate > 0 && rate <= MAX_SAMPLE_RATE);
+    atomic_store_explicit(&pending_sample_rate, rate, memory_order_release);
+}
+
+// Switches to the rate given to analyze_set_sample_rate(), on the thread that
+// uses the analyzer, so that it is never rebuilt while in use.
+static inline void apply_sample_rate(void) {
+    uint32_t rate =
+        atomic_load_explicit(&pending_sample_rate, memory_order_acquire);
+    if (!rate)
+        return;
 
-    static float temp_buffer[INPUT_SIZE] = {0};
+    sample_rate = rate;
+    update_delay_frames();
+    if (analyzer_set_sample_rate(&analyzer, rate) ||
+        loudness_init(&loudness, channel_count, rate))
+        abort();
+    // Left pending if the rate changed again meanwhile
+    atomic_compare_exchange_strong_explicit(&pending_sample_rate, &rate, 0,
+                                            memory_order_release,
+                                            memory_order_relaxed);
+}
 
-    // A slowly decaying maximum value to normalize frequency data
-    static float maximum = 0;
-    maximum -= MAXIMUM_VALUE_DECAY_RATE;
-    if (maximum < 0.001)
-        maximum = 0.001;
+// Analyzes one window of frames in `frame_buffer`, which ended at frame
+// `window_end` at `time` (see Event), and queues events for its onsets.
+static inline void analyze_window(AudioMetrics *out_metrics,
+                                  uint64_t window_end, uint64_t time) {
+    float strengths[ONSET_BAND_COUNT];
+    uint32_t onsets =
+        analyzer_process(&analyzer, frame_buffer, out_metrics, strengths);
 
-    // Copy data while applying windowing function
-    for (size_t i = 0; i < INPUT_SIZE; i++)
-        temp_buffer[i] = samples_l[i] * hanning(i, INPUT_SIZE);
+    for (size_t i = 0; i < ONSET_BAND_COUNT; i++) {
+        if (!(onsets & (1 << i)))
+            continue;
+        Event event = {
+            .time = time,
+            .frame = window_end,
+            .type = EVENT_ONSET,
+            .note = i,
+            .velocity = 1 + strengths[i] * 126,
+        };
+        eventqueue_push(&events, &event);
+    }
+}
 
-    static float smooth_realtime_maximum = 0;
-    static float rapid_realtime_maximum = 0;
-    float realtime_maximum = 0;
+uint32_t analyze_get_metrics(AudioMetrics *out_metrics) {
+    assert(analyzer.transformer);
+    assert(out_metrics);
 
-    fft_forward(transformer, temp_buffer);
+    apply_sample_rate();
+    out_metrics->frequency_count = input_size / 2;
+    out_metrics->frequency_resolution = (float)sample_rate / input_size;
 
-    for (size_t i = 0; i < FREQUENCY_COUNT; i++) {
-        assert((i * 2 + 1) < INPUT_SIZE);
+    memset(out_metrics->onsets, 0, sizeof(out_metrics->onsets));
 
-        float cos_comp = temp_buffer[i * 2];
-        float sin_comp = temp_buffer[i * 2 + 1];
-        float mag = sqrt((cos_comp * cos_comp) + (sin_comp * sin_comp));
+    uint64_t written_time = 0;
+    uint64_t written = samplering_written_at(&samples, &written_time);
+    // The newest frames are held back by the delay
+    uint64_t available = written > delay_frames ? written - delay_frames : 0;
 
-        out_metrics->frequencies[i] = (mag / maximum);
+    // If the analysis has fallen so far behind that the ring no longer holds
+    // the next window, skip to the newest complete hop.
+    if (available > next_window_end &&
+        written - next_window_end > samples.capacity - input_size)
+        next_window_end =
+            available - (available - next_window_end) % hop_size;
 
-        if (maximum < mag)
-            maximum = mag;
-        if (i < 5 && realtime_maximum < mag)
-            realtime_maximum = mag;
+    uint32_t hops = 0;
+    while (next_window_end <= available) {
+        if (samplering_read(&samples, frame_buffer, next_window_end,
+                            input_size) == 0) {
+            // Frames are captured at a steady rate, so the capture time of
+            // the window is relative to that of the newest frame
+            uint64_t age = (written - next_window_end) * 1000000000 /
+                           sample_rate;
+            analyze_window(out_metrics, next_window_end, written_time - age);
+            out_metrics->capture_time = written_time - age;
+            hops++;
+        }
+        next_window_end += hop_size;
     }
+    if (hops)
+        out_metrics->analysis_time = eventqueue_now();
+    loudness_read(&loudness, available, &out_metrics->loudness);
 
-    rolling_average(&smooth_realtime_maximum, realtime_maximum, 10);
-    rolling_average(&rapid_realtime_maximum, realtime_maximum, 8);
+    return hops;
+}
 
-    if (get_beat_from_midi) {
-        out_metrics->beat = beat_received;
-        beat_received = 0;
-    } else {
-        out_metrics->beat =
-            ((rapid_realtime_maximum - smooth_realtime_maximum) / maximum) >
-            BEAT_TRESHOLD;
-    }
+void analyze_push_event(const Event *event) {
+    eventqueue_push(&events, event);
 }
 
-void analyze_trigger_beat(void) {
-    beat_received = 1;
+void analyze_drain_events(AudioMetrics *metrics) {
+    const uint64_t now = eventqueue_now();
+    const int midi_beats =
+        atomic_load_explicit(&get_beat_from_midi, memory_order_relaxed);
+
+    metrics->event_count = 0;
+    metrics->beat = 0;
+
+    while (pending_event_count < EVENT_QUEUE_CAPACITY &&
+           eventqueue_pop(&events, &pending_events[pending_event_count]) == 0)
+        pending_event_count++;
+
+    size_t kept = 0;
+    for (size_t pending = 0; pending < pending_event_count; pending++) {
+        const Event event = pending_events[pending];
+        float offset =
+            ((int64_t)event.time + delay_ns - (int64_t)now) / 1e9;
+        if (offset > 0) {
+            pending_events[kept++] = event;
+            continue;
+        }
+
+        int beat = event.type == EVENT_NOTE_ON ||
+                   (!midi_beats && event.type == EVENT_ONSET &&
+                    event.note == ONSET_KICK);
+        if (beat)
+            metrics->beat = 1;
+
+        if (metrics->event_count == MAX_FRAME_EVENTS)
+            continue;
+
+        // Onsets are queued a hop or more after they occurred, so events from
+        // different sources can arrive out of order. Keep them sorted.
+        size_t i = metrics->event_count++;
+        for (; i > 0 && metrics->events[i - 1].offset > offset; i--)
+            metrics->events[i] = metrics->events[i - 1];
+        metrics->events[i] = (FrameEvent){
+            .type = event.type,
+            .note = event.note,
+            .velocity = event.velocity,
+            .channel = event.channel,
+            .beat = beat,
+            .offset = offset,
+        };
+    }
+    pending_event_count = kept;
 }
 
 void analyze_set_beat_triggering_mode(int use_manual_triggering) {
-    get_beat_from_midi = use_manual_triggering;
+    atomic_store_explicit(&get_beat_from_midi, use_manual_triggering,
+                          memory_order_relaxed);
 }
@@ -1,41 +1,283 @@
 #ifndef _FREQ
 #define _FREQ
 
+#include "event_queue.h"
+#include "fft.h"
+#include "harmony.h"
+#include "loudness.h"
 #include "miniaudio.h"
+#include "onset.h"
+#include <math.h>
+#include <stddef.h>
 #include <stdint.h>
-#define INPUT_SIZE 1024
-#define FREQUENCY_COUNT 512 // (INPUT_SIZE / 2)
+
+// Limits for the amount of samples in a single FFT window.
+#define MIN_INPUT_SIZE 512
+#define MAX_INPUT_SIZE 8192
+#define MAX_FREQUENCY_COUNT (MAX_INPUT_SIZE / 2)
+// Maximum amount of captured channels analyzed separately.
+#define MAX_CHANNELS 4
+
+// Maximum amount of log-spaced or mel-spaced bands.
+#define MAX_BANDS 64
+// Room for all 1/3-octave bands between 20 Hz and 20 kHz.
+#define MAX_THIRD_OCTAVE_BANDS 32
+// Frequency range covered by the log-spaced and mel-spaced bands.
+#define BANDS_MIN_FREQUENCY 30
+#define BANDS_MAX_FREQUENCY 16000
+
+// Constant-Q bins start at C1, so that with 12 bins per octave bin `n` is MIDI
+// note 24 + n, and span CQT_OCTAVES octaves.
+#define CQT_MIN_FREQUENCY 32.703196f
+#define CQT_OCTAVES 8
+#define MAX_CQT_BINS_PER_OCTAVE 48
+#define MAX_CQT_BINS (CQT_OCTAVES * MAX_CQT_BINS_PER_OCTAVE)
+
+#define DEFAULT_INPUT_SIZE 1024
+#define DEFAULT_HOP_SIZE 512
+#define DEFAULT_SAMPLE_RATE 48000
+#define DEFAULT_LOG_BAND_COUNT 32
+#define DEFAULT_MEL_BAND_COUNT 40
+#define DEFAULT_CQT_BINS_PER_OCTAVE 12
+// Attack and release times of the envelopes in milliseconds.
+#define DEFAULT_ENVELOPE_ATTACK 10
+#define DEFAULT_ENVELOPE_RELEASE 250
+#define MAX_ENVELOPE_TIME 10000
+
+// Highest supported sample rate, used to size buffers before the rate is known.
+#define MAX_SAMPLE_RATE 192000
+// Limit for the delay of metrics and events in milliseconds, see AnalyzeConfig.
+#define MAX_DELAY 2000
+
+// Capacity of the queue of MIDI and onset events waiting for the render thread.
+#define EVENT_QUEUE_CAPACITY 256
+// Maximum amount of events passed to a single frame.
+#define MAX_FRAME_EVENTS 64
 
 /*
 Analyze frequency content of captured audio using fast fourier transform.
+
+Captured samples are analyzed in overlapping windows of `input_size` samples
+that start every `hop_size` samples (short-time fourier transform), so the
+time resolution of the metrics does not depend on the frame rate.
+
+Each captured channel is transformed separately. Since the transform is linear,
+the spectra of the mix of all channels (mid) and of the difference of the first
+two channels (side) are derived from the per-channel transforms without
+transforming again.
+
+The mix is also aggregated into log-spaced, mel-spaced and 1/3-octave bands
+with precomputed weights (see bands.h), and running sums of it are provided
+so that the average of any range of frequencies is a constant time lookup.
+Optionally, a constant-Q transform of a longer history of the mix resolves
+single notes down to the bass (see cqt.h). The key and the current chord are
+estimated from the pitch classes in the mix (see harmony.h).
+
+Onsets of kick, snare and hi-hat like sounds are detected from the spectral
+flux of the mix (see onset.h). Unless beats come from MIDI, a kick onset is a
+beat.
+
+Onsets and MIDI events share a lock-free queue (see event_queue.h). Each event
+is stamped with the time it occurred at the input rather than when it was
+detected, and the render thread drains the queue every frame with
+analyze_drain_events(), so a scene knows how long ago within the frame each
+event happened even if several arrive between two frames.
+
+Envelopes of the log-spaced bands and of the overall level follow the music
+with attack and release times in milliseconds (see envelope.h), so they feel
+the same at any frame rate and scenes can use them without smoothing them.
+
+Levels in absolute units, loudness, RMS and true peak, are metered as frames
+are fed (see loudness.h), so they are unaffected by the normalization of the
+spectra.
+
+Captured frames are stamped with the time they were fed, and each result
+carries the capture time of the newest analyzed frame and the time the
+analysis finished, so that latency can be measured up to the presented frame
+(see latency.h). Metrics and events can be delayed by a fixed amount to line
+the visuals up with the sound system.
 */
 
 typedef struct {
-    // Relative amplitudes of frequencies in the signal.
-    float frequencies[FREQUENCY_COUNT];
-    // Will be 1.0 if a beat has just occurred, otherwise 0.0.
+    // EventType of the event.
+    uint8_t type;
+    // MIDI note number, or the OnsetBand for onsets.
+    uint8_t note;
+    // Between 0 and 127, for onsets derived from their strength.
+    uint8_t velocity;
+    // MIDI channel, 0 for onsets.
+    uint8_t channel;
+    // 1 if the event counts as a beat, see AudioMetrics.beat.
+    uint8_t beat;
+    // Seconds from the rendered frame to the event, negative for events that
+    // happened before the frame.
+    float offset;
+} FrameEvent;
+
+typedef struct {
+    // Relative amplitudes of frequencies in the signal, a mix of all channels.
+    // Only the first `frequency_count` values are used.
+    float frequencies[MAX_FREQUENCY_COUNT];
+    // Amount of used values in `frequencies` and the other spectra.
+    uint32_t frequency_count;
+    // Running sums of `frequencies`: the sum of frequencies from index `a` up
+    // to but not including `b` is `frequency_sums[b] - frequency_sums[a]`.
+    // See sc_bin_range_average() in scene_common.h.
+    float frequency_sums[MAX_FREQUENCY_COUNT + 1];
+    // Relative amplitudes of overlapping bands with logarithmically spaced
+    // center frequencies between BANDS_MIN_FREQUENCY and BANDS_MAX_FREQUENCY.
+    float log_bands[MAX_BANDS];
+    uint32_t log_band_count;
+    // Like `log_bands`, but with centers evenly spaced on the mel scale.
+    float mel_bands[MAX_BANDS];
+    uint32_t mel_band_count;
+    // Envelopes of `log_bands` and of the mean of `frequencies`, between 0.0
+    // and 1.0, each leveled by its own recent peak. They rise and fall within
+    // the attack and release times of AnalyzeConfig.
+    float band_envelopes[MAX_BANDS];
+    float level_envelope;
+    // Relative amplitudes of the standard 1/3-octave bands, starting from the
+    // 25 Hz band.
+    float third_octave_bands[MAX_THIRD_OCTAVE_BANDS];
+    uint32_t third_octave_band_count;
+    // Relative amplitudes of constant-Q bins of the mix, `cqt_bins_per_octave`
+    // per octave from CQT_MIN_FREQUENCY, see analyze_cqt_frequency().
+    // Normalized like `frequencies`. No bins unless enabled in AnalyzeConfig.
+    float cqt_bins[MAX_CQT_BINS];
+    uint32_t cqt_bin_count;
+    uint32_t cqt_bins_per_octave;
+    // Pitch class content, key and chord of the mix.
+    Harmony harmony;
+    // Levels of the captured channels, up to the newest frame that is not
+    // held back by the delay. Updated on every analyze_get_metrics() call.
+    Loudness loudness;
+    // Relative amplitudes of frequencies in each captured channel.
+    float channel_frequencies[MAX_CHANNELS][MAX_FREQUENCY_COUNT];
+    // Amount of used channels in `channel_frequencies`.
+    uint32_t channel_count;
+    // Relative amplitudes of frequencies in the difference of the first two
+    // channels, i.e. the stereo side signal. Zero if there is only one
+    // channel.
+    float side_frequencies[MAX_FREQUENCY_COUNT];
+    // Width of each frequency bin in Hz, see analyze_bin_frequency().
+    float frequency_resolution;
+    // Strength of onsets detected since the previous call, indexed by
+    // OnsetBand (ONSET_KICK, ONSET_SNARE, ONSET_HAT). Between 0.0 (no onset)
+    // and 1.0.
+    float onsets[ONSET_BAND_COUNT];
+    // Events that occurred since the previous frame, oldest first. Filled in
+    // by analyze_drain_events().
+    FrameEvent events[MAX_FRAME_EVENTS];
+    uint32_t event_count;
+    // Time when the last frame of the newest analyzed window was captured, and
+    // when its analysis finished, on the clock of eventqueue_now().
+    uint64_t capture_time;
+    uint64_t analysis_time;
+    // Will be 1.0 if a beat has just occurred, otherwise 0.0. A beat is a MIDI
+    // note on event, or a kick onset if no MIDI notes have been received.
     float beat;
 } AudioMetrics;
 
+typedef struct {
+    // Windowing function applied to the samples before the FFT.
+    FFTWindow window;
+    // Amount of samples in each FFT window, between MIN_INPUT_SIZE and
+    // MAX_INPUT_SIZE.
+    uint32_t input_size;
+    // Amount of samples between the starts of consecutive windows, between 1
+    // and `input_size`.
+    uint32_t hop_size;
+    // Amount of channels in the frames fed to analyze_feed_frames(), between 1
+    // and MAX_CHANNELS.
+    uint32_t channels;
+    // Amount of log-spaced and mel-spaced bands, between 1 and MAX_BANDS.
+    uint32_t log_band_count;
+    uint32_t mel_band_count;
+    // Bins per octave of the constant-Q transform, up to
+    // MAX_CQT_BINS_PER_OCTAVE, or 0 to leave it out.
+    uint32_t cqt_bins_per_octave;
+    // Attack and release times of the envelopes in milliseconds, up to
+    // MAX_ENVELOPE_TIME, or 0 for DEFAULT_ENVELOPE_ATTACK and
+    // DEFAULT_ENVELOPE_RELEASE.
+    uint32_t envelope_attack;
+    uint32_t envelope_release;
+    // Milliseconds by which metrics and events are held back, between
+    // -MAX_DELAY and MAX_DELAY, for sound that reaches the audience later
+    // than the visuals. Negative values instead report events as having
+    // happened earlier, to make up for display latency.
+    int32_t delay;
+} AnalyzeConfig;
+
 typedef enum {
     BEAT_DETECTION_AUDIO = 0,
     BEAT_DETECTION_MIDI,
 } BeatDetectMode;
 
 // Initializes this module and starts capturing audio data for analysis.
-void analyze_init(void);
-// Writes metrics of the playing audio such as frequency content into
-// `out_metrics`.
-void analyze_get_metrics(AudioMetrics *out_metrics);
+void analyze_init(const AnalyzeConfig *config);
+// Processes every complete hop of audio that arrived since the last call and
+// writes metrics of the playing audio such as frequency content into
+// `out_metrics`. The frequencies are only updated when at least one hop was
+// processed, so `out_metrics` should be kept between calls. Returns the amount
+// of hops processed. Events and beats are not written, see
+// analyze_drain_events().
+uint32_t analyze_get_metrics(AudioMetrics *out_metrics);
 // Frees this module.
 void analyze_deinit(void);
-// Feeds `frames` to analyze metrics from (see analyze_get_metrics()).
+// Sets the sample rate of the captured audio, used for mapping frequency bins
+// to Hz. Defaults to DEFAULT_SAMPLE_RATE. Safe to call while another thread
+// analyzes: the next analyze_get_metrics() call switches to the new rate, and
+// frames fed until then are not metered for loudness. Must not be called
+// while frames are being fed.
+void analyze_set_sample_rate(uint32_t sample_rate);
+// Feeds interleaved `frames` of `channels` samples each to analyze metrics from
+// (see analyze_get_metrics()). Only as many channels as configured in
+// analyze_init() are used.
 void analyze_feed_frames(float *frames, uint32_t frame_count, uint8_t channels);
-// Manually trigger a beat metric to be pulsed. Requires manual triggering mode
-// to be enabled via analyze_beat_set_manual_triggering_mode().
-void analyze_trigger_beat(void);
-// Set whether or not the beat metric should be manually triggered via
-// analyze_trigger_beat() instead of infering from audio frequency data.
+// Like analyze_feed_frames(), for a source that writes frames of the
+// configured amount of channels in place, without copying them: returns where
+// up to `*in_out_frame_count` frames go, lowering the count if fewer fit.
+// Must be followed by analyze_feed_commit().
+float *analyze_feed_begin(uint32_t *in_out_frame_count);
+// Feeds the first `frame_count` frames written since analyze_feed_begin(),
+// which may be none.
+void analyze_feed_commit(uint32_t frame_count);
+// Queues an event from an external source such as MIDI, to be passed to the
+// next frame. Safe to call from realtime threads. Dropped if the queue is
+// full.
+void analyze_push_event(const Event *event);
+// Passes the events queued since the previous call into the `events` of
+// `metrics`, with offsets relative to now, and sets its `beat`. Must only be
+// called from one thread, the render thread or else the analysis thread (see
+// analysisthread_start()).
+void analyze_drain_events(AudioMetrics *metrics);
+// Set whether beats come from MIDI note on events instead of onsets detected
+// in the audio. Safe to call from any thread.
 void analyze_set_beat_triggering_mode(int use_manual_triggering);
 
+// Center frequency in Hz of the frequency bin at `index`.
+static inline float analyze_bin_frequency(const AudioMetrics *metrics,
+                                          size_t index) {
+    return index * metrics->frequency_resolution;
+}
+
+// Index of the frequency bin that contains `frequency` Hz, clamped to the
+// available bins.
+static inline size_t analyze_frequency_bin(const AudioMetrics *metrics,
+                                           float frequency) {
+    if (metrics->frequency_resolution <= 0 || frequency <= 0)
+        return 0;
+    size_t index = frequency / metrics->frequency_resolution + 0.5;
+    if (index >= metrics->frequency_count)
+        index = metrics->frequency_count - 1;
+    return index;
+}
+
+// Center frequency in Hz of the constant-Q bin at `index`.
+static inline float analyze_cqt_frequency(const AudioMetrics *metrics,
+                                          size_t index) {
+    return CQT_MIN_FREQUENCY *
+           exp2f((float)index / metrics->cqt_bins_per_octave);
+}
+
 #endif
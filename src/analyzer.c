@@ -0,0 +1,260 @@
+#include "analyzer.h"
+#include "dsp.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Fall of the maximum per second.
+#define MAXIMUM_VALUE_DECAY_RATE 0.001875
+#define MINIMUM_MAXIMUM 0.001
+
+// (Re)creates band layouts, the onset detector, the harmony estimator, the
+// envelopes and the constant-Q kernels for the current FFT size, hop size and
+// sample rate.
+static inline int create_band_layouts(Analyzer *analyzer) {
+    const uint32_t frequency_count = analyzer->input_size / 2;
+    const float resolution =
+        (float)analyzer->sample_rate / analyzer->input_size;
+    const float hop_duration =
+        (float)analyzer->hop_size / analyzer->sample_rate;
+
+    bands_free(&analyzer->log_bands);
+    bands_free(&analyzer->mel_bands);
+    bands_free(&analyzer->third_octave_bands);
+    onset_free(&analyzer->onset_detector);
+    harmony_free(&analyzer->harmony);
+    envelope_free(&analyzer->envelopes);
+    cqt_free(&analyzer->cqt);
+
+    if (analyzer->cqt_bins_per_octave &&
+        cqt_init(&analyzer->cqt, analyzer->cqt_bins_per_octave,
+                 analyzer->cqt_bins_per_octave * CQT_OCTAVES,
+                 CQT_MIN_FREQUENCY, analyzer->sample_rate))
+        return 1;
+    if (bands_create_log(&analyzer->log_bands, analyzer->log_band_count,
+                         BANDS_MIN_FREQUENCY, BANDS_MAX_FREQUENCY,
+                         frequency_count, resolution) ||
+        bands_create_mel(&analyzer->mel_bands, analyzer->mel_band_count,
+                         BANDS_MIN_FREQUENCY, BANDS_MAX_FREQUENCY,
+                         frequency_count, resolution) ||
+        bands_create_third_octave(&analyzer->third_octave_bands,
+                                  frequency_count, resolution) ||
+        onset_init(&analyzer->onset_detector, frequency_count, resolution,
+                   hop_duration) ||
+        harmony_init(&analyzer->harmony, frequency_count, resolution,
+                     hop_duration) ||
+        envelope_init(&analyzer->envelopes, analyzer->log_bands.count + 1,
+                      analyzer->envelope_attack, analyzer->envelope_release,
+                      hop_duration))
+        return 1;
+    return analyzer->third_octave_bands.count > MAX_THIRD_OCTAVE_BANDS;
+}
+
+int analyzer_init(Analyzer *analyzer, const AnalyzeConfig *config,
+                  uint32_t sample_rate) {
+    memset(analyzer, 0, sizeof(Analyzer));
+    analyzer->input_size = config->input_size;
+    analyzer->hop_size = config->hop_size;
+    analyzer->channel_count = config->channels;
+    analyzer->sample_rate = sample_rate;
+    analyzer->log_band_count = config->log_band_count;
+    analyzer->mel_band_count = config->mel_band_count;
+    analyzer->cqt_bins_per_octave = config->cqt_bins_per_octave;
+    analyzer->envelope_attack = DEFAULT_ENVELOPE_ATTACK / 1000.0;
+    analyzer->envelope_release = DEFAULT_ENVELOPE_RELEASE / 1000.0;
+    if (config->envelope_attack)
+        analyzer->envelope_attack = config->envelope_attack / 1000.0;
+    if (config->envelope_release)
+        analyzer->envelope_release = config->envelope_release / 1000.0;
+
+    const size_t size = analyzer->input_size;
+    analyzer->transformer = create_fft_transformer(size, FFT_SCALED_OUTPUT);
+    // The complex transform of pairs of `size` samples is that of the real
+    // transform of twice the size
+    analyzer->pair_plan = fft_pow2_create(2 * size);
+    analyzer->window_table = dsp_window_create(config->window, size);
+    analyzer->mid_buffer = malloc(size * sizeof(float));
+    analyzer->side_buffer = malloc(size * sizeof(float));
+    if (!analyzer->transformer || !analyzer->window_table ||
+        !analyzer->mid_buffer || !analyzer->side_buffer)
+        return 1;
+    for (size_t i = 0; i < size; i++)
+        analyzer->window_gain += analyzer->window_table[i] / size;
+    for (size_t i = 0; i < analyzer->channel_count; i++) {
+        analyzer->channel_buffers[i] = malloc(size * sizeof(float));
+        if (!analyzer->channel_buffers[i])
+            return 1;
+    }
+
+    return create_band_layouts(analyzer);
+}
+
+void analyzer_free(Analyzer *analyzer) {
+    if (analyzer->transformer)
+        free_fft_transformer(analyzer->transformer);
+    analyzer->transformer = 0;
+    fft_pow2_free(analyzer->pair_plan);
+    analyzer->pair_plan = 0;
+    free(analyzer->window_table);
+    analyzer->window_table = 0;
+    free(analyzer->mid_buffer);
+    analyzer->mid_buffer = 0;
+    free(analyzer->side_buffer);
+    analyzer->side_buffer = 0;
+    for (size_t i = 0; i < MAX_CHANNELS; i++) {
+        free(analyzer->channel_buffers[i]);
+        analyzer->channel_buffers[i] = 0;
+    }
+    bands_free(&analyzer->log_bands);
+    bands_free(&analyzer->mel_bands);
+    bands_free(&analyzer->third_octave_bands);
+    onset_free(&analyzer->onset_detector);
+    harmony_free(&analyzer->harmony);
+    envelope_free(&analyzer->envelopes);
+    cqt_free(&analyzer->cqt);
+}
+
+int analyzer_set_sample_rate(Analyzer *analyzer, uint32_t sample_rate) {
+    analyzer->sample_rate = sample_rate;
+    return create_band_layouts(analyzer);
+}
+
+void analyzer_set_fixed_maximum(Analyzer *analyzer, float maximum) {
+    analyzer->maximum = fmaxf(maximum, MINIMUM_MAXIMUM);
+    analyzer->fixed_maximum = 1;
+}
+
+float analyzer_transform(Analyzer *analyzer, const float *frames,
+                         AudioMetrics *out_metrics) {
+    const uint32_t input_size = analyzer->input_size;
+    const uint32_t frequency_count = input_size / 2;
+    const uint32_t channel_count = analyzer->channel_count;
+    float *const *channel_buffers = analyzer->channel_buffers;
+
+    out_metrics->frequency_count = frequency_count;
+    out_metrics->frequency_resolution =
+        (float)analyzer->sample_rate / input_size;
+
+    dsp_deinterleave_window(channel_buffers, frames, channel_count,
+                            analyzer->window_table, input_size);
+
+    // Pairs of channels share one complex transform, scaled like the output
+    // of fft_forward()
+    size_t transformed = 0;
+    if (analyzer->pair_plan)
+        for (; transformed + 1 < channel_count; transformed += 2)
+            fft_pow2_forward_pair(analyzer->pair_plan,
+                                  channel_buffers[transformed],
+                                  channel_buffers[transformed + 1],
+                                  1.0f / input_size);
+    for (; transformed < channel_count; transformed++)
+        fft_forward(analyzer->transformer, channel_buffers[transformed]);
+
+    float peak = 0;
+    for (size_t i = 0; i < channel_count; i++)
+        peak = fmaxf(peak, dsp_magnitudes(out_metrics->channel_frequencies[i],
+                                          channel_buffers[i], frequency_count));
+    out_metrics->channel_count = channel_count;
+
+    out_metrics->cqt_bin_count = analyzer->cqt.bin_count;
+    out_metrics->cqt_bins_per_octave = analyzer->cqt_bins_per_octave;
+    if (analyzer->cqt_bins_per_octave) {
+        cqt_feed(&analyzer->cqt,
+                 frames + (input_size - analyzer->hop_size) * channel_count,
+                 analyzer->hop_size, channel_count);
+        // Leveled like a windowed FFT of the same sine
+        const float gain = analyzer->window_gain;
+        float *cqt_bins = out_metrics->cqt_bins;
+        peak = fmaxf(peak, cqt_process(&analyzer->cqt, cqt_bins) * gain);
+        dsp_scale(cqt_bins, analyzer->cqt.bin_count, gain);
+    }
+
+    if (channel_count == 1) {
+        memcpy(out_metrics->frequencies, out_metrics->channel_frequencies[0],
+               frequency_count * sizeof(float));
+        memset(out_metrics->side_frequencies, 0,
+               frequency_count * sizeof(float));
+        return peak;
+    }
+
+    // Mid and side are linear combinations of the channels, so their
+    // transforms are the same combinations of the channel transforms.
+    float *mid_buffer = analyzer->mid_buffer;
+    float *side_buffer = analyzer->side_buffer;
+    memcpy(mid_buffer, channel_buffers[0], input_size * sizeof(float));
+    for (size_t i = 1; i < channel_count; i++)
+        dsp_add(mid_buffer, channel_buffers[i], input_size);
+    dsp_scale(mid_buffer, input_size, 1.0 / channel_count);
+    dsp_half_difference(side_buffer, channel_buffers[0], channel_buffers[1],
+                        input_size);
+
+    peak = fmaxf(peak, dsp_magnitudes(out_metrics->frequencies, mid_buffer,
+                                      frequency_count));
+    peak = fmaxf(peak, dsp_magnitudes(out_metrics->side_frequencies,
+                                      side_buffer, frequency_count));
+    return peak;
+}
+
+uint32_t analyzer_process(Analyzer *analyzer, const float *frames,
+                          AudioMetrics *out_metrics, float *out_strengths) {
+    const uint32_t frequency_count = analyzer->input_size / 2;
+
+    float peak = analyzer_transform(analyzer, frames, out_metrics);
+
+    // A slowly decaying maximum value to normalize frequency data
+    if (!analyzer->fixed_maximum) {
+        analyzer->maximum -= MAXIMUM_VALUE_DECAY_RATE * analyzer->hop_size /
+                             analyzer->sample_rate;
+        if (analyzer->maximum < MINIMUM_MAXIMUM)
+            analyzer->maximum = MINIMUM_MAXIMUM;
+        if (analyzer->maximum < peak)
+            analyzer->maximum = peak;
+    }
+    const float scale = 1.0 / analyzer->maximum;
+
+    // All spectra share the normalization so they stay comparable
+    dsp_scale(out_metrics->frequencies, frequency_count, scale);
+    dsp_scale(out_metrics->side_frequencies, frequency_count, scale);
+    for (size_t i = 0; i < analyzer->channel_count; i++)
+        dsp_scale(out_metrics->channel_frequencies[i], frequency_count, scale);
+    dsp_scale(out_metrics->cqt_bins, out_metrics->cqt_bin_count, scale);
+
+    uint32_t onsets = onset_process(&analyzer->onset_detector,
+                                    out_metrics->frequencies, out_strengths);
+    for (size_t i = 0; i < ONSET_BAND_COUNT; i++)
+        out_metrics->onsets[i] =
+            fmaxf(out_metrics->onsets[i], out_strengths[i]);
+
+    bands_prefix_sums(out_metrics->frequencies, frequency_count,
+                      out_metrics->frequency_sums);
+    bands_apply(&analyzer->log_bands, out_metrics->frequencies,
+                out_metrics->log_bands);
+    bands_apply(&analyzer->mel_bands, out_metrics->frequencies,
+                out_metrics->mel_bands);
+    bands_apply(&analyzer->third_octave_bands, out_metrics->frequencies,
+                out_metrics->third_octave_bands);
+    out_metrics->log_band_count = analyzer->log_bands.count;
+    out_metrics->mel_band_count = analyzer->mel_bands.count;
+    out_metrics->third_octave_band_count = analyzer->third_octave_bands.count;
+    analyzer_follow(analyzer, out_metrics);
+
+    return onsets;
+}
+
+void analyzer_follow(Analyzer *analyzer, AudioMetrics *metrics) {
+    const uint32_t frequency_count = analyzer->input_size / 2;
+    harmony_process(&analyzer->harmony, metrics->frequencies,
+                    &metrics->harmony);
+
+    // The overall level follows the bands
+    const uint32_t band_count = analyzer->log_bands.count;
+    float levels[MAX_BANDS + 1];
+    float envelopes[MAX_BANDS + 1];
+    memcpy(levels, metrics->log_bands, band_count * sizeof(float));
+    levels[band_count] =
+        metrics->frequency_sums[frequency_count] / frequency_count;
+    envelope_process(&analyzer->envelopes, levels, envelopes);
+    memcpy(metrics->band_envelopes, envelopes, band_count * sizeof(float));
+    metrics->level_envelope = envelopes[band_count];
+}
@@ -0,0 +1,98 @@
+#ifndef _ANALYZER
+#define _ANALYZER
+
+/*
+Analysis of single windows of frames into AudioMetrics.
+
+An Analyzer holds everything the analysis of consecutive windows needs, so that
+several can run in parallel, e.g. over chunks of a file (see offline.h). The
+functions of analyze.h wrap one Analyzer fed from captured audio.
+
+Spectra are normalized by a slowly decaying maximum of the magnitudes seen so
+far, or by a fixed level when the loudest magnitude is known in advance. The
+maximum falls at a fixed rate per second, so it does not depend on the hop
+size.
+*/
+
+#include "analyze.h"
+#include "bands.h"
+#include "cqt.h"
+#include "envelope.h"
+#include "fft.h"
+#include "harmony.h"
+#include "onset.h"
+
+typedef struct {
+    uint32_t input_size;
+    uint32_t hop_size;
+    uint32_t channel_count;
+    uint32_t sample_rate;
+    uint32_t log_band_count;
+    uint32_t mel_band_count;
+    uint32_t cqt_bins_per_octave;
+    // Attack and release times of the envelopes in seconds.
+    float envelope_attack;
+    float envelope_release;
+
+    FFTTransformer *transformer;
+    // Transforms pairs of channels at once, 0 if `input_size` is not a power
+    // of two.
+    FFTPow2Plan *pair_plan;
+    float *window_table;
+    // Mean of `window_table`, by which windowing scales the level of a sine.
+    float window_gain;
+    // Windowed samples and then spectrum of each channel.
+    float *channel_buffers[MAX_CHANNELS];
+    // Spectra of the mix of all channels and the difference of the first two.
+    float *mid_buffer;
+    float *side_buffer;
+
+    BandLayout log_bands;
+    BandLayout mel_bands;
+    BandLayout third_octave_bands;
+    OnsetDetector onset_detector;
+    HarmonyEstimator harmony;
+    // Followers of the log bands, and last of the overall level.
+    EnvelopeBank envelopes;
+    // Only used if `cqt_bins_per_octave` is not 0.
+    ConstantQ cqt;
+
+    // Level that magnitudes are normalized to.
+    float maximum;
+    // Whether `maximum` is fixed instead of decaying.
+    int fixed_maximum;
+} Analyzer;
+
+// Initializes `analyzer` for windows described by `config` of audio at
+// `sample_rate`. The delay in `config` is not used. Returns 0 on success.
+int analyzer_init(Analyzer *analyzer, const AnalyzeConfig *config,
+                  uint32_t sample_rate);
+// Frees memory used by `analyzer`.
+void analyzer_free(Analyzer *analyzer);
+// Changes the sample rate, which recreates the band layouts and the
+// constant-Q kernels and resets onset detection, harmony estimation and
+// envelopes. Returns 0 on success.
+int analyzer_set_sample_rate(Analyzer *analyzer, uint32_t sample_rate);
+// Normalizes spectra by `maximum` from now on instead of by a decaying
+// maximum, e.g. the result of analyzer_transform() over a whole file.
+void analyzer_set_fixed_maximum(Analyzer *analyzer, float maximum);
+
+// Transforms the window of `input_size` interleaved `frames` and writes the
+// magnitude spectra into `out_metrics` without normalizing them. The newest
+// `hop_size` frames are added to the history of the constant-Q transform, so
+// windows should be passed in order. Returns the largest magnitude.
+float analyzer_transform(Analyzer *analyzer, const float *frames,
+                         AudioMetrics *out_metrics);
+// Analyzes the window of `input_size` interleaved `frames` into
+// `out_metrics`: normalized spectra, their bands and envelopes, harmony and
+// onsets. The strengths of onsets in this window are written into
+// `out_strengths`, and combined with those already in `out_metrics->onsets`.
+// Returns a bitmask of the bands with an onset, see onset_process().
+uint32_t analyzer_process(Analyzer *analyzer, const float *frames,
+                          AudioMetrics *out_metrics, float *out_strengths);
+// Estimates harmony and follows the envelopes from the normalized spectrum,
+// its running sums and the log bands in `metrics`, which is the last step of
+// analyzer_process(). Both depend on every earlier hop.
+void analyzer_follow(Analyzer *analyzer, AudioMetrics *metrics);
+
+#endif
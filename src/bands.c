@@ -0,0 +1,233 @@
+#include "bands.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Nominal center frequencies of the first and last 1/3-octave bands
+#define THIRD_OCTAVE_FIRST_CENTER 25.0
+#define THIRD_OCTAVE_LAST_CENTER 20000.0
+
+typedef enum {
+    BAND_SHAPE_TRIANGLE,
+    BAND_SHAPE_RECTANGLE,
+} BandShape;
+
+typedef float (*FrequencyScale)(float frequency);
+
+static inline float hz_to_mel(float frequency) {
+    return 2595.0 * log10f(1.0 + frequency / 700.0);
+}
+
+static inline float mel_to_hz(float mel) {
+    return 700.0 * (powf(10.0, mel / 2595.0) - 1.0);
+}
+
+static inline int allocate(BandLayout *layout, uint32_t band_count,
+                           size_t entry_count) {
+    layout->count = band_count;
+    layout->band_starts = calloc(band_count + 1, sizeof(uint32_t));
+    layout->centers = calloc(band_count, sizeof(float));
+    layout->bins = calloc(entry_count ? entry_count : 1, sizeof(uint32_t));
+    layout->weights = calloc(entry_count ? entry_count : 1, sizeof(float));
+    if (!layout->band_starts || !layout->centers || !layout->bins ||
+        !layout->weights) {
+        bands_free(layout);
+        return 1;
+    }
+    return 0;
+}
+
+// Weight of the bin centered at `frequency` in a band.
+static inline float shape_weight(BandShape shape, float frequency,
+                                 float resolution, float lower, float center,
+                                 float upper) {
+    if (shape == BAND_SHAPE_RECTANGLE) {
+        // Portion of the bin that overlaps the band
+        float bin_low = fmaxf(frequency - resolution / 2, lower);
+        float bin_high = fminf(frequency + resolution / 2, upper);
+        return fmaxf(0, bin_high - bin_low) / resolution;
+    }
+
+    if (frequency <= lower || frequency >= upper)
+        return 0;
+    if (frequency <= center)
+        return (frequency - lower) / (center - lower);
+    return (upper - frequency) / (upper - center);
+}
+
+// Builds bands of `shape` from `band_count` sets of lower, center and upper
+// edges in `edges`.
+static int create_from_edges(BandLayout *layout, uint32_t band_count,
+                             const float *edges, BandShape shape,
+                             uint32_t frequency_count, float resolution) {
+    // Every band covers at most the bins between its edges plus one
+    size_t entry_count = 0;
+    for (uint32_t band = 0; band < band_count; band++)
+        entry_count +=
+            (edges[band * 3 + 2] - edges[band * 3]) / resolution + 2;
+
+    if (allocate(layout, band_count, entry_count))
+        return 1;
+
+    size_t entry = 0;
+    for (uint32_t band = 0; band < band_count; band++) {
+        float lower = edges[band * 3];
+        float center = edges[band * 3 + 1];
+        float upper = edges[band * 3 + 2];
+        layout->centers[band] = center;
+        layout->band_starts[band] = entry;
+
+        size_t first = fmaxf(0, floorf(lower / resolution));
+        size_t last = ceilf(upper / resolution);
+        if (last >= frequency_count)
+            last = frequency_count - 1;
+
+        float total = 0;
+        for (size_t bin = first; bin <= last && entry < entry_count; bin++) {
+            float weight = shape_weight(shape, bin * resolution, resolution,
+                                        lower, center, upper);
+            if (weight <= 0)
+                continue;
+            layout->bins[entry] = bin;
+            layout->weights[entry] = weight;
+            total += weight;
+            entry++;
+        }
+
+        // Bands narrower than a bin fall back to the bin nearest the center
+        if (total <= 0) {
+            size_t bin = center / resolution + 0.5;
+            if (bin >= frequency_count)
+                bin = frequency_count - 1;
+            layout->bins[entry] = bin;
+            layout->weights[entry] = 1;
+            total = 1;
+            entry++;
+        }
+
+        for (size_t i = layout->band_starts[band]; i < entry; i++)
+            layout->weights[i] /= total;
+    }
+    layout->band_starts[band_count] = entry;
+
+    return 0;
+}
+
+// Creates triangular bands with centers evenly spaced on a scale given by
+// `to_scale` and its inverse `from_scale`.
+static int create_scaled(BandLayout *layout, uint32_t band_count,
+                         float min_frequency, float max_frequency,
+                         uint32_t frequency_count, float resolution,
+                         FrequencyScale to_scale, FrequencyScale from_scale) {
+    assert(band_count > 0);
+    assert(min_frequency > 0 && min_frequency < max_frequency);
+
+    float nyquist = frequency_count * resolution;
+    if (max_frequency > nyquist)
+        max_frequency = nyquist;
+
+    float *edges = malloc(band_count * 3 * sizeof(float));
+    if (!edges)
+        return 1;
+
+    // Each band spans from the center of the previous band to the center of
+    // the next one
+    float low = to_scale(min_frequency);
+    float step = (to_scale(max_frequency) - low) / (band_count + 1);
+    for (uint32_t band = 0; band < band_count; band++) {
+        edges[band * 3] = from_scale(low + step * band);
+        edges[band * 3 + 1] = from_scale(low + step * (band + 1));
+        edges[band * 3 + 2] = from_scale(low + step * (band + 2));
+    }
+
+    int result = create_from_edges(layout, band_count, edges,
+                                   BAND_SHAPE_TRIANGLE, frequency_count,
+                                   resolution);
+    free(edges);
+    return result;
+}
+
+int bands_create_log(BandLayout *layout, uint32_t band_count,
+                     float min_frequency, float max_frequency,
+                     uint32_t frequency_count, float resolution) {
+    return create_scaled(layout, band_count, min_frequency, max_frequency,
+                         frequency_count, resolution, &log2f, &exp2f);
+}
+
+int bands_create_mel(BandLayout *layout, uint32_t band_count,
+                     float min_frequency, float max_frequency,
+                     uint32_t frequency_count, float resolution) {
+    return create_scaled(layout, band_count, min_frequency, max_frequency,
+                         frequency_count, resolution, &hz_to_mel, &mel_to_hz);
+}
+
+int bands_create_third_octave(BandLayout *layout, uint32_t frequency_count,
+                              float resolution) {
+    const float half_band = exp2f(1.0 / 6.0);
+    const float nyquist = frequency_count * resolution;
+
+    // Bands are centered at 1 kHz * 2^(k/3), with k negative below 1 kHz
+    int first = roundf(3 * log2f(THIRD_OCTAVE_FIRST_CENTER / 1000.0));
+    int last = roundf(3 * log2f(THIRD_OCTAVE_LAST_CENTER / 1000.0));
+    // Only bands that fit below the highest frequency of the spectrum
+    while (last >= first && 1000.0 * exp2f(last / 3.0) * half_band > nyquist)
+        last--;
+    if (last < first)
+        return 1;
+
+    uint32_t band_count = last - first + 1;
+    float edges[band_count * 3];
+    for (uint32_t band = 0; band < band_count; band++) {
+        float center = 1000.0 * exp2f((first + (int)band) / 3.0);
+        edges[band * 3] = center / half_band;
+        edges[band * 3 + 1] = center;
+        edges[band * 3 + 2] = center * half_band;
+    }
+
+    return create_from_edges(layout, band_count, edges, BAND_SHAPE_RECTANGLE,
+                             frequency_count, resolution);
+}
+
+int bands_create_sparse(BandLayout *layout, uint32_t band_count,
+                        const uint32_t *band_starts, const uint32_t *bins,
+                        const float *weights) {
+    size_t entry_count = band_starts[band_count];
+    if (allocate(layout, band_count, entry_count))
+        return 1;
+
+    memcpy(layout->band_starts, band_starts,
+           (band_count + 1) * sizeof(uint32_t));
+    memcpy(layout->bins, bins, entry_count * sizeof(uint32_t));
+    memcpy(layout->weights, weights, entry_count * sizeof(float));
+    return 0;
+}
+
+void bands_free(BandLayout *layout) {
+    free(layout->band_starts);
+    free(layout->bins);
+    free(layout->weights);
+    free(layout->centers);
+    *layout = (BandLayout){0};
+}
+
+void bands_apply(const BandLayout *layout, const float *spectrum,
+                 float *out_bands) {
+    for (uint32_t band = 0; band < layout->count; band++) {
+        float sum = 0;
+        for (uint32_t i = layout->band_starts[band];
+             i < layout->band_starts[band + 1]; i++)
+            sum += spectrum[layout->bins[i]] * layout->weights[i];
+        out_bands[band] = sum;
+    }
+}
+
+void bands_prefix_sums(const float *values, size_t count, float *out_sums) {
+    float sum = 0;
+    out_sums[0] = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += values[i];
+        out_sums[i + 1] = sum;
+    }
+}
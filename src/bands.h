@@ -0,0 +1,61 @@
+#ifndef _BANDS
+#define _BANDS
+
+/*
+Aggregation of a linear spectrum into perceptually spaced frequency bands.
+
+A band layout is a sparse weight matrix stored row by row: each band has a
+short list of (bin, weight) entries, so applying it is a single pass over
+only the bins that contribute to any band. Weights of each band sum to one,
+making a band the weighted average of its bins.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    // Amount of bands.
+    uint32_t count;
+    // Entries of band `i` are at indices from `band_starts[i]` up to but not
+    // including `band_starts[i + 1]`.
+    uint32_t *band_starts;
+    uint32_t *bins;
+    float *weights;
+    // Center frequency of each band in Hz.
+    float *centers;
+} BandLayout;
+
+// Creates `band_count` overlapping triangular bands with logarithmically
+// spaced centers between `min_frequency` and `max_frequency` Hz, for a
+// spectrum of `frequency_count` bins each `resolution` Hz wide. Returns 0 on
+// success.
+int bands_create_log(BandLayout *layout, uint32_t band_count,
+                     float min_frequency, float max_frequency,
+                     uint32_t frequency_count, float resolution);
+// Like bands_create_log(), but with centers evenly spaced on the mel scale.
+int bands_create_mel(BandLayout *layout, uint32_t band_count,
+                     float min_frequency, float max_frequency,
+                     uint32_t frequency_count, float resolution);
+// Creates the standard 1/3-octave bands from 25 Hz to 20 kHz that fit below
+// the highest frequency of the spectrum.
+int bands_create_third_octave(BandLayout *layout, uint32_t frequency_count,
+                              float resolution);
+// Creates a layout from explicit entries. `band_starts` has `band_count + 1`
+// elements and the arrays are copied. Weights are used as is and centers are
+// left at zero.
+int bands_create_sparse(BandLayout *layout, uint32_t band_count,
+                        const uint32_t *band_starts, const uint32_t *bins,
+                        const float *weights);
+// Frees memory used by `layout`.
+void bands_free(BandLayout *layout);
+
+// Writes the level of each band of `layout` in `spectrum` into `out_bands`.
+void bands_apply(const BandLayout *layout, const float *spectrum,
+                 float *out_bands);
+
+// Writes the running sums of `count` values of `values` into `out_sums`, which
+// needs room for `count + 1` values, so that the sum of values from index `a`
+// up to but not including `b` is `out_sums[b] - out_sums[a]`.
+void bands_prefix_sums(const float *values, size_t count, float *out_sums);
+
+#endif
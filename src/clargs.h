@@ -18,6 +18,13 @@
 
 #define file(name) name = argv[clargs_i]
 
+// Positional argument that may be given several times. `count` goes past `max`
+// if more than `max` are given, and the extra ones are ignored.
+#define file_list(names, count, max)                                           \
+    if ((count) < (max))                                                       \
+        names[count] = argv[clargs_i];                                         \
+    (count)++
+
 // Flag with a value
 #define flag_value(name, flag)                                                 \
     if (!strcmp(argv[clargs_i], flag) && clargs_i < argc - 1 &&                \
@@ -27,6 +34,25 @@
         continue;                                                              \
     }
 
+// Flag with a numeric value, which may be negative
+#define flag_number(name, flag)                                                \
+    if (!strcmp(argv[clargs_i], flag) && clargs_i < argc - 1 &&                \
+        (argv[clargs_i + 1][0] != '-' ||                                       \
+         (argv[clargs_i + 1][1] >= '0' && argv[clargs_i + 1][1] <= '9'))) {    \
+        name = argv[clargs_i + 1];                                             \
+        clargs_i++;                                                            \
+        continue;                                                              \
+    }
+
+// Flag with a path, which may be "-" for standard input or output
+#define flag_path(name, flag)                                                  \
+    if (!strcmp(argv[clargs_i], flag) && clargs_i < argc - 1 &&                \
+        (argv[clargs_i + 1][0] != '-' || !argv[clargs_i + 1][1])) {            \
+        name = argv[clargs_i + 1];                                             \
+        clargs_i++;                                                            \
+        continue;                                                              \
+    }
+
 #define help(msg)                                                              \
     if (!strcmp(argv[clargs_i], "--help") || !strcmp(argv[clargs_i], "-h")) {  \
         printf("%s", msg);                                                     \
@@ -0,0 +1,180 @@
+#include "cqt.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Makes room for `needed` kernel entries. Returns 0 on success.
+static int reserve(ConstantQ *cqt, size_t needed, size_t *capacity) {
+    if (needed <= *capacity)
+        return 0;
+    size_t grown = *capacity ? *capacity * 2 : 1024;
+    while (grown < needed)
+        grown *= 2;
+
+    uint32_t *bins = realloc(cqt->kernel_bins, grown * sizeof(uint32_t));
+    if (bins)
+        cqt->kernel_bins = bins;
+    float *re = realloc(cqt->kernel_re, grown * sizeof(float));
+    if (re)
+        cqt->kernel_re = re;
+    float *im = realloc(cqt->kernel_im, grown * sizeof(float));
+    if (im)
+        cqt->kernel_im = im;
+    if (!bins || !re || !im)
+        return 1;
+    *capacity = grown;
+    return 0;
+}
+
+// Appends the large values of the transform of the kernel of `frequency`,
+// using `re` and `im` as scratch space. Returns 0 on success.
+static int add_kernel(ConstantQ *cqt, double frequency, double q,
+                      uint32_t sample_rate, float *re, float *im,
+                      size_t *entry_count, size_t *capacity) {
+    const uint32_t n = cqt->fft_size;
+    uint32_t length = ceil(q * sample_rate / frequency);
+    if (length > n)
+        length = n;
+    const uint32_t offset = n - length;
+
+    // Hann windowed complex exponential, scaled so the window sums to one
+    memset(re, 0, n * sizeof(float));
+    memset(im, 0, n * sizeof(float));
+    double window_sum = 0;
+    for (uint32_t i = 0; i < length; i++)
+        window_sum += 0.5 - 0.5 * cos(2 * M_PI * i / length);
+    for (uint32_t i = 0; i < length; i++) {
+        const double window =
+            (0.5 - 0.5 * cos(2 * M_PI * i / length)) / window_sum;
+        const double phase = 2 * M_PI * frequency * (offset + i) / sample_rate;
+        re[offset + i] = window * cos(phase);
+        im[offset + i] = window * sin(phase);
+    }
+
+    // The transform of re + i im from the transforms of both parts. Bins 0
+    // and n / 2 are left out, they hold nothing of any kernel.
+    fft_forward(cqt->transformer, re);
+    fft_forward(cqt->transformer, im);
+    float largest = 0;
+    for (uint32_t j = 1; j < n / 2; j++) {
+        const float value_re = re[2 * j - 1] - im[2 * j];
+        const float value_im = re[2 * j] + im[2 * j - 1];
+        largest = fmaxf(largest, hypotf(value_re, value_im));
+    }
+
+    for (uint32_t j = 1; j < n / 2; j++) {
+        const float value_re = re[2 * j - 1] - im[2 * j];
+        const float value_im = re[2 * j] + im[2 * j - 1];
+        if (hypotf(value_re, value_im) < CQT_KERNEL_THRESHOLD * largest)
+            continue;
+        if (reserve(cqt, *entry_count + 1, capacity))
+            return 1;
+        // Conjugated and divided by n, so that summing the products with the
+        // signal transform gives the inner product with the kernel
+        cqt->kernel_bins[*entry_count] = j;
+        cqt->kernel_re[*entry_count] = value_re / n;
+        cqt->kernel_im[*entry_count] = -value_im / n;
+        (*entry_count)++;
+    }
+    return 0;
+}
+
+int cqt_init(ConstantQ *cqt, uint32_t bins_per_octave, uint32_t bin_count,
+             float min_frequency, uint32_t sample_rate) {
+    memset(cqt, 0, sizeof(ConstantQ));
+    if (bins_per_octave == 0 || min_frequency <= 0)
+        return 1;
+    const double q = 1.0 / (exp2(1.0 / bins_per_octave) - 1);
+
+    // Each bin reaches up to its bandwidth above its center
+    uint32_t count = 0;
+    while (count < bin_count &&
+           cqt_bin_frequency(min_frequency, bins_per_octave, count) *
+                   (1 + 1 / q) <
+               sample_rate / 2.0)
+        count++;
+    if (count == 0)
+        return 1;
+    cqt->bin_count = count;
+    cqt->bins_per_octave = bins_per_octave;
+    cqt->min_frequency = min_frequency;
+
+    // Long enough for the kernel of the lowest bin
+    uint32_t fft_size = FFT_POW2_MIN_SIZE;
+    while (fft_size < q * sample_rate / min_frequency &&
+           fft_size < CQT_MAX_FFT_SIZE)
+        fft_size *= 2;
+    cqt->fft_size = fft_size;
+
+    cqt->transformer = create_fft_transformer(fft_size, FFT_UNSCALED_OUTPUT);
+    cqt->history = calloc(fft_size, sizeof(float));
+    cqt->buffer = malloc(fft_size * sizeof(float));
+    cqt->kernel_starts = calloc(count + 1, sizeof(uint32_t));
+    float *im = malloc(fft_size * sizeof(float));
+    int failed = !cqt->transformer || !cqt->history || !cqt->buffer ||
+                 !cqt->kernel_starts || !im;
+
+    size_t entry_count = 0, capacity = 0;
+    for (uint32_t bin = 0; bin < count && !failed; bin++) {
+        cqt->kernel_starts[bin] = entry_count;
+        failed = add_kernel(
+            cqt, cqt_bin_frequency(min_frequency, bins_per_octave, bin), q,
+            sample_rate, cqt->buffer, im, &entry_count, &capacity);
+    }
+    free(im);
+    if (failed) {
+        cqt_free(cqt);
+        return 1;
+    }
+    cqt->kernel_starts[count] = entry_count;
+    return 0;
+}
+
+void cqt_free(ConstantQ *cqt) {
+    if (cqt->transformer)
+        free_fft_transformer(cqt->transformer);
+    free(cqt->kernel_starts);
+    free(cqt->kernel_bins);
+    free(cqt->kernel_re);
+    free(cqt->kernel_im);
+    free(cqt->history);
+    free(cqt->buffer);
+    memset(cqt, 0, sizeof(ConstantQ));
+}
+
+void cqt_feed(ConstantQ *cqt, const float *frames, size_t frame_count,
+              uint32_t channels) {
+    const uint32_t mask = cqt->fft_size - 1;
+    const float scale = 1.0f / channels;
+    for (size_t i = 0; i < frame_count; i++) {
+        float mix = 0;
+        for (uint32_t channel = 0; channel < channels; channel++)
+            mix += frames[i * channels + channel];
+        cqt->history[cqt->history_position] = mix * scale;
+        cqt->history_position = (cqt->history_position + 1) & mask;
+    }
+}
+
+float cqt_process(ConstantQ *cqt, float *out_bins) {
+    const uint32_t n = cqt->fft_size, position = cqt->history_position;
+    float *buffer = cqt->buffer;
+    memcpy(buffer, cqt->history + position, (n - position) * sizeof(float));
+    memcpy(buffer + n - position, cqt->history, position * sizeof(float));
+    fft_forward(cqt->transformer, buffer);
+
+    float peak = 0;
+    for (uint32_t bin = 0; bin < cqt->bin_count; bin++) {
+        float re = 0, im = 0;
+        for (uint32_t i = cqt->kernel_starts[bin];
+             i < cqt->kernel_starts[bin + 1]; i++) {
+            const uint32_t j = cqt->kernel_bins[i];
+            const float x_re = buffer[2 * j - 1], x_im = buffer[2 * j];
+            re += x_re * cqt->kernel_re[i] - x_im * cqt->kernel_im[i];
+            im += x_re * cqt->kernel_im[i] + x_im * cqt->kernel_re[i];
+        }
+        out_bins[bin] = sqrtf(re * re + im * im);
+        peak = fmaxf(peak, out_bins[bin]);
+    }
+    return peak;
+}
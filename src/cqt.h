@@ -0,0 +1,83 @@
+#ifndef _CQT
+#define _CQT
+
+/*
+Constant-Q transform: magnitudes of geometrically spaced frequency bins whose
+bandwidth is a fixed fraction of their frequency, so that bass notes get as
+many bins per octave as treble ones.
+
+Computed as in Brown and Puckette's "An efficient algorithm for the
+calculation of a constant Q transform": each bin is the inner product of the
+signal with a windowed complex exponential as long as the bin needs. Those
+kernels are transformed once up front, and since their spectra are
+concentrated around their frequency, only the few large values are kept as a
+sparse matrix. Each transform is then one large FFT of the recent history and
+a pass over the sparse entries.
+
+Kernels end together at the newest sample, so every bin reflects the newest
+audio and low bins average over a longer past.
+*/
+
+#include "fft.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest FFT of the history. Kernels of low bins that would be longer are
+// shortened, widening those bins.
+#define CQT_MAX_FFT_SIZE 32768
+// Spectral kernel values below this fraction of the largest value of their
+// kernel are dropped.
+#define CQT_KERNEL_THRESHOLD 0.005
+
+typedef struct {
+    // Amount of bins, at most the amount requested from cqt_init().
+    uint32_t bin_count;
+    uint32_t bins_per_octave;
+    // Center frequency of the first bin in Hz.
+    float min_frequency;
+
+    // Samples in the history and its transform.
+    uint32_t fft_size;
+    FFTTransformer *transformer;
+    // Sparse kernels stored like a BandLayout (see bands.h): entries of bin
+    // `i` are at indices from `kernel_starts[i]` up to but not including
+    // `kernel_starts[i + 1]`. Each entry is a complex weight of a bin of the
+    // history transform.
+    uint32_t *kernel_starts;
+    uint32_t *kernel_bins;
+    float *kernel_re;
+    float *kernel_im;
+
+    // Ring of the newest `fft_size` mono samples, oldest at
+    // `history_position`.
+    float *history;
+    uint32_t history_position;
+    // History in order and then its transform.
+    float *buffer;
+} ConstantQ;
+
+// Creates kernels for `bin_count` bins, `bins_per_octave` per octave from
+// `min_frequency` Hz, of audio at `sample_rate`. Bins that do not fit below
+// the Nyquist frequency are left out. Returns 0 on success.
+int cqt_init(ConstantQ *cqt, uint32_t bins_per_octave, uint32_t bin_count,
+             float min_frequency, uint32_t sample_rate);
+// Frees memory used by `cqt`.
+void cqt_free(ConstantQ *cqt);
+// Adds `frame_count` interleaved `frames` of `channels` samples each to the
+// history, mixed to mono.
+void cqt_feed(ConstantQ *cqt, const float *frames, size_t frame_count,
+              uint32_t channels);
+// Writes the magnitude of each bin over the history into `out_bins`. A sine
+// wave at the center of a bin has half its amplitude there. Returns the
+// largest magnitude.
+float cqt_process(ConstantQ *cqt, float *out_bins);
+
+// Center frequency in Hz of bin `index`.
+static inline float cqt_bin_frequency(float min_frequency,
+                                      uint32_t bins_per_octave, size_t index) {
+    return min_frequency * exp2f((float)index / bins_per_octave);
+}
+
+#endif
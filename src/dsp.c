@@ -0,0 +1,94 @@
+#include "dsp.h"
+#include "dsp_kernels.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const DSPKernels *kernels = &dsp_kernels_sse;
+
+void dsp_use_kernels(SimdLevel level) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (level == SIMD_AVX2) {
+        kernels = &dsp_kernels_avx2;
+        return;
+    }
+#endif
+    (void)level;
+    kernels = &dsp_kernels_sse;
+}
+
+__attribute__((constructor)) static void select_kernels(void) {
+    dsp_use_kernels(simd_detect());
+}
+
+static const char *window_names[] = {
+    [NO_WINDOW] = "none",    [PARZEN] = "parzen",   [WELCH] = "welch",
+    [HANNING] = "hanning",   [HAMMING] = "hamming", [BLACKMAN] = "blackman",
+    [STEEPER] = "steeper",
+};
+
+float *dsp_window_create(FFTWindow type, size_t n) {
+    float *ones = malloc(n * sizeof(float));
+    if (!ones)
+        return 0;
+    for (size_t i = 0; i < n; i++)
+        ones[i] = 1;
+
+    if (type == NO_WINDOW)
+        return ones;
+
+    // Windowing a signal of all ones yields the window itself
+    float *table = windowing(n, ones, type, 1);
+    free(ones);
+    return table;
+}
+
+int dsp_window_from_name(const char *name, FFTWindow *out_type) {
+    for (size_t i = 0; i < sizeof window_names / sizeof *window_names; i++) {
+        if (window_names[i] && !strcmp(window_names[i], name)) {
+            *out_type = i;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void dsp_apply_window(float *output, const float *input, const float *window,
+                      size_t n) {
+    kernels->apply_window(output, input, window, n);
+}
+
+void dsp_deinterleave_window(float *const *outputs, const float *frames,
+                             size_t channels, const float *window, size_t n) {
+    if (channels == 1) {
+        kernels->apply_window(outputs[0], frames, window, n);
+        return;
+    }
+    if (channels == 2) {
+        kernels->deinterleave_stereo(outputs[0], outputs[1], frames, window,
+                                     n);
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++)
+        for (size_t channel = 0; channel < channels; channel++)
+            outputs[channel][i] = frames[i * channels + channel] * window[i];
+}
+
+float dsp_magnitudes(float *out_magnitudes, const float *spectrum,
+                     size_t bin_count) {
+    return kernels->magnitudes(out_magnitudes, spectrum, bin_count);
+}
+
+void dsp_scale(float *values, size_t n, float scale) {
+    kernels->scale(values, n, scale);
+}
+
+void dsp_add(float *accumulator, const float *values, size_t n) {
+    kernels->add(accumulator, values, n);
+}
+
+void dsp_half_difference(float *output, const float *a, const float *b,
+                         size_t n) {
+    kernels->half_difference(output, a, b, n);
+}
@@ -0,0 +1,51 @@
+#ifndef _DSP
+#define _DSP
+
+/*
+Signal processing kernels used in the analysis hot path.
+
+The kernels are built once for SSE and once for AVX2, see simd.h, and run with
+AVX2 when the CPU supports it.
+*/
+
+#include "fft.h"
+#include "simd.h"
+#include <stddef.h>
+
+// Returns a table of `n` coefficients of the windowing function `type`, to be
+// freed with free(). Returns 0 on failure.
+float *dsp_window_create(FFTWindow type, size_t n);
+// Parses a window name such as "hanning" into `out_type`. Returns 0 on success.
+int dsp_window_from_name(const char *name, FFTWindow *out_type);
+
+// Multiplies `n` samples of `input` with the window table `window`, writing the
+// result into `output`. `input` and `output` may be the same buffer.
+void dsp_apply_window(float *output, const float *input, const float *window,
+                      size_t n);
+
+// Splits `n` interleaved frames of `channels` samples in `frames` into one
+// buffer per channel in `outputs`, multiplying them with the window table
+// `window` in the same pass.
+void dsp_deinterleave_window(float *const *outputs, const float *frames,
+                             size_t channels, const float *window, size_t n);
+
+// Writes the magnitudes of the first `bin_count` frequency bins of `spectrum`
+// into `out_magnitudes`. `spectrum` is in the order produced by fft_forward():
+// DC, then real and imaginary parts of each bin, so it needs to hold at least
+// `bin_count * 2` values. Returns the largest magnitude.
+float dsp_magnitudes(float *out_magnitudes, const float *spectrum,
+                     size_t bin_count);
+
+// Multiplies `n` values in `values` by `scale`.
+void dsp_scale(float *values, size_t n, float scale);
+// Adds `n` values of `values` to the values in `accumulator`.
+void dsp_add(float *accumulator, const float *values, size_t n);
+// Writes half the difference of `n` values of `a` and `b` into `output`.
+void dsp_half_difference(float *output, const float *a, const float *b,
+                         size_t n);
+
+// Runs later calls with the kernels for `level`, which the CPU must support.
+// Those of simd_detect() are picked when the program starts.
+void dsp_use_kernels(SimdLevel level);
+
+#endif
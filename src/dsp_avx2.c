@@ -0,0 +1,132 @@
+#include "dsp_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+// Whatever the rest of the program targets, dsp.c only picks these kernels
+// when the CPU supports them
+#pragma GCC target("avx2")
+#include <immintrin.h>
+#include <math.h>
+
+static void apply_window(float *output, const float *input,
+                         const float *window, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(output + i,
+                         _mm256_mul_ps(_mm256_loadu_ps(input + i),
+                                       _mm256_loadu_ps(window + i)));
+    for (; i < n; i++)
+        output[i] = input[i] * window[i];
+}
+
+static void deinterleave_stereo(float *left, float *right, const float *frames,
+                                const float *window, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 low = _mm256_loadu_ps(frames + 2 * i);
+        __m256 high = _mm256_loadu_ps(frames + 2 * i + 8);
+        // Shuffles work within 128-bit lanes, the permute puts the resulting
+        // pairs of frames back in order.
+        __m256d even = _mm256_castps_pd(
+            _mm256_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m256d odd = _mm256_castps_pd(
+            _mm256_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m256 left_samples =
+            _mm256_castpd_ps(_mm256_permute4x64_pd(even, 0xd8));
+        __m256 right_samples =
+            _mm256_castpd_ps(_mm256_permute4x64_pd(odd, 0xd8));
+        __m256 coefficients = _mm256_loadu_ps(window + i);
+        _mm256_storeu_ps(left + i, _mm256_mul_ps(left_samples, coefficients));
+        _mm256_storeu_ps(right + i,
+                         _mm256_mul_ps(right_samples, coefficients));
+    }
+    for (; i < n; i++) {
+        left[i] = frames[2 * i] * window[i];
+        right[i] = frames[2 * i + 1] * window[i];
+    }
+}
+
+static float magnitudes(float *out_magnitudes, const float *spectrum,
+                        size_t bin_count) {
+    if (!bin_count)
+        return 0;
+
+    // DC has no imaginary part
+    out_magnitudes[0] = fabsf(spectrum[0]);
+    float maximum = out_magnitudes[0];
+
+    // Bin k has its real part at 2k - 1 and imaginary part at 2k
+    size_t k = 1;
+    __m256 maximums = _mm256_setzero_ps();
+    for (; k + 8 <= bin_count; k += 8) {
+        __m256 low = _mm256_loadu_ps(spectrum + 2 * k - 1);
+        __m256 high = _mm256_loadu_ps(spectrum + 2 * k + 7);
+        // Pairwise sums of squares come out with the 128-bit lanes
+        // interleaved, which the permute puts back in order.
+        __m256 sums = _mm256_hadd_ps(_mm256_mul_ps(low, low),
+                                     _mm256_mul_ps(high, high));
+        sums = _mm256_castpd_ps(
+            _mm256_permute4x64_pd(_mm256_castps_pd(sums), 0xd8));
+        __m256 values = _mm256_sqrt_ps(sums);
+        _mm256_storeu_ps(out_magnitudes + k, values);
+        maximums = _mm256_max_ps(maximums, values);
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, maximums);
+    for (size_t i = 0; i < 8; i++)
+        if (maximum < lanes[i])
+            maximum = lanes[i];
+
+    for (; k < bin_count; k++) {
+        float real = spectrum[2 * k - 1];
+        float imaginary = spectrum[2 * k];
+        out_magnitudes[k] = sqrtf(real * real + imaginary * imaginary);
+        if (maximum < out_magnitudes[k])
+            maximum = out_magnitudes[k];
+    }
+
+    return maximum;
+}
+
+static void scale(float *values, size_t n, float factor) {
+    size_t i = 0;
+    __m256 factors = _mm256_set1_ps(factor);
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(values + i,
+                         _mm256_mul_ps(_mm256_loadu_ps(values + i), factors));
+    for (; i < n; i++)
+        values[i] *= factor;
+}
+
+static void add(float *accumulator, const float *values, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(accumulator + i,
+                         _mm256_add_ps(_mm256_loadu_ps(accumulator + i),
+                                       _mm256_loadu_ps(values + i)));
+    for (; i < n; i++)
+        accumulator[i] += values[i];
+}
+
+static void half_difference(float *output, const float *a, const float *b,
+                            size_t n) {
+    size_t i = 0;
+    __m256 half = _mm256_set1_ps(0.5);
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(
+            output + i,
+            _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(a + i),
+                                        _mm256_loadu_ps(b + i)),
+                          half));
+    for (; i < n; i++)
+        output[i] = (a[i] - b[i]) * 0.5;
+}
+
+const DSPKernels dsp_kernels_avx2 = {
+    .apply_window = apply_window,
+    .magnitudes = magnitudes,
+    .scale = scale,
+    .add = add,
+    .half_difference = half_difference,
+    .deinterleave_stereo = deinterleave_stereo,
+};
+#endif
@@ -0,0 +1,29 @@
+#ifndef _DSP_KERNELS
+#define _DSP_KERNELS
+
+/*
+Kernels of dsp.c, one table for each instruction set, in dsp_sse.c and
+dsp_avx2.c. Each handles the values past its last whole vector itself.
+*/
+
+#include <stddef.h>
+
+typedef struct {
+    // See the functions of the same name in dsp.h.
+    void (*apply_window)(float *output, const float *input,
+                         const float *window, size_t n);
+    float (*magnitudes)(float *out_magnitudes, const float *spectrum,
+                        size_t bin_count);
+    void (*scale)(float *values, size_t n, float scale);
+    void (*add)(float *accumulator, const float *values, size_t n);
+    void (*half_difference)(float *output, const float *a, const float *b,
+                            size_t n);
+    // dsp_deinterleave_window() for two channels.
+    void (*deinterleave_stereo)(float *left, float *right, const float *frames,
+                                const float *window, size_t n);
+} DSPKernels;
+
+extern const DSPKernels dsp_kernels_sse;
+extern const DSPKernels dsp_kernels_avx2;
+
+#endif
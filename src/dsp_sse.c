@@ -0,0 +1,130 @@
+#include "dsp_kernels.h"
+
+#include <math.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+static void apply_window(float *output, const float *input,
+                         const float *window, size_t n) {
+    size_t i = 0;
+#if defined(__SSE__)
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(output + i, _mm_mul_ps(_mm_loadu_ps(input + i),
+                                             _mm_loadu_ps(window + i)));
+#endif
+    for (; i < n; i++)
+        output[i] = input[i] * window[i];
+}
+
+static void deinterleave_stereo(float *left, float *right, const float *frames,
+                                const float *window, size_t n) {
+    size_t i = 0;
+#if defined(__SSE__)
+    for (; i + 4 <= n; i += 4) {
+        __m128 low = _mm_loadu_ps(frames + 2 * i);
+        __m128 high = _mm_loadu_ps(frames + 2 * i + 4);
+        __m128 coefficients = _mm_loadu_ps(window + i);
+        _mm_storeu_ps(left + i,
+                      _mm_mul_ps(_mm_shuffle_ps(low, high,
+                                                _MM_SHUFFLE(2, 0, 2, 0)),
+                                 coefficients));
+        _mm_storeu_ps(right + i,
+                      _mm_mul_ps(_mm_shuffle_ps(low, high,
+                                                _MM_SHUFFLE(3, 1, 3, 1)),
+                                 coefficients));
+    }
+#endif
+    for (; i < n; i++) {
+        left[i] = frames[2 * i] * window[i];
+        right[i] = frames[2 * i + 1] * window[i];
+    }
+}
+
+static float magnitudes(float *out_magnitudes, const float *spectrum,
+                        size_t bin_count) {
+    if (!bin_count)
+        return 0;
+
+    // DC has no imaginary part
+    out_magnitudes[0] = fabsf(spectrum[0]);
+    float maximum = out_magnitudes[0];
+
+    // Bin k has its real part at 2k - 1 and imaginary part at 2k
+    size_t k = 1;
+#if defined(__SSE__)
+    __m128 maximums = _mm_setzero_ps();
+    for (; k + 4 <= bin_count; k += 4) {
+        __m128 low = _mm_loadu_ps(spectrum + 2 * k - 1);
+        __m128 high = _mm_loadu_ps(spectrum + 2 * k + 3);
+        __m128 real = _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 imaginary = _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 values = _mm_sqrt_ps(_mm_add_ps(
+            _mm_mul_ps(real, real), _mm_mul_ps(imaginary, imaginary)));
+        _mm_storeu_ps(out_magnitudes + k, values);
+        maximums = _mm_max_ps(maximums, values);
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, maximums);
+    for (size_t i = 0; i < 4; i++)
+        if (maximum < lanes[i])
+            maximum = lanes[i];
+#endif
+    for (; k < bin_count; k++) {
+        float real = spectrum[2 * k - 1];
+        float imaginary = spectrum[2 * k];
+        out_magnitudes[k] = sqrtf(real * real + imaginary * imaginary);
+        if (maximum < out_magnitudes[k])
+            maximum = out_magnitudes[k];
+    }
+
+    return maximum;
+}
+
+static void scale(float *values, size_t n, float factor) {
+    size_t i = 0;
+#if defined(__SSE__)
+    __m128 factors = _mm_set1_ps(factor);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(values + i,
+                      _mm_mul_ps(_mm_loadu_ps(values + i), factors));
+#endif
+    for (; i < n; i++)
+        values[i] *= factor;
+}
+
+static void add(float *accumulator, const float *values, size_t n) {
+    size_t i = 0;
+#if defined(__SSE__)
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(accumulator + i, _mm_add_ps(_mm_loadu_ps(accumulator + i),
+                                                  _mm_loadu_ps(values + i)));
+#endif
+    for (; i < n; i++)
+        accumulator[i] += values[i];
+}
+
+static void half_difference(float *output, const float *a, const float *b,
+                            size_t n) {
+    size_t i = 0;
+#if defined(__SSE__)
+    __m128 half = _mm_set1_ps(0.5);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(output + i,
+                      _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(a + i),
+                                            _mm_loadu_ps(b + i)),
+                                 half));
+#endif
+    for (; i < n; i++)
+        output[i] = (a[i] - b[i]) * 0.5;
+}
+
+const DSPKernels dsp_kernels_sse = {
+    .apply_window = apply_window,
+    .magnitudes = magnitudes,
+    .scale = scale,
+    .add = add,
+    .half_difference = half_difference,
+    .deinterleave_stereo = deinterleave_stereo,
+};
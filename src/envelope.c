@@ -0,0 +1,53 @@
+#include "envelope.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Coefficient of a one-pole filter with time constant `time`, updated every
+// `hop_duration` seconds. A time of zero follows instantly.
+static inline float coefficient(float time, float hop_duration) {
+    return time > 0 ? 1 - expf(-hop_duration / time) : 1;
+}
+
+int envelope_init(EnvelopeBank *bank, uint32_t count, float attack,
+                  float release, float hop_duration) {
+    memset(bank, 0, sizeof(EnvelopeBank));
+    bank->count = count;
+    bank->attack = coefficient(attack, hop_duration);
+    bank->release = coefficient(release, hop_duration);
+    bank->agc_release = expf(-hop_duration / ENVELOPE_AGC_RELEASE);
+    bank->peaks = malloc(count * sizeof(float));
+    bank->envelopes = calloc(count, sizeof(float));
+    if (!bank->peaks || !bank->envelopes)
+        return 1;
+    for (uint32_t i = 0; i < count; i++)
+        bank->peaks[i] = ENVELOPE_AGC_FLOOR;
+    return 0;
+}
+
+void envelope_free(EnvelopeBank *bank) {
+    free(bank->peaks);
+    bank->peaks = 0;
+    free(bank->envelopes);
+    bank->envelopes = 0;
+}
+
+void envelope_process(EnvelopeBank *bank, const float *levels,
+                      float *out_envelopes) {
+    for (uint32_t i = 0; i < bank->count; i++) {
+        float peak = bank->peaks[i] * bank->agc_release;
+        if (peak < levels[i])
+            peak = levels[i];
+        if (peak < ENVELOPE_AGC_FLOOR)
+            peak = ENVELOPE_AGC_FLOOR;
+        bank->peaks[i] = peak;
+
+        const float level = levels[i] / peak;
+        float envelope = bank->envelopes[i];
+        envelope += (level - envelope) *
+                    (level > envelope ? bank->attack : bank->release);
+        bank->envelopes[i] = envelope;
+        out_envelopes[i] = envelope;
+    }
+}
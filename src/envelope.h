@@ -0,0 +1,51 @@
+#ifndef _ENVELOPE
+#define _ENVELOPE
+
+/*
+Envelope followers over a bank of levels that are updated once per hop.
+
+Each follower is a one-pole filter that moves towards a louder level within
+the attack time and towards a quieter one within the release time. The
+coefficients come from the hop duration, so an envelope moves the same amount
+per second whatever the hop size, and scenes read it as is instead of
+smoothing frame by frame.
+
+Before following, each level is divided by its own peak, which rises
+instantly and falls over ENVELOPE_AGC_RELEASE seconds (automatic gain
+control), so that quiet bands such as the treble reach 1.0 as readily as the
+bass.
+*/
+
+#include <stdint.h>
+
+// Time in seconds for the peak of a band to fall to about a third once the
+// band gets quieter.
+#define ENVELOPE_AGC_RELEASE 10.0
+// Lowest peak, so that near silence is not amplified to full scale.
+#define ENVELOPE_AGC_FLOOR 0.001
+
+typedef struct {
+    uint32_t count;
+    // Fraction of the distance to the new level covered each hop.
+    float attack;
+    float release;
+    // Factor by which peaks fall each hop.
+    float agc_release;
+    float *peaks;
+    float *envelopes;
+} EnvelopeBank;
+
+// Initializes `bank` with `count` followers updated every `hop_duration`
+// seconds, with `attack` and `release` times in seconds, i.e. the time to
+// cover about two thirds of a step in level. Returns 0 on success.
+int envelope_init(EnvelopeBank *bank, uint32_t count, float attack,
+                  float release, float hop_duration);
+// Frees memory used by `bank`.
+void envelope_free(EnvelopeBank *bank);
+
+// Follows the `count` levels of one hop in `levels`, and writes the
+// envelopes, between 0.0 and 1.0, into `out_envelopes`.
+void envelope_process(EnvelopeBank *bank, const float *levels,
+                      float *out_envelopes);
+
+#endif
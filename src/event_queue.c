@@ -0,0 +1,77 @@
+#include "event_queue.h"
+
+#include <stdlib.h>
+
+int eventqueue_init(EventQueue *queue, size_t capacity) {
+    size_t size = 2;
+    while (size < capacity)
+        size *= 2;
+
+    queue->slots = malloc(size * sizeof(EventSlot));
+    if (!queue->slots)
+        return 1;
+    queue->mask = size - 1;
+
+    // A slot is free for the producer claiming position `i` when its sequence
+    // is `i`, and holds an event for the consumer when it is `i + 1`.
+    for (size_t i = 0; i < size; i++)
+        atomic_init(&queue->slots[i].sequence, i);
+    atomic_init(&queue->enqueue_position, 0);
+    queue->dequeue_position = 0;
+    atomic_init(&queue->dropped, 0);
+    return 0;
+}
+
+void eventqueue_free(EventQueue *queue) {
+    free(queue->slots);
+    queue->slots = 0;
+}
+
+int eventqueue_push(EventQueue *queue, const Event *event) {
+    uint64_t position =
+        atomic_load_explicit(&queue->enqueue_position, memory_order_relaxed);
+
+    for (;;) {
+        EventSlot *slot = &queue->slots[position & queue->mask];
+        uint64_t sequence =
+            atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+        if (sequence == position) {
+            // Free slot, try to claim it. On failure `position` is updated to
+            // the current enqueue position.
+            if (atomic_compare_exchange_weak_explicit(
+                    &queue->enqueue_position, &position, position + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                slot->event = *event;
+                atomic_store_explicit(&slot->sequence, position + 1,
+                                      memory_order_release);
+                return 0;
+            }
+        } else if (sequence < position) {
+            // The slot still holds an event from one lap ago
+            atomic_fetch_add_explicit(&queue->dropped, 1,
+                                      memory_order_relaxed);
+            return 1;
+        } else {
+            // Another producer claimed this position first
+            position = atomic_load_explicit(&queue->enqueue_position,
+                                            memory_order_relaxed);
+        }
+    }
+}
+
+int eventqueue_pop(EventQueue *queue, Event *out_event) {
+    uint64_t position = queue->dequeue_position;
+    EventSlot *slot = &queue->slots[position & queue->mask];
+
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) !=
+        position + 1)
+        return 1;
+
+    *out_event = slot->event;
+    // Free the slot for the producer one lap ahead
+    atomic_store_explicit(&slot->sequence, position + queue->mask + 1,
+                          memory_order_release);
+    queue->dequeue_position = position + 1;
+    return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef _EVENT_QUEUE
+#define _EVENT_QUEUE
+
+/*
+Lock-free bounded multi-producer single-consumer queue of timestamped events.
+
+Producers (the JACK process callback for MIDI, the analysis for detected
+onsets) never block: pushing into a full queue fails and the event is dropped.
+Each slot carries a sequence number that tells producers and the consumer
+whether it is free or holds a published event, so the only contention between
+producers is a compare-and-swap on the enqueue position.
+*/
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef enum {
+    EVENT_NOTE_ON = 0,
+    EVENT_NOTE_OFF,
+    // An onset detected in the captured audio. The note is the OnsetBand.
+    EVENT_ONSET,
+    // A MIDI program change. The note is the program number.
+    EVENT_PROGRAM_CHANGE,
+} EventType;
+
+typedef struct {
+    // Time on CLOCK_MONOTONIC, in nanoseconds, when the event occurred at the
+    // input. See eventqueue_now().
+    uint64_t time;
+    // Position of the event in the captured audio stream, in frames.
+    uint64_t frame;
+    uint8_t type;
+    uint8_t note;
+    // Between 0 and 127, like MIDI velocities.
+    uint8_t velocity;
+    uint8_t channel;
+} Event;
+
+typedef struct {
+    _Atomic uint64_t sequence;
+    Event event;
+} EventSlot;
+
+typedef struct {
+    EventSlot *slots;
+    // Capacity minus one, the capacity is always a power of two.
+    uint64_t mask;
+    // Kept on separate cache lines, the producers and the consumer would
+    // otherwise invalidate each other's caches on every event.
+    _Alignas(64) _Atomic uint64_t enqueue_position;
+    _Alignas(64) uint64_t dequeue_position;
+    // Amount of events dropped because the queue was full.
+    _Atomic uint64_t dropped;
+} EventQueue;
+
+// Allocates a queue for at least `capacity` events. Returns 0 on success.
+int eventqueue_init(EventQueue *queue, size_t capacity);
+// Frees memory used by `queue`.
+void eventqueue_free(EventQueue *queue);
+
+// Producer side: appends a copy of `event`. Returns 0 on success, or 1 if the
+// queue is full and the event was dropped. Safe to call from any thread,
+// including realtime audio callbacks.
+int eventqueue_push(EventQueue *queue, const Event *event);
+// Consumer side: removes the oldest event into `out_event`. Returns 0 on
+// success, or 1 if the queue is empty. Only one thread may consume.
+int eventqueue_pop(EventQueue *queue, Event *out_event);
+
+// Current time in the same clock and unit as Event.time.
+static inline uint64_t eventqueue_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,255 @@
+#include "feature_file.h"
+#include "bands.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Rounds `size` up to the next multiple of FEATURES_ALIGNMENT.
+static inline size_t align(size_t size) {
+    return (size + FEATURES_ALIGNMENT - 1) / FEATURES_ALIGNMENT *
+           FEATURES_ALIGNMENT;
+}
+
+// Fills in the offsets and sizes of `header` from its counts.
+static void create_layout(FeatureHeader *header) {
+    uint32_t offset = 0;
+    header->onsets_offset = offset;
+    offset += ONSET_BAND_COUNT;
+    header->log_bands_offset = offset;
+    offset += header->log_band_count;
+    header->mel_bands_offset = offset;
+    offset += header->mel_band_count;
+    header->third_octave_bands_offset = offset;
+    offset += header->third_octave_band_count;
+    header->envelopes_offset = offset;
+    offset += header->log_band_count + 1;
+    header->harmony_offset = offset;
+    offset += FEATURES_HARMONY_SIZE;
+    header->loudness_offset = offset;
+    offset += FEATURES_LOUDNESS_SIZE;
+    header->cqt_bins_offset = offset;
+    offset += header->cqt_bin_count;
+    // The spectrum starts on a vector boundary
+    offset = (offset + 15) / 16 * 16;
+    header->frequencies_offset = offset;
+    offset += header->frequency_count;
+
+    header->header_size = align(sizeof(FeatureHeader));
+    header->record_size = align(offset * sizeof(float));
+}
+
+int featurefile_create(FeatureFile *file, const char *path,
+                       FeatureHeader *header) {
+    memcpy(header->magic, FEATURES_MAGIC, sizeof(header->magic));
+    header->version = FEATURES_VERSION;
+    header->byte_order = FEATURES_BYTE_ORDER;
+    header->reserved = 0;
+    create_layout(header);
+
+    size_t size = header->header_size + header->record_count *
+                                            (size_t)header->record_size;
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return 1;
+    if (ftruncate(fd, size)) {
+        close(fd);
+        return 1;
+    }
+    void *data = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return 1;
+
+    file->header = data;
+    file->size = size;
+    memcpy(file->header, header, sizeof(FeatureHeader));
+    return 0;
+}
+
+// Whether `count` floats at `offset` fit in a record of `header`.
+static int field_fits(const FeatureHeader *header, uint32_t offset,
+                      uint32_t count) {
+    return (uint64_t)offset + count <= header->record_size / sizeof(float);
+}
+
+// Whether the header of a mapped file of `size` bytes describes a layout that
+// only refers to data within it.
+static int header_is_valid(const FeatureHeader *header, size_t size) {
+    if (memcmp(header->magic, FEATURES_MAGIC, sizeof(header->magic)) ||
+        header->version != FEATURES_VERSION ||
+        header->byte_order != FEATURES_BYTE_ORDER)
+        return 0;
+
+    // Records are read in place, so they need to be aligned as well
+    if (header->header_size < sizeof(FeatureHeader) ||
+        header->header_size > size ||
+        header->header_size % FEATURES_ALIGNMENT ||
+        header->record_size == 0 || header->record_size % FEATURES_ALIGNMENT)
+        return 0;
+    if (header->record_count >
+        (size - header->header_size) / header->record_size)
+        return 0;
+
+    // Divided by when looking up records and positions
+    if (header->sample_rate == 0 || header->hop_size == 0)
+        return 0;
+
+    return header->frequency_count <= MAX_FREQUENCY_COUNT &&
+           header->log_band_count <= MAX_BANDS &&
+           header->mel_band_count <= MAX_BANDS &&
+           header->third_octave_band_count <= MAX_THIRD_OCTAVE_BANDS &&
+           header->cqt_bin_count <= MAX_CQT_BINS &&
+           header->cqt_bins_per_octave <= MAX_CQT_BINS_PER_OCTAVE &&
+           (header->cqt_bins_per_octave || !header->cqt_bin_count) &&
+           field_fits(header, header->onsets_offset, ONSET_BAND_COUNT) &&
+           field_fits(header, header->log_bands_offset,
+                      header->log_band_count) &&
+           field_fits(header, header->mel_bands_offset,
+                      header->mel_band_count) &&
+           field_fits(header, header->third_octave_bands_offset,
+                      header->third_octave_band_count) &&
+           field_fits(header, header->envelopes_offset,
+                      header->log_band_count + 1) &&
+           field_fits(header, header->harmony_offset, FEATURES_HARMONY_SIZE) &&
+           field_fits(header, header->loudness_offset,
+                      FEATURES_LOUDNESS_SIZE) &&
+           field_fits(header, header->cqt_bins_offset,
+                      header->cqt_bin_count) &&
+           field_fits(header, header->frequencies_offset,
+                      header->frequency_count);
+}
+
+int featurefile_open(FeatureFile *file, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 1;
+    struct stat info;
+    if (fstat(fd, &info) || (size_t)info.st_size < sizeof(FeatureHeader)) {
+        close(fd);
+        return 1;
+    }
+    void *data = mmap(0, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return 1;
+
+    if (!header_is_valid(data, info.st_size)) {
+        munmap(data, info.st_size);
+        return 1;
+    }
+
+    file->header = data;
+    file->size = info.st_size;
+    return 0;
+}
+
+void featurefile_close(FeatureFile *file) {
+    if (!file->header)
+        return;
+    munmap(file->header, file->size);
+    file->header = 0;
+    file->size = 0;
+}
+
+void featurefile_write_metrics(FeatureFile *file, uint64_t index,
+                               const AudioMetrics *metrics) {
+    const FeatureHeader *header = file->header;
+    float *record = featurefile_record(file, index);
+
+    memcpy(record + header->onsets_offset, metrics->onsets,
+           ONSET_BAND_COUNT * sizeof(float));
+    memcpy(record + header->log_bands_offset, metrics->log_bands,
+           header->log_band_count * sizeof(float));
+    memcpy(record + header->mel_bands_offset, metrics->mel_bands,
+           header->mel_band_count * sizeof(float));
+    memcpy(record + header->third_octave_bands_offset,
+           metrics->third_octave_bands,
+           header->third_octave_band_count * sizeof(float));
+    memcpy(record + header->envelopes_offset, metrics->band_envelopes,
+           header->log_band_count * sizeof(float));
+    record[header->envelopes_offset + header->log_band_count] =
+        metrics->level_envelope;
+    memcpy(record + header->cqt_bins_offset, metrics->cqt_bins,
+           header->cqt_bin_count * sizeof(float));
+    memcpy(record + header->frequencies_offset, metrics->frequencies,
+           header->frequency_count * sizeof(float));
+
+    float *harmony = record + header->harmony_offset;
+    memcpy(harmony, metrics->harmony.chroma, sizeof(metrics->harmony.chroma));
+    harmony[PITCH_CLASS_COUNT] = metrics->harmony.key;
+    harmony[PITCH_CLASS_COUNT + 1] = metrics->harmony.chord;
+    harmony[PITCH_CLASS_COUNT + 2] = metrics->harmony.key_confidence;
+    harmony[PITCH_CLASS_COUNT + 3] = metrics->harmony.chord_confidence;
+
+    float *loudness = record + header->loudness_offset;
+    loudness[0] = metrics->loudness.momentary;
+    loudness[1] = metrics->loudness.short_term;
+    loudness[2] = metrics->loudness.rms;
+    loudness[3] = metrics->loudness.true_peak;
+}
+
+// A key or chord stored as a float, which holds it exactly. Values that are
+// not one, e.g. from a damaged file, read as C major so that they can still be
+// named.
+static inline uint32_t harmony_from_float(float value) {
+    return value >= 0 && value < HARMONY_COUNT ? (uint32_t)value : 0;
+}
+
+void featurefile_read_metrics(const FeatureFile *file, uint64_t index,
+                              AudioMetrics *out_metrics) {
+    const FeatureHeader *header = file->header;
+    const float *record = featurefile_record(file, index);
+
+    out_metrics->frequency_count = header->frequency_count;
+    out_metrics->frequency_resolution = header->frequency_resolution;
+    memcpy(out_metrics->frequencies, record + header->frequencies_offset,
+           header->frequency_count * sizeof(float));
+    bands_prefix_sums(out_metrics->frequencies, header->frequency_count,
+                      out_metrics->frequency_sums);
+    memset(out_metrics->side_frequencies, 0,
+           header->frequency_count * sizeof(float));
+    out_metrics->channel_count = 0;
+
+    out_metrics->log_band_count = header->log_band_count;
+    memcpy(out_metrics->log_bands, record + header->log_bands_offset,
+           header->log_band_count * sizeof(float));
+    out_metrics->mel_band_count = header->mel_band_count;
+    memcpy(out_metrics->mel_bands, record + header->mel_bands_offset,
+           header->mel_band_count * sizeof(float));
+    out_metrics->third_octave_band_count = header->third_octave_band_count;
+    memcpy(out_metrics->third_octave_bands,
+           record + header->third_octave_bands_offset,
+           header->third_octave_band_count * sizeof(float));
+    memcpy(out_metrics->band_envelopes, record + header->envelopes_offset,
+           header->log_band_count * sizeof(float));
+    out_metrics->level_envelope =
+        record[header->envelopes_offset + header->log_band_count];
+    out_metrics->cqt_bin_count = header->cqt_bin_count;
+    out_metrics->cqt_bins_per_octave = header->cqt_bins_per_octave;
+    memcpy(out_metrics->cqt_bins, record + header->cqt_bins_offset,
+           header->cqt_bin_count * sizeof(float));
+
+    const float *harmony = record + header->harmony_offset;
+    memcpy(out_metrics->harmony.chroma, harmony,
+           sizeof(out_metrics->harmony.chroma));
+    out_metrics->harmony.key = harmony_from_float(harmony[PITCH_CLASS_COUNT]);
+    out_metrics->harmony.chord =
+        harmony_from_float(harmony[PITCH_CLASS_COUNT + 1]);
+    out_metrics->harmony.key_confidence = harmony[PITCH_CLASS_COUNT + 2];
+    out_metrics->harmony.chord_confidence = harmony[PITCH_CLASS_COUNT + 3];
+
+    const float *loudness = record + header->loudness_offset;
+    out_metrics->loudness = (Loudness){
+        .momentary = loudness[0],
+        .short_term = loudness[1],
+        .rms = loudness[2],
+        .true_peak = loudness[3],
+    };
+
+    memcpy(out_metrics->onsets, record + header->onsets_offset,
+           ONSET_BAND_COUNT * sizeof(float));
+    out_metrics->beat = out_metrics->onsets[ONSET_KICK] > 0;
+}
@@ -0,0 +1,128 @@
+#ifndef _FEATURE_FILE
+#define _FEATURE_FILE
+
+/*
+File of precomputed per-hop audio features, written by offline analysis (see
+offline.h) and meant to be memory-mapped.
+
+The file starts with a FeatureHeader, followed by one fixed-size record per hop
+of analysis. Record `i` holds the features of the window that ends at frame
+`(i + 1) * hop_size`, so any point in time is found without searching. A record
+is an array of floats: the onset strengths, the log, mel and 1/3-octave bands,
+the envelopes, harmony and loudness, the constant-Q bins and the spectrum of
+the mix, at the offsets given in the header. Records are aligned to
+FEATURES_ALIGNMENT bytes so that they can be used in place.
+
+All values are in native byte order; `byte_order` tells whether a file was
+written on a machine with a different one. The version is increased whenever
+the layout changes.
+*/
+
+#include "analyze.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define FEATURES_MAGIC "MUSCFEAT"
+#define FEATURES_VERSION 2
+#define FEATURES_BYTE_ORDER 0x01020304
+#define FEATURES_ALIGNMENT 64
+// Floats of the harmony in a record: the chroma, then the key, the chord and
+// their confidences.
+#define FEATURES_HARMONY_SIZE (PITCH_CLASS_COUNT + 4)
+// Floats of the loudness in a record, in the order of the Loudness fields.
+#define FEATURES_LOUDNESS_SIZE 4
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    // Size of the header in bytes, records start right after it.
+    uint32_t header_size;
+    // Distance in bytes between the starts of consecutive records.
+    uint32_t record_size;
+
+    uint32_t sample_rate;
+    uint32_t input_size;
+    uint32_t hop_size;
+    uint32_t channels;
+    uint32_t frequency_count;
+    uint32_t log_band_count;
+    uint32_t mel_band_count;
+    uint32_t third_octave_band_count;
+    // 0 if the constant-Q transform was not enabled.
+    uint32_t cqt_bin_count;
+    uint32_t cqt_bins_per_octave;
+
+    // Offsets of the fields within each record, in floats.
+    uint32_t onsets_offset;
+    uint32_t log_bands_offset;
+    uint32_t mel_bands_offset;
+    uint32_t third_octave_bands_offset;
+    // `log_band_count` band envelopes followed by the level envelope.
+    uint32_t envelopes_offset;
+    uint32_t harmony_offset;
+    uint32_t loudness_offset;
+    uint32_t cqt_bins_offset;
+    uint32_t frequencies_offset;
+
+    // Width of each frequency bin in Hz.
+    float frequency_resolution;
+    // Magnitude that the spectra were normalized to, the loudest in the file.
+    float maximum;
+    uint32_t reserved;
+
+    uint64_t record_count;
+    // Amount of frames in the analyzed audio.
+    uint64_t frame_count;
+} FeatureHeader;
+
+typedef struct {
+    // Start of the mapped file, which begins with the header.
+    FeatureHeader *header;
+    size_t size;
+} FeatureFile;
+
+// Creates the file at `path` with room for `header->record_count` records and
+// maps it for writing. The fields describing the analysis need to be set in
+// `header`, the layout is filled in. Returns 0 on success.
+int featurefile_create(FeatureFile *file, const char *path,
+                       FeatureHeader *header);
+// Maps the existing file at `path` for reading. Returns 0 on success, or 1 if
+// the file cannot be read, is not a feature file of this version, or its
+// header describes records that do not fit in it.
+int featurefile_open(FeatureFile *file, const char *path);
+// Unmaps `file`, writing any changes.
+void featurefile_close(FeatureFile *file);
+
+// The record of the window ending at frame `(index + 1) * hop_size`.
+static inline float *featurefile_record(const FeatureFile *file,
+                                        uint64_t index) {
+    return (float *)((char *)file->header + file->header->header_size +
+                     index * file->header->record_size);
+}
+
+// Finds the record of the newest window that ends at or before `frame` and
+// writes its index into `out_index`. Past the end of the file this is the last
+// record. Returns 1 if no window ends before `frame`.
+static inline int featurefile_record_at(const FeatureFile *file, uint64_t frame,
+                                        uint64_t *out_index) {
+    uint64_t windows = frame / file->header->hop_size;
+    if (windows == 0 || file->header->record_count == 0)
+        return 1;
+    *out_index = windows <= file->header->record_count
+                     ? windows - 1
+                     : file->header->record_count - 1;
+    return 0;
+}
+
+// Stores the features in `metrics` as the record at `index`.
+void featurefile_write_metrics(FeatureFile *file, uint64_t index,
+                               const AudioMetrics *metrics);
+// Fills the frequency content, bands, envelopes, harmony, loudness and onsets
+// of `out_metrics` from the record at `index`. A kick onset is a beat.
+// Per-channel and side spectra are not stored, so `channel_count` is 0 and the
+// side spectrum is silent.
+void featurefile_read_metrics(const FeatureFile *file, uint64_t index,
+                              AudioMetrics *out_metrics);
+
+#endif
@@ -0,0 +1,95 @@
+#include "fft_pow2.h"
+#include "fft_pow2_kernels.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+static const FFTPow2Kernels *kernels = &fft_pow2_kernels_sse;
+
+void fft_pow2_use_kernels(SimdLevel level) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (level == SIMD_AVX2) {
+        kernels = &fft_pow2_kernels_avx2;
+        return;
+    }
+#endif
+    (void)level;
+    kernels = &fft_pow2_kernels_sse;
+}
+
+__attribute__((constructor)) static void select_kernels(void) {
+    fft_pow2_use_kernels(simd_detect());
+}
+
+static float *table(size_t n) {
+    float *values = malloc(n * sizeof(float));
+    if (!values)
+        abort();
+    return values;
+}
+
+int fft_pow2_supported(size_t n) {
+    return n >= FFT_POW2_MIN_SIZE && (n & (n - 1)) == 0;
+}
+
+FFTPow2Plan *fft_pow2_create(size_t n) {
+    if (!fft_pow2_supported(n))
+        return 0;
+    FFTPow2Plan *plan = malloc(sizeof(FFTPow2Plan));
+    if (!plan)
+        abort();
+    plan->n = n;
+    plan->m = n / 2;
+    const size_t half = plan->m / 2;
+
+    for (size_t t = 0; t < 3; t++) {
+        // The radix-4 stages reach three quarters around the circle
+        const size_t size = t == 0 ? 3 * plan->m / 4 : half;
+        plan->twiddle_re[t] = table(size);
+        plan->twiddle_im[t] = table(size);
+        for (size_t j = 0; j < size; j++) {
+            // Stage with stride 2^t uses the twiddle of j rounded down to it
+            const double angle = -2 * M_PI * (double)(j >> t << t) / plan->m;
+            plan->twiddle_re[t][j] = cos(angle);
+            plan->twiddle_im[t][j] = sin(angle);
+        }
+    }
+
+    plan->split_cos = table(plan->m);
+    plan->split_sin = table(plan->m);
+    for (size_t k = 0; k < plan->m; k++) {
+        plan->split_cos[k] = cos(2 * M_PI * (double)k / n);
+        plan->split_sin[k] = sin(2 * M_PI * (double)k / n);
+    }
+
+    for (size_t i = 0; i < 2; i++) {
+        plan->work_re[i] = table(plan->m);
+        plan->work_im[i] = table(plan->m);
+    }
+    return plan;
+}
+
+void fft_pow2_free(FFTPow2Plan *plan) {
+    if (!plan)
+        return;
+    for (size_t t = 0; t < 3; t++) {
+        free(plan->twiddle_re[t]);
+        free(plan->twiddle_im[t]);
+    }
+    free(plan->split_cos);
+    free(plan->split_sin);
+    for (size_t i = 0; i < 2; i++) {
+        free(plan->work_re[i]);
+        free(plan->work_im[i]);
+    }
+    free(plan);
+}
+
+void fft_pow2_forward(FFTPow2Plan *plan, float *data, float scale) {
+    kernels->forward(plan, data, scale);
+}
+
+void fft_pow2_forward_pair(FFTPow2Plan *plan, float *first, float *second,
+                           float scale) {
+    kernels->forward_pair(plan, first, second, scale);
+}
@@ -0,0 +1,69 @@
+#ifndef _FFT_POW2
+#define _FFT_POW2
+
+/*
+Real FFT for power of two sizes, used by fft_forward() in place of FFTPACK for
+those sizes, with the same output layout: r[0] is the DC term, r[2k-1] and
+r[2k] the real and imaginary part of bin k, and r[n-1] the Nyquist term.
+
+The n real samples are transformed as n/2 complex samples, with a Stockham
+FFT that needs no bit reversal, and then split into the spectrum of the real
+signal. Real and imaginary parts are kept in separate arrays so every stage
+works on whole vectors. Stages are radix-4, each doing the work of two radix-2
+stages in one pass over the data, apart from radix-2 stages for the strides
+below a vector and for the last stage of an odd power of two. Each stage picks
+a kernel for its stride. The sizes used for analysis, 512 to 8192 samples,
+have their own copy of the transform with the size as a constant.
+
+Two real signals can also be transformed at once, as the real and imaginary
+parts of one complex signal whose spectrum is then split in two by conjugate
+symmetry. That skips the deinterleaving and the twiddles of the split of two
+separate transforms.
+
+The transform is built once for SSE and once for AVX2, see simd.h, and runs
+with the AVX2 kernels when the CPU supports them.
+*/
+
+#include "simd.h"
+
+#include <stddef.h>
+
+// Smallest size handled, smaller ones stay with FFTPACK.
+#define FFT_POW2_MIN_SIZE 16
+
+typedef struct {
+    // Real samples, and the complex samples they are transformed as.
+    size_t n;
+    size_t m;
+    // exp(-2πik/m) for k < 3m/4, and for k < m/2 repeated in pairs and quads
+    // for the stages with strides 2 and 4.
+    float *twiddle_re[3];
+    float *twiddle_im[3];
+    // cos(2πk/n) and sin(2πk/n) for k < m, to split the complex spectrum.
+    float *split_cos;
+    float *split_sin;
+    // Real and imaginary parts of the two buffers the stages alternate
+    // between.
+    float *work_re[2];
+    float *work_im[2];
+} FFTPow2Plan;
+
+// Whether fft_pow2_create() accepts `n`.
+int fft_pow2_supported(size_t n);
+// Plans transforms of `n` samples, 0 if `n` is not supported.
+FFTPow2Plan *fft_pow2_create(size_t n);
+void fft_pow2_free(FFTPow2Plan *plan);
+// Transforms `data` in place and multiplies the output by `scale`.
+void fft_pow2_forward(FFTPow2Plan *plan, float *data, float scale);
+// Transforms the two signals `first` and `second` of `plan->m` samples in
+// place, as the real and imaginary parts of one complex signal, into the same
+// layout as fft_pow2_forward(). Pairs of signals of n samples are transformed
+// with a plan of 2n samples.
+void fft_pow2_forward_pair(FFTPow2Plan *plan, float *first, float *second,
+                           float scale);
+
+// Runs later transforms with the kernels for `level`, which the CPU must
+// support. Those of simd_detect() are picked when the program starts.
+void fft_pow2_use_kernels(SimdLevel level);
+
+#endif
@@ -0,0 +1,60 @@
+#include "fft_pow2_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+// Whatever the rest of the program targets, fft_pow2.c only picks these
+// kernels when the CPU supports them
+#pragma GCC target("avx2")
+#include <immintrin.h>
+
+#define LANES 8
+#define VECTOR __m256
+#define LOAD _mm256_loadu_ps
+#define ADD _mm256_add_ps
+#define SUB _mm256_sub_ps
+#define MUL _mm256_mul_ps
+#define SET1 _mm256_set1_ps
+#define STORE _mm256_storeu_ps
+
+// See fft_pow2_sse.c.
+static inline __attribute__((always_inline)) void
+deinterleave(const float *data, float *re, float *im, size_t m) {
+    for (size_t j = 0; j < m; j += 8) {
+        __m256 a = _mm256_loadu_ps(data + 2 * j);
+        __m256 b = _mm256_loadu_ps(data + 2 * j + 8);
+        __m256d even = _mm256_castps_pd(_mm256_shuffle_ps(a, b, 0x88));
+        __m256d odd = _mm256_castps_pd(_mm256_shuffle_ps(a, b, 0xdd));
+        _mm256_storeu_ps(re + j,
+                         _mm256_castpd_ps(_mm256_permute4x64_pd(even, 0xd8)));
+        _mm256_storeu_ps(im + j,
+                         _mm256_castpd_ps(_mm256_permute4x64_pd(odd, 0xd8)));
+    }
+}
+
+// Writes `a` and `b` to `out` alternating in runs of `s` floats.
+static inline void interleave(size_t s, __m256 a, __m256 b, float *out) {
+    __m256 low = a, high = b;
+    if (s == 1) {
+        low = _mm256_unpacklo_ps(a, b);
+        high = _mm256_unpackhi_ps(a, b);
+    } else if (s == 2) {
+        low = _mm256_castpd_ps(
+            _mm256_unpacklo_pd(_mm256_castps_pd(a), _mm256_castps_pd(b)));
+        high = _mm256_castpd_ps(
+            _mm256_unpackhi_pd(_mm256_castps_pd(a), _mm256_castps_pd(b)));
+    }
+    _mm256_storeu_ps(out, _mm256_permute2f128_ps(low, high, 0x20));
+    _mm256_storeu_ps(out + LANES, _mm256_permute2f128_ps(low, high, 0x31));
+}
+
+static inline __m256 reverse(__m256 values) {
+    return _mm256_permutevar8x32_ps(values,
+                                    _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+#include "fft_pow2_transform.h"
+
+const FFTPow2Kernels fft_pow2_kernels_avx2 = {
+    .forward = forward,
+    .forward_pair = forward_pair,
+};
+#endif
@@ -0,0 +1,22 @@
+#ifndef _FFT_POW2_KERNELS
+#define _FFT_POW2_KERNELS
+
+/*
+Kernels of fft_pow2.c, one table for each instruction set, built from
+fft_pow2_transform.h in fft_pow2_sse.c and fft_pow2_avx2.c.
+*/
+
+#include "fft_pow2.h"
+
+typedef struct {
+    // See fft_pow2_forward().
+    void (*forward)(FFTPow2Plan *plan, float *data, float scale);
+    // See fft_pow2_forward_pair().
+    void (*forward_pair)(FFTPow2Plan *plan, float *first, float *second,
+                         float scale);
+} FFTPow2Kernels;
+
+extern const FFTPow2Kernels fft_pow2_kernels_sse;
+extern const FFTPow2Kernels fft_pow2_kernels_avx2;
+
+#endif
@@ -0,0 +1,57 @@
+#include "fft_pow2_kernels.h"
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+
+#define LANES 4
+#define VECTOR __m128
+#define LOAD _mm_loadu_ps
+#define ADD _mm_add_ps
+#define SUB _mm_sub_ps
+#define MUL _mm_mul_ps
+#define SET1 _mm_set1_ps
+#define STORE _mm_storeu_ps
+
+// Even samples become the real parts and odd ones the imaginary parts. `m` is
+// a power of two of at least FFT_POW2_MIN_SIZE / 2, so whole vectors.
+static inline __attribute__((always_inline)) void
+deinterleave(const float *data, float *re, float *im, size_t m) {
+    for (size_t j = 0; j < m; j += 4) {
+        __m128 a = _mm_loadu_ps(data + 2 * j);
+        __m128 b = _mm_loadu_ps(data + 2 * j + 4);
+        _mm_storeu_ps(re + j, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(im + j, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+}
+
+// Writes `a` and `b` to `out` alternating in runs of `s` floats.
+static inline void interleave(size_t s, __m128 a, __m128 b, float *out) {
+    if (s == 1) {
+        _mm_storeu_ps(out, _mm_unpacklo_ps(a, b));
+        _mm_storeu_ps(out + LANES, _mm_unpackhi_ps(a, b));
+    } else {
+        _mm_storeu_ps(out, _mm_movelh_ps(a, b));
+        _mm_storeu_ps(out + LANES, _mm_movehl_ps(b, a));
+    }
+}
+
+static inline __m128 reverse(__m128 values) {
+    return _mm_shuffle_ps(values, values, _MM_SHUFFLE(0, 1, 2, 3));
+}
+#else
+// Scalar kernels on architectures without SSE
+static inline __attribute__((always_inline)) void
+deinterleave(const float *data, float *re, float *im, size_t m) {
+    for (size_t j = 0; j < m; j++) {
+        re[j] = data[2 * j];
+        im[j] = data[2 * j + 1];
+    }
+}
+#endif
+
+#include "fft_pow2_transform.h"
+
+const FFTPow2Kernels fft_pow2_kernels_sse = {
+    .forward = forward,
+    .forward_pair = forward_pair,
+};
@@ -0,0 +1,374 @@
+/*
+Transform of fft_pow2.c, included once by each of fft_pow2_sse.c and
+fft_pow2_avx2.c, which first define:
+
+    deinterleave()  splitting even and odd samples into real and imaginary
+                    parts, see fft_pow2_sse.c
+
+and, for vectorized kernels:
+
+    LANES           floats in a vector
+    VECTOR          the vector type
+    LOAD, STORE     unaligned loads and stores
+    ADD, SUB, MUL   arithmetic on vectors
+    SET1            a vector of one value
+    interleave()    writing two vectors alternating in runs of s floats
+    reverse()       reversing the order of the floats in a vector
+
+It defines forward() and forward_pair(), the bodies of fft_pow2_forward() and
+fft_pow2_forward_pair().
+*/
+
+#include "fft_pow2.h"
+
+// Kernels are inlined into each size specialized transform, see forward().
+#define KERNEL static inline __attribute__((always_inline))
+
+/*
+One radix-2 stage with stride s. Input j = s*p + q, for p < m/(2s) and q < s,
+is paired with input j + m/2, and their sum goes to output 2s*p + q and their
+difference, turned by the twiddle of p, to output 2s*p + s + q.
+*/
+KERNEL void stage_scalar(const FFTPow2Plan *plan, size_t m, size_t s,
+                         const float *xr, const float *xi, float *yr,
+                         float *yi) {
+    const size_t half = m / 2;
+    for (size_t p = 0; p < half / s; p++) {
+        const float wr = plan->twiddle_re[0][p * s];
+        const float wi = plan->twiddle_im[0][p * s];
+        for (size_t q = 0; q < s; q++) {
+            const size_t j = s * p + q, k = 2 * s * p + q;
+            const float dr = xr[j] - xr[j + half];
+            const float di = xi[j] - xi[j + half];
+            yr[k] = xr[j] + xr[j + half];
+            yi[k] = xi[j] + xi[j + half];
+            yr[k + s] = dr * wr - di * wi;
+            yi[k + s] = dr * wi + di * wr;
+        }
+    }
+}
+
+/*
+One radix-4 stage with stride s, doing the work of two radix-2 stages in one
+pass over the data. Input j = s*p + q, for p < m/(4s) and q < s, is combined
+with inputs j + m/4, j + m/2 and j + 3m/4 in a 4-point DFT, whose outputs go,
+turned by the twiddles of 0, p, 2p and 3p, to outputs 4s*p + q + s*k.
+*/
+KERNEL void stage4_scalar(const FFTPow2Plan *plan, size_t m, size_t s,
+                          const float *xr, const float *xi, float *yr,
+                          float *yi) {
+    const size_t quarter = m / 4;
+    const float *twiddle_re = plan->twiddle_re[0];
+    const float *twiddle_im = plan->twiddle_im[0];
+    for (size_t p = 0; p < quarter / s; p++) {
+        const float w1r = twiddle_re[p * s], w1i = twiddle_im[p * s];
+        const float w2r = twiddle_re[2 * p * s], w2i = twiddle_im[2 * p * s];
+        const float w3r = twiddle_re[3 * p * s], w3i = twiddle_im[3 * p * s];
+        for (size_t q = 0; q < s; q++) {
+            const size_t a = s * p + q, b = a + quarter, c = b + quarter,
+                         d = c + quarter, k = 4 * s * p + q;
+            const float apc_r = xr[a] + xr[c], apc_i = xi[a] + xi[c];
+            const float amc_r = xr[a] - xr[c], amc_i = xi[a] - xi[c];
+            const float bpd_r = xr[b] + xr[d], bpd_i = xi[b] + xi[d];
+            const float bmd_r = xr[b] - xr[d], bmd_i = xi[b] - xi[d];
+
+            const float t1r = amc_r + bmd_i, t1i = amc_i - bmd_r;
+            const float t2r = apc_r - bpd_r, t2i = apc_i - bpd_i;
+            const float t3r = amc_r - bmd_i, t3i = amc_i + bmd_r;
+            yr[k] = apc_r + bpd_r;
+            yi[k] = apc_i + bpd_i;
+            yr[k + s] = t1r * w1r - t1i * w1i;
+            yi[k + s] = t1r * w1i + t1i * w1r;
+            yr[k + 2 * s] = t2r * w2r - t2i * w2i;
+            yi[k + 2 * s] = t2r * w2i + t2i * w2r;
+            yr[k + 3 * s] = t3r * w3r - t3i * w3i;
+            yi[k + 3 * s] = t3r * w3i + t3i * w3r;
+        }
+    }
+}
+
+#ifdef LANES
+// Strides of at least a vector: the q of a vector share a twiddle.
+KERNEL void stage_wide(const FFTPow2Plan *plan, size_t m, size_t s,
+                       const float *xr, const float *xi, float *yr, float *yi) {
+    const size_t half = m / 2;
+    for (size_t p = 0; p < half / s; p++) {
+        const VECTOR wr = SET1(plan->twiddle_re[0][p * s]);
+        const VECTOR wi = SET1(plan->twiddle_im[0][p * s]);
+        for (size_t q = 0; q < s; q += LANES) {
+            const size_t j = s * p + q, k = 2 * s * p + q;
+            VECTOR ar = LOAD(xr + j), ai = LOAD(xi + j);
+            VECTOR br = LOAD(xr + j + half), bi = LOAD(xi + j + half);
+            VECTOR dr = SUB(ar, br), di = SUB(ai, bi);
+            STORE(yr + k, ADD(ar, br));
+            STORE(yi + k, ADD(ai, bi));
+            STORE(yr + k + s, SUB(MUL(dr, wr), MUL(di, wi)));
+            STORE(yi + k + s, ADD(MUL(dr, wi), MUL(di, wr)));
+        }
+    }
+}
+
+// Radix-4 counterpart of stage_wide().
+KERNEL void stage4_wide(const FFTPow2Plan *plan, size_t m, size_t s,
+                        const float *xr, const float *xi, float *yr,
+                        float *yi) {
+    const size_t quarter = m / 4;
+    const float *twiddle_re = plan->twiddle_re[0];
+    const float *twiddle_im = plan->twiddle_im[0];
+    for (size_t p = 0; p < quarter / s; p++) {
+        const VECTOR w1r = SET1(twiddle_re[p * s]);
+        const VECTOR w1i = SET1(twiddle_im[p * s]);
+        const VECTOR w2r = SET1(twiddle_re[2 * p * s]);
+        const VECTOR w2i = SET1(twiddle_im[2 * p * s]);
+        const VECTOR w3r = SET1(twiddle_re[3 * p * s]);
+        const VECTOR w3i = SET1(twiddle_im[3 * p * s]);
+        for (size_t q = 0; q < s; q += LANES) {
+            const size_t a = s * p + q, b = a + quarter, c = b + quarter,
+                         d = c + quarter, k = 4 * s * p + q;
+            VECTOR ar = LOAD(xr + a), ai = LOAD(xi + a);
+            VECTOR br = LOAD(xr + b), bi = LOAD(xi + b);
+            VECTOR cr = LOAD(xr + c), ci = LOAD(xi + c);
+            VECTOR dr = LOAD(xr + d), di = LOAD(xi + d);
+            VECTOR apc_r = ADD(ar, cr), apc_i = ADD(ai, ci);
+            VECTOR amc_r = SUB(ar, cr), amc_i = SUB(ai, ci);
+            VECTOR bpd_r = ADD(br, dr), bpd_i = ADD(bi, di);
+            VECTOR bmd_r = SUB(br, dr), bmd_i = SUB(bi, di);
+
+            VECTOR t1r = ADD(amc_r, bmd_i), t1i = SUB(amc_i, bmd_r);
+            VECTOR t2r = SUB(apc_r, bpd_r), t2i = SUB(apc_i, bpd_i);
+            VECTOR t3r = SUB(amc_r, bmd_i), t3i = ADD(amc_i, bmd_r);
+            STORE(yr + k, ADD(apc_r, bpd_r));
+            STORE(yi + k, ADD(apc_i, bpd_i));
+            STORE(yr + k + s, SUB(MUL(t1r, w1r), MUL(t1i, w1i)));
+            STORE(yi + k + s, ADD(MUL(t1r, w1i), MUL(t1i, w1r)));
+            STORE(yr + k + 2 * s, SUB(MUL(t2r, w2r), MUL(t2i, w2i)));
+            STORE(yi + k + 2 * s, ADD(MUL(t2r, w2i), MUL(t2i, w2r)));
+            STORE(yr + k + 3 * s, SUB(MUL(t3r, w3r), MUL(t3i, w3i)));
+            STORE(yi + k + 3 * s, ADD(MUL(t3r, w3i), MUL(t3i, w3r)));
+        }
+    }
+}
+
+/*
+Strides below a vector: a vector holds several p, so twiddles come from the
+table repeated for the stride, and the outputs are interleaved in runs of s.
+The outputs of inputs j to j + LANES are then outputs 2j to 2j + 2 * LANES.
+*/
+KERNEL void stage_narrow(const FFTPow2Plan *plan, size_t m, size_t s,
+                         const float *xr, const float *xi, float *yr,
+                         float *yi) {
+    const size_t half = m / 2;
+    const size_t t = s == 1 ? 0 : s == 2 ? 1 : 2;
+    const float *twiddle_re = plan->twiddle_re[t];
+    const float *twiddle_im = plan->twiddle_im[t];
+    for (size_t j = 0; j < half; j += LANES) {
+        VECTOR ar = LOAD(xr + j), ai = LOAD(xi + j);
+        VECTOR br = LOAD(xr + j + half), bi = LOAD(xi + j + half);
+        VECTOR wr = LOAD(twiddle_re + j), wi = LOAD(twiddle_im + j);
+        VECTOR dr = SUB(ar, br), di = SUB(ai, bi);
+        interleave(s, ADD(ar, br), SUB(MUL(dr, wr), MUL(di, wi)), yr + 2 * j);
+        interleave(s, ADD(ai, bi), ADD(MUL(dr, wi), MUL(di, wr)), yi + 2 * j);
+    }
+}
+#endif
+
+KERNEL void stage(const FFTPow2Plan *plan, size_t m, size_t s,
+                  const float *xr, const float *xi, float *yr, float *yi) {
+#ifdef LANES
+    if (s >= LANES) {
+        stage_wide(plan, m, s, xr, xi, yr, yi);
+        return;
+    }
+    if (m / 2 >= LANES) {
+        stage_narrow(plan, m, s, xr, xi, yr, yi);
+        return;
+    }
+#endif
+    stage_scalar(plan, m, s, xr, xi, yr, yi);
+}
+
+KERNEL void stage4(const FFTPow2Plan *plan, size_t m, size_t s,
+                   const float *xr, const float *xi, float *yr, float *yi) {
+#ifdef LANES
+    if (s >= LANES) {
+        stage4_wide(plan, m, s, xr, xi, yr, yi);
+        return;
+    }
+#endif
+    stage4_scalar(plan, m, s, xr, xi, yr, yi);
+}
+
+/*
+Splits the spectrum Z of the complex samples into the spectrum X of the real
+ones, with E and O the spectra of the even and odd samples:
+
+    E[k] = (Z[k] + conj(Z[m-k])) / 2
+    O[k] = -i (Z[k] - conj(Z[m-k])) / 2
+    X[k] = E[k] + exp(-2πik/n) O[k]
+*/
+KERNEL void split(const FFTPow2Plan *plan, size_t m, const float *zr,
+                  const float *zi, float *data, float scale) {
+    const float half = 0.5f * scale;
+    data[0] = (zr[0] + zi[0]) * scale;
+    data[plan->n - 1] = (zr[0] - zi[0]) * scale;
+
+    size_t k = 1;
+#ifdef LANES
+    const VECTOR h = SET1(half);
+    for (; k + LANES <= m; k += LANES) {
+        VECTOR kr = LOAD(zr + k), ki = LOAD(zi + k);
+        VECTOR cr = reverse(LOAD(zr + m - k - (LANES - 1)));
+        VECTOR ci = reverse(LOAD(zi + m - k - (LANES - 1)));
+        VECTOR er = MUL(ADD(kr, cr), h), ei = MUL(SUB(ki, ci), h);
+        VECTOR odd_r = MUL(ADD(ki, ci), h), odd_i = MUL(SUB(cr, kr), h);
+        VECTOR c = LOAD(plan->split_cos + k), sn = LOAD(plan->split_sin + k);
+        VECTOR xr = ADD(er, ADD(MUL(c, odd_r), MUL(sn, odd_i)));
+        VECTOR xi = ADD(ei, SUB(MUL(c, odd_i), MUL(sn, odd_r)));
+        interleave(1, xr, xi, data + 2 * k - 1);
+    }
+#endif
+    for (; k < m; k++) {
+        const float er = (zr[k] + zr[m - k]) * half;
+        const float ei = (zi[k] - zi[m - k]) * half;
+        const float odd_r = (zi[k] + zi[m - k]) * half;
+        const float odd_i = (zr[m - k] - zr[k]) * half;
+        const float c = plan->split_cos[k], sn = plan->split_sin[k];
+        data[2 * k - 1] = er + c * odd_r + sn * odd_i;
+        data[2 * k] = ei + c * odd_i - sn * odd_r;
+    }
+}
+
+/*
+Splits the spectrum Z of the complex samples into the spectra A and B of their
+real and imaginary parts:
+
+    A[k] = (Z[k] + conj(Z[m-k])) / 2
+    B[k] = -i (Z[k] - conj(Z[m-k])) / 2
+*/
+KERNEL void split_pair(size_t m, const float *zr, const float *zi,
+                       float *first, float *second, float scale) {
+    const size_t nyquist = m / 2;
+    const float half = 0.5f * scale;
+    first[0] = zr[0] * scale;
+    second[0] = zi[0] * scale;
+    first[m - 1] = zr[nyquist] * scale;
+    second[m - 1] = zi[nyquist] * scale;
+
+    size_t k = 1;
+#ifdef LANES
+    const VECTOR h = SET1(half);
+    for (; k + LANES <= nyquist; k += LANES) {
+        VECTOR kr = LOAD(zr + k), ki = LOAD(zi + k);
+        VECTOR cr = reverse(LOAD(zr + m - k - (LANES - 1)));
+        VECTOR ci = reverse(LOAD(zi + m - k - (LANES - 1)));
+        interleave(1, MUL(ADD(kr, cr), h), MUL(SUB(ki, ci), h),
+                   first + 2 * k - 1);
+        interleave(1, MUL(ADD(ki, ci), h), MUL(SUB(cr, kr), h),
+                   second + 2 * k - 1);
+    }
+#endif
+    for (; k < nyquist; k++) {
+        first[2 * k - 1] = (zr[k] + zr[m - k]) * half;
+        first[2 * k] = (zi[k] - zi[m - k]) * half;
+        second[2 * k - 1] = (zi[k] + zi[m - k]) * half;
+        second[2 * k] = (zr[m - k] - zr[k]) * half;
+    }
+}
+
+/*
+Runs the stages over the `m` complex samples that `re` and `im` point at, and
+points them at the spectrum, in the work buffers. The stages write into the
+work buffers in turn, starting with the first, so the samples are only
+overwritten if they are in the second.
+*/
+KERNEL void stages(FFTPow2Plan *plan, size_t m, const float **re,
+                   const float **im) {
+    // Strides below a vector take radix-2 stages, which interleave their
+    // outputs within vectors, the rest radix-4 stages and, for an odd power
+    // of two, a last radix-2 stage
+    size_t s = 1, buffer = 0;
+    while (s < m) {
+#ifdef LANES
+        const int radix = s >= LANES && 4 * s <= m ? 4 : 2;
+#else
+        const int radix = 4 * s <= m ? 4 : 2;
+#endif
+        float *yr = plan->work_re[buffer], *yi = plan->work_im[buffer];
+        if (radix == 4)
+            stage4(plan, m, s, *re, *im, yr, yi);
+        else
+            stage(plan, m, s, *re, *im, yr, yi);
+        s *= radix;
+
+        *re = yr;
+        *im = yi;
+        buffer ^= 1;
+    }
+}
+
+// The whole transform of `m` complex samples.
+KERNEL void transform(FFTPow2Plan *plan, size_t m, float *data, float scale) {
+    const float *zr = plan->work_re[1], *zi = plan->work_im[1];
+    deinterleave(data, plan->work_re[1], plan->work_im[1], m);
+    stages(plan, m, &zr, &zi);
+    split(plan, m, zr, zi, data, scale);
+}
+
+// The whole transform of two signals of `m` real samples.
+KERNEL void transform_pair(FFTPow2Plan *plan, size_t m, float *first,
+                           float *second, float scale) {
+    const float *zr = first, *zi = second;
+    stages(plan, m, &zr, &zi);
+    split_pair(m, zr, zi, first, second, scale);
+}
+
+/*
+The sizes of the analysis get their own copy of the transform, with `m` known
+at compile time, so that the stages are unrolled into a fixed sequence and
+their loop bounds, strides and offsets become constants.
+*/
+static void forward(FFTPow2Plan *plan, float *data, float scale) {
+    switch (plan->m) {
+    case 256:
+        transform(plan, 256, data, scale);
+        break;
+    case 512:
+        transform(plan, 512, data, scale);
+        break;
+    case 1024:
+        transform(plan, 1024, data, scale);
+        break;
+    case 2048:
+        transform(plan, 2048, data, scale);
+        break;
+    case 4096:
+        transform(plan, 4096, data, scale);
+        break;
+    default:
+        transform(plan, plan->m, data, scale);
+    }
+}
+
+// Pairs of windows of 512 to 8192 samples.
+static void forward_pair(FFTPow2Plan *plan, float *first, float *second,
+                         float scale) {
+    switch (plan->m) {
+    case 512:
+        transform_pair(plan, 512, first, second, scale);
+        break;
+    case 1024:
+        transform_pair(plan, 1024, first, second, scale);
+        break;
+    case 2048:
+        transform_pair(plan, 2048, first, second, scale);
+        break;
+    case 4096:
+        transform_pair(plan, 4096, first, second, scale);
+        break;
+    case 8192:
+        transform_pair(plan, 8192, first, second, scale);
+        break;
+    default:
+        transform_pair(plan, plan->m, first, second, scale);
+    }
+}
@@ -0,0 +1,84 @@
+#include "frame_graph.h"
+#include "profiler.h"
+
+#include <raylib.h>
+#include <stdio.h>
+
+// Pixels per frame and per millisecond.
+#define BAR_WIDTH 2
+#define PIXELS_PER_MS 4
+// Frame time marked with a line, 60 frames per second.
+#define TARGET_FRAME_TIME (1000.0 / 60)
+#define MARGIN 10
+#define LEGEND_SIZE 10
+
+static int shown = 0;
+
+// Time of firewatch, analysis, the scene without presenting, presenting, and
+// the rest of the frame.
+static const Color stage_colors[PROFILE_STAGE_COUNT + 1] = {
+    [PROFILE_FIREWATCH] = {253, 249, 0, 255},
+    [PROFILE_ANALYSIS] = {0, 228, 48, 255},
+    [PROFILE_SCENE] = {0, 121, 241, 255},
+    [PROFILE_PRESENT] = {230, 41, 55, 255},
+    [PROFILE_STAGE_COUNT] = {130, 130, 130, 255},
+};
+
+void framegraph_toggle(int keep_profiling) {
+    shown = !shown;
+    if (!keep_profiling)
+        profiler_enable(shown);
+}
+
+void framegraph_draw(void) {
+    if (!shown)
+        return;
+
+    const int height = GetScreenHeight();
+    const int bottom = height - MARGIN;
+    const int width = PROFILER_HISTORY * BAR_WIDTH;
+    const int graph_height = 2 * TARGET_FRAME_TIME * PIXELS_PER_MS;
+
+    DrawRectangle(MARGIN, bottom - graph_height, width, graph_height,
+                  (Color){0, 0, 0, 160});
+
+    for (size_t age = 0; age < PROFILER_HISTORY; age++) {
+        float stages[PROFILE_STAGE_COUNT];
+        float frame;
+        if (profiler_frame(age, stages, &frame))
+            break;
+
+        float rest = frame;
+        for (size_t stage = 0; stage < PROFILE_STAGE_COUNT; stage++)
+            rest -= stages[stage];
+
+        int x = MARGIN + width - (age + 1) * BAR_WIDTH;
+        float y = bottom;
+        for (size_t stage = 0; stage <= PROFILE_STAGE_COUNT; stage++) {
+            float ms = stage < PROFILE_STAGE_COUNT ? stages[stage] : rest;
+            if (ms <= 0)
+                continue;
+            float bar = ms * PIXELS_PER_MS;
+            if (y - bar < bottom - graph_height)
+                bar = y - (bottom - graph_height);
+            DrawRectangle(x, y - bar, BAR_WIDTH, bar, stage_colors[stage]);
+            y -= bar;
+        }
+    }
+
+    int target_y = bottom - TARGET_FRAME_TIME * PIXELS_PER_MS;
+    DrawLine(MARGIN, target_y, MARGIN + width, target_y, WHITE);
+
+    int legend_y = bottom - graph_height - LEGEND_SIZE - 4;
+    int legend_x = MARGIN;
+    for (size_t stage = 0; stage <= PROFILE_STAGE_COUNT; stage++) {
+        const char *name = stage < PROFILE_STAGE_COUNT
+                               ? profiler_stage_name(stage)
+                               : "other";
+        DrawRectangle(legend_x, legend_y, LEGEND_SIZE, LEGEND_SIZE,
+                      stage_colors[stage]);
+        DrawText(name, legend_x + LEGEND_SIZE + 3, legend_y, LEGEND_SIZE,
+                 WHITE);
+        legend_x += LEGEND_SIZE + 3 + MeasureText(name, LEGEND_SIZE) + 8;
+    }
+}
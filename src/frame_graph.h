@@ -0,0 +1,15 @@
+#ifndef _FRAME_GRAPH
+#define _FRAME_GRAPH
+
+/*
+On-screen graph of the time spent in each stage of recent frames (see
+profiler.h), drawn over the scene.
+*/
+
+// Shows the graph if it is hidden and hides it otherwise. The profiler is
+// enabled while the graph is shown, unless `keep_profiling` is set.
+void framegraph_toggle(int keep_profiling);
+// Draws the graph over the frame if it is shown, before EndDrawing().
+void framegraph_draw(void);
+
+#endif
@@ -0,0 +1,191 @@
+#include "harmony.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Frequency range in Hz that chroma is taken from. Lower bins are too wide to
+// tell semitones apart, higher ones hold mostly overtones and noise.
+#define MIN_FREQUENCY 100.0
+#define MAX_FREQUENCY 5000.0
+// Time constants of the smoothing of chroma, in seconds.
+#define CHORD_SMOOTHING 0.3
+#define KEY_SMOOTHING 10.0
+// Smoothed chroma summing to less than this counts as silence.
+#define SILENCE 0.001
+
+// Krumhansl-Kessler probe tone ratings of each pitch class above the tonic.
+static const float major_profile[PITCH_CLASS_COUNT] = {
+    6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88,
+};
+static const float minor_profile[PITCH_CLASS_COUNT] = {
+    6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17,
+};
+
+static const char *names[HARMONY_COUNT] = {
+    "C",  "C#",  "D",  "D#",  "E",  "F",  "F#",  "G",  "G#",  "A",  "A#",  "B",
+    "Cm", "C#m", "Dm", "D#m", "Em", "Fm", "F#m", "Gm", "G#m", "Am", "A#m", "Bm",
+};
+
+// Splits every bin among the semitones its frequency range overlaps.
+static int create_chroma_map(BandLayout *layout, uint32_t frequency_count,
+                             float resolution) {
+    float *weights = calloc(PITCH_CLASS_COUNT * frequency_count, sizeof(float));
+    if (!weights)
+        return 1;
+
+    for (uint32_t bin = 1; bin < frequency_count; bin++) {
+        const float frequency = bin * resolution;
+        if (frequency < MIN_FREQUENCY || frequency > MAX_FREQUENCY)
+            continue;
+        // Edges of the bin as MIDI note numbers
+        const float low = 69 + 12 * log2f((frequency - resolution / 2) / 440);
+        const float high = 69 + 12 * log2f((frequency + resolution / 2) / 440);
+        for (int note = roundf(low); note <= roundf(high); note++) {
+            const float overlap =
+                fminf(high, note + 0.5f) - fmaxf(low, note - 0.5f);
+            if (overlap > 0)
+                weights[note % PITCH_CLASS_COUNT * frequency_count + bin] +=
+                    overlap / (high - low);
+        }
+    }
+
+    uint32_t band_starts[PITCH_CLASS_COUNT + 1] = {0};
+    uint32_t *bins = malloc(PITCH_CLASS_COUNT * frequency_count *
+                            sizeof(uint32_t));
+    if (!bins) {
+        free(weights);
+        return 1;
+    }
+    // Packs the weights of each pitch class to the front, they are only
+    // read ahead of where they are written
+    uint32_t entry = 0;
+    for (uint32_t pitch_class = 0; pitch_class < PITCH_CLASS_COUNT;
+         pitch_class++) {
+        band_starts[pitch_class] = entry;
+        for (uint32_t bin = 0; bin < frequency_count; bin++) {
+            const float weight =
+                weights[pitch_class * frequency_count + bin];
+            if (weight <= 0)
+                continue;
+            bins[entry] = bin;
+            weights[entry++] = weight;
+        }
+    }
+    band_starts[PITCH_CLASS_COUNT] = entry;
+
+    int result = bands_create_sparse(layout, PITCH_CLASS_COUNT, band_starts,
+                                     bins, weights);
+    free(weights);
+    free(bins);
+    return result;
+}
+
+int harmony_init(HarmonyEstimator *estimator, uint32_t frequency_count,
+                 float resolution, float hop_duration) {
+    memset(estimator, 0, sizeof(HarmonyEstimator));
+    estimator->chord_decay = expf(-hop_duration / CHORD_SMOOTHING);
+    estimator->key_decay = expf(-hop_duration / KEY_SMOOTHING);
+    return create_chroma_map(&estimator->chroma_map, frequency_count,
+                             resolution);
+}
+
+void harmony_free(HarmonyEstimator *estimator) {
+    bands_free(&estimator->chroma_map);
+}
+
+// Correlation of `chroma` with `profile` moved up to `tonic`.
+static float correlation(const float *chroma, const float *profile,
+                         uint32_t tonic) {
+    float chroma_mean = 0, profile_mean = 0;
+    for (uint32_t i = 0; i < PITCH_CLASS_COUNT; i++) {
+        chroma_mean += chroma[i] / PITCH_CLASS_COUNT;
+        profile_mean += profile[i] / PITCH_CLASS_COUNT;
+    }
+
+    float product = 0, chroma_square = 0, profile_square = 0;
+    for (uint32_t i = 0; i < PITCH_CLASS_COUNT; i++) {
+        const float c = chroma[(i + tonic) % PITCH_CLASS_COUNT] - chroma_mean;
+        const float p = profile[i] - profile_mean;
+        product += c * p;
+        chroma_square += c * c;
+        profile_square += p * p;
+    }
+    if (chroma_square <= 0)
+        return 0;
+    return product / sqrtf(chroma_square * profile_square);
+}
+
+// Finds the key whose profile correlates best with `chroma`.
+static void estimate_key(const float *chroma, Harmony *out_harmony) {
+    out_harmony->key_confidence = 0;
+    for (uint32_t key = 0; key < HARMONY_COUNT; key++) {
+        const float *profile =
+            key < HARMONY_MINOR ? major_profile : minor_profile;
+        const float value =
+            correlation(chroma, profile, key % PITCH_CLASS_COUNT);
+        if (value > out_harmony->key_confidence) {
+            out_harmony->key = key;
+            out_harmony->key_confidence = value;
+        }
+    }
+}
+
+// Finds the major or minor triad closest in angle to `chroma`.
+static void estimate_chord(const float *chroma, Harmony *out_harmony) {
+    float length = 0;
+    for (uint32_t i = 0; i < PITCH_CLASS_COUNT; i++)
+        length += chroma[i] * chroma[i];
+    length = sqrtf(length * 3);
+
+    out_harmony->chord_confidence = 0;
+    for (uint32_t chord = 0; chord < HARMONY_COUNT; chord++) {
+        const uint32_t root = chord % PITCH_CLASS_COUNT;
+        const uint32_t third = chord < HARMONY_MINOR ? 4 : 3;
+        const float value =
+            (chroma[root] + chroma[(root + third) % PITCH_CLASS_COUNT] +
+             chroma[(root + 7) % PITCH_CLASS_COUNT]) /
+            length;
+        if (value > out_harmony->chord_confidence) {
+            out_harmony->chord = chord;
+            out_harmony->chord_confidence = value;
+        }
+    }
+}
+
+void harmony_process(HarmonyEstimator *estimator, const float *magnitudes,
+                     Harmony *out_harmony) {
+    float chroma[PITCH_CLASS_COUNT];
+    bands_apply(&estimator->chroma_map, magnitudes, chroma);
+
+    float chord_sum = 0, key_sum = 0, strongest = 0;
+    for (uint32_t i = 0; i < PITCH_CLASS_COUNT; i++) {
+        estimator->chord_chroma[i] =
+            estimator->chord_chroma[i] * estimator->chord_decay +
+            chroma[i] * (1 - estimator->chord_decay);
+        estimator->key_chroma[i] =
+            estimator->key_chroma[i] * estimator->key_decay +
+            chroma[i] * (1 - estimator->key_decay);
+        chord_sum += estimator->chord_chroma[i];
+        key_sum += estimator->key_chroma[i];
+        strongest = fmaxf(strongest, estimator->chord_chroma[i]);
+    }
+
+    if (chord_sum < SILENCE) {
+        memset(out_harmony->chroma, 0, sizeof(out_harmony->chroma));
+        out_harmony->chord_confidence = 0;
+    } else {
+        for (uint32_t i = 0; i < PITCH_CLASS_COUNT; i++)
+            out_harmony->chroma[i] = estimator->chord_chroma[i] / strongest;
+        estimate_chord(estimator->chord_chroma, out_harmony);
+    }
+
+    if (key_sum < SILENCE)
+        out_harmony->key_confidence = 0;
+    else
+        estimate_key(estimator->key_chroma, out_harmony);
+}
+
+const char *harmony_name(uint32_t harmony) {
+    return harmony < HARMONY_COUNT ? names[harmony] : "?";
+}
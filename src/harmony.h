@@ -0,0 +1,65 @@
+#ifndef _HARMONY
+#define _HARMONY
+
+/*
+Estimation of the key and the current chord from consecutive magnitude
+spectra.
+
+Each hop, the spectrum is folded into a chroma vector, the strength of each of
+the 12 pitch classes, with a precomputed mapping (see bands.h) that splits
+every bin among the semitones it overlaps. Chroma is smoothed over a short time
+for chords and a long time for the key. Chords are matched against major and
+minor triad templates, and the key is found by correlating with the
+Krumhansl-Kessler key profiles. Both take a few hundred operations per hop.
+*/
+
+#include "bands.h"
+
+#include <stdint.h>
+
+#define PITCH_CLASS_COUNT 12
+// Major keys and chords are numbered by the pitch class of their root, from C
+// at 0, and minor ones follow from HARMONY_MINOR.
+#define HARMONY_MINOR 12
+#define HARMONY_COUNT 24
+
+typedef struct {
+    // Strength of each pitch class from C, smoothed over a short time, with
+    // the strongest at 1.0.
+    float chroma[PITCH_CLASS_COUNT];
+    // Estimated key and chord, see HARMONY_MINOR and harmony_name().
+    uint32_t key;
+    uint32_t chord;
+    // How well the chroma matches the key and chord, between 0.0 and 1.0.
+    // 0.0 in silence, when they are not known.
+    float key_confidence;
+    float chord_confidence;
+} Harmony;
+
+typedef struct {
+    // One band per pitch class.
+    BandLayout chroma_map;
+    float chord_chroma[PITCH_CLASS_COUNT];
+    float key_chroma[PITCH_CLASS_COUNT];
+    // Share of the previous smoothed chroma kept each hop.
+    float chord_decay;
+    float key_decay;
+} HarmonyEstimator;
+
+// Initializes `estimator` for spectra of `frequency_count` bins each
+// `resolution` Hz wide, computed every `hop_duration` seconds. Returns 0 on
+// success.
+int harmony_init(HarmonyEstimator *estimator, uint32_t frequency_count,
+                 float resolution, float hop_duration);
+// Frees memory used by `estimator`.
+void harmony_free(HarmonyEstimator *estimator);
+
+// Processes the magnitude spectrum of one hop and writes the current
+// estimates into `out_harmony`.
+void harmony_process(HarmonyEstimator *estimator, const float *magnitudes,
+                     Harmony *out_harmony);
+
+// Name of a key or chord, such as "F#" or "Am".
+const char *harmony_name(uint32_t harmony);
+
+#endif
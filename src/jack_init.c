@@ -1,64 +1,205 @@
 #include "jack_init.h"
 #include "analyze.h"
+#include "profiler.h"
 
 #include <jack/jack.h>
 #include <jack/midiport.h>
-#include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
-#include <stdlib.h>
-
-jack_port_t *input_port;
-jack_port_t *beat_midi_port;
-
-jack_client_t *client;
-
-static void signal_handler(int sig) {
-    jack_client_close(client);
-    fprintf(stderr, "signal received, exiting ...\n");
-    exit(0);
-    (void)sig;
-}
-
-int process(jack_nframes_t nframes, void *arg) {
+#include <string.h>
+
+// Frames interleaved at a time, so that the buffer does not depend on the
+// period size of the server.
+#define CHUNK_FRAMES 1024
+// Longest list of ports to connect to.
+#define MAX_CONNECT_LENGTH 1024
+
+static jack_client_t *client = 0;
+static jack_port_t *input_ports[MAX_CHANNELS];
+static jack_port_t *beat_midi_port = 0;
+static uint8_t port_count = 1;
+static uint32_t sample_rate = 0;
+
+// Name of the port each input port is connected to, 0 if none.
+static char connect_names[MAX_CONNECT_LENGTH];
+static const char *sources[MAX_CHANNELS];
+
+// Set when the server has gone away, and cleared while reconnecting.
+static _Atomic int server_lost = 0;
+// Time of the next attempt to reopen the client, on the clock of
+// eventqueue_now(). Only used by the render thread.
+static uint64_t next_reconnect = 0;
+
+// Samples of all ports interleaved, only used by the process thread.
+static float interleaved[CHUNK_FRAMES * MAX_CHANNELS];
+
+// Frames processed so far, the position in the captured stream of the start
+// of the current cycle.
+static uint64_t frames_processed = 0;
+
+// Runs on the realtime thread of JACK, so it must not lock, allocate or
+// print.
+static int process(jack_nframes_t nframes, void *arg) {
+    PROFILE_SCOPE("audio callback");
     // Audio input
-    jack_default_audio_sample_t *in =
-        (jack_default_audio_sample_t *)jack_port_get_buffer(input_port,
-                                                            nframes);
-    analyze_feed_frames((float *)in, nframes, 1);
+    jack_default_audio_sample_t *buffers[MAX_CHANNELS];
+    for (uint8_t port = 0; port < port_count; port++)
+        buffers[port] = jack_port_get_buffer(input_ports[port], nframes);
+    if (port_count == 1) {
+        analyze_feed_frames(buffers[0], nframes, 1);
+    } else {
+        for (jack_nframes_t start = 0; start < nframes;
+             start += CHUNK_FRAMES) {
+            const jack_nframes_t count = nframes - start < CHUNK_FRAMES
+                                             ? nframes - start
+                                             : CHUNK_FRAMES;
+            for (jack_nframes_t i = 0; i < count; i++)
+                for (uint8_t port = 0; port < port_count; port++)
+                    interleaved[i * port_count + port] =
+                        buffers[port][start + i];
+            analyze_feed_frames(interleaved, count, port_count);
+        }
+    }
 
     // Midi events
     void *port_buf = jack_port_get_buffer(beat_midi_port, nframes);
     jack_midi_event_t in_event;
     jack_nframes_t event_count = jack_midi_get_event_count(port_buf);
+    jack_nframes_t cycle_start = jack_last_frame_time(client);
 
     for (uint32_t i = 0; i < event_count; i++) {
         jack_midi_event_get(&in_event, port_buf, i);
 
-        if ((in_event.buffer[0] & 0xf0) == 0x90) {
-            analyze_trigger_beat();
+        uint8_t status = in_event.buffer[0] & 0xf0;
+        uint8_t type;
+        if (in_event.size >= 3 && (status == 0x90 || status == 0x80))
+            // Note on with zero velocity is a note off
+            type = status == 0x90 && in_event.buffer[2] > 0 ? EVENT_NOTE_ON
+                                                            : EVENT_NOTE_OFF;
+        else if (in_event.size >= 2 && status == 0xc0)
+            type = EVENT_PROGRAM_CHANGE;
+        else
+            continue;
+
+        Event event = {
+            // The JACK clock is CLOCK_MONOTONIC in microseconds
+            .time = jack_frames_to_time(client, cycle_start + in_event.time) *
+                    1000,
+            .frame = frames_processed + in_event.time,
+            .type = type,
+            .note = in_event.buffer[1],
+            .velocity = type == EVENT_PROGRAM_CHANGE ? 0 : in_event.buffer[2],
+            .channel = in_event.buffer[0] & 0x0f,
+        };
+        analyze_push_event(&event);
+
+        if (type == EVENT_NOTE_ON)
             analyze_set_beat_triggering_mode(1);
-        }
     }
+    frames_processed += nframes;
 
     (void)arg;
     return 0;
 }
 
-void jack_shutdown(void *arg) {
-    exit(1);
+// Runs once on the process thread before its first cycle.
+static void thread_init(void *arg) {
+    profiler_register_thread("audio");
     (void)arg;
 }
 
-int jack_init(void) {
-    const char *server_name = NULL;
-    jack_options_t options = JackNullOption;
+// Called from a thread of JACK that must not call JACK functions, the client
+// is closed and reopened by jack_poll().
+static void server_shutdown(void *arg) {
+    atomic_store_explicit(&server_lost, 1, memory_order_release);
+    (void)arg;
+}
 
+// Opens the client, registers its ports, activates it and connects the ports
+// to their sources. Returns 0 on success, and closes the client on failure.
+static int open_client(jack_options_t options, jack_status_t *out_status) {
     const char *client_name = "muscini";
+    client = jack_client_open(client_name, options, out_status, NULL);
+    if (client == NULL)
+        return 1;
+    if (*out_status & JackNameNotUnique) {
+        client_name = jack_get_client_name(client);
+        fprintf(stderr, "unique name `%s' assigned\n", client_name);
+    }
 
-    jack_status_t status;
-    client = jack_client_open(client_name, options, &status, server_name);
+    // The audio thread is not running yet
+    const uint32_t rate = jack_get_sample_rate(client);
+    if (rate != sample_rate)
+        analyze_set_sample_rate(rate);
+    sample_rate = rate;
+
+    jack_set_process_callback(client, process, 0);
+    jack_set_thread_init_callback(client, thread_init, 0);
+    jack_on_shutdown(client, server_shutdown, 0);
+
+    for (uint8_t port = 0; port < port_count; port++) {
+        char name[16];
+        snprintf(name, sizeof(name), "input%u", port + 1);
+        input_ports[port] = jack_port_register(
+            client, name, JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+        if (input_ports[port] == NULL) {
+            fprintf(stderr, "ERROR: Failed to open JACK input port.\n");
+            jack_client_close(client);
+            client = 0;
+            return 1;
+        }
+    }
+    beat_midi_port = jack_port_register(
+        client, "MIDI beat", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+
+    if (beat_midi_port == NULL || jack_activate(client)) {
+        fprintf(stderr, "ERROR: cannot activate JACK client.\n");
+        jack_client_close(client);
+        client = 0;
+        return 1;
+    }
 
-    if (client == NULL) {
+    // Ports can only be connected once the client is active
+    for (uint8_t port = 0; port < port_count; port++) {
+        if (!sources[port])
+            continue;
+        const char *name = jack_port_name(input_ports[port]);
+        if (jack_connect(client, sources[port], name))
+            fprintf(stderr, "ERROR: could not connect %s to %s.\n",
+                    sources[port], name);
+    }
+    return 0;
+}
+
+int jack_init(const JackConfig *config) {
+    port_count = config->ports;
+    memset(sources, 0, sizeof(sources));
+    if (config->connect) {
+        if (strlen(config->connect) >= MAX_CONNECT_LENGTH) {
+            fprintf(stderr, "ERROR: list of JACK ports to connect to is too "
+                            "long.\n");
+            return 1;
+        }
+        strcpy(connect_names, config->connect);
+        char *name = connect_names;
+        for (uint8_t port = 0; name; port++) {
+            if (port == port_count) {
+                fprintf(stderr, "ERROR: more JACK ports to connect to than "
+                                "input ports (%u).\n",
+                        port_count);
+                return 1;
+            }
+            sources[port] = name;
+            name = strchr(name, ',');
+            if (name)
+                *name++ = 0;
+            if (!*sources[port])
+                sources[port] = 0;
+        }
+    }
+
+    jack_status_t status;
+    if (open_client(JackNullOption, &status)) {
         fprintf(stderr,
                 "jack_client_open() failed, "
                 "status = 0x%2.0x\n",
@@ -71,37 +212,36 @@ int jack_init(void) {
     if (status & JackServerStarted) {
         fprintf(stderr, "JACK server started\n");
     }
-    if (status & JackNameNotUnique) {
-        client_name = jack_get_client_name(client);
-        fprintf(stderr, "unique name `%s' assigned\n", client_name);
-    }
-
-    jack_set_process_callback(client, process, 0);
-    // jack_set_port_connect_callback(client, port_connected, 0);
-    jack_on_shutdown(client, jack_shutdown, 0);
-
-    input_port = jack_port_register(client, "input1", JACK_DEFAULT_AUDIO_TYPE,
-                                    JackPortIsInput, 0);
-    beat_midi_port = jack_port_register(
-        client, "MIDI beat", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+    return 0;
+}
 
-    if (input_port == NULL) {
-        fprintf(stderr, "ERROR: Failed to open JACK input port.\n");
-        return 1;
+void jack_poll(void) {
+    if (!atomic_load_explicit(&server_lost, memory_order_acquire))
+        return;
+
+    const uint64_t now = eventqueue_now();
+    if (client) {
+        // Only the resources of the client are left to free
+        jack_client_close(client);
+        client = 0;
+        printf("INFO: Lost the JACK server, reconnecting.\n");
+    } else if (now < next_reconnect) {
+        return;
     }
 
-    if (jack_activate(client)) {
-        fprintf(stderr, "cannot activate client");
-        return 1;
+    // Cleared first so that losing the new client is not missed
+    atomic_store_explicit(&server_lost, 0, memory_order_relaxed);
+    jack_status_t status;
+    if (open_client(JackNoStartServer, &status)) {
+        atomic_store_explicit(&server_lost, 1, memory_order_relaxed);
+        next_reconnect = now + JACK_RECONNECT_INTERVAL * 1e9;
+        return;
     }
-
-    signal(SIGQUIT, signal_handler);
-    signal(SIGTERM, signal_handler);
-    signal(SIGHUP, signal_handler);
-    signal(SIGINT, signal_handler);
-    return 0;
+    printf("INFO: Reconnected to the JACK server.\n");
 }
 
 void jack_deinit(void) {
-    jack_client_close(client);
+    if (client)
+        jack_client_close(client);
+    client = 0;
 }
@@ -1,8 +1,40 @@
 #ifndef _JACK_INIT
 #define _JACK_INIT
 
-// Initializes pulseaudio as a audio data source for analysis.
-int jack_init(void);
+/*
+JACK client as an audio and MIDI source for analysis.
+
+The client registers one audio input port per analyzed channel and one MIDI
+input port for beats. Its process callback only interleaves the ports into a
+preallocated buffer and hands it to analyze_feed_frames() and MIDI notes to
+analyze_push_event(), both of which are lock-free, so it never locks,
+allocates or prints.
+
+If the JACK server goes away, the visuals keep running on the last metrics
+and jack_poll() keeps trying to open the client again, reconnecting the input
+ports to their sources once the server is back.
+*/
+
+#include <stdint.h>
+
+// Seconds between attempts to reopen the client after losing the server.
+#define JACK_RECONNECT_INTERVAL 1.0
+
+typedef struct {
+    // Amount of audio input ports, between 1 and MAX_CHANNELS.
+    uint8_t ports;
+    // Comma separated names of the ports to connect the input ports to, in
+    // order, e.g. "system:capture_1,system:capture_2", or 0 to leave them
+    // unconnected.
+    const char *connect;
+} JackConfig;
+
+// Initializes a JACK client as described by `config` as an audio data source
+// for analysis. Returns 0 on success.
+int jack_init(const JackConfig *config);
+// Reopens the client if the server has gone away, at most every
+// JACK_RECONNECT_INTERVAL seconds. Called regularly by the render thread.
+void jack_poll(void);
 void jack_deinit(void);
 
 #endif
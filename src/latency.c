@@ -0,0 +1,64 @@
+#include "latency.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *stage_names[LATENCY_STAGE_COUNT] = {
+    [LATENCY_ANALYSIS] = "capture-analysis",
+    [LATENCY_PRESENT] = "analysis-present",
+    [LATENCY_TOTAL] = "total",
+};
+
+void latency_record(LatencyStats *stats, uint64_t capture_time,
+                    uint64_t analysis_time, uint64_t present_time) {
+    if (capture_time == 0 || capture_time == stats->last_capture_time)
+        return;
+    stats->last_capture_time = capture_time;
+
+    float *samples[LATENCY_STAGE_COUNT];
+    for (size_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++)
+        samples[stage] = &stats->samples[stage][stats->position];
+    *samples[LATENCY_ANALYSIS] = (analysis_time - capture_time) / 1e6;
+    *samples[LATENCY_PRESENT] = (present_time - analysis_time) / 1e6;
+    *samples[LATENCY_TOTAL] = (present_time - capture_time) / 1e6;
+
+    stats->position = (stats->position + 1) % LATENCY_HISTORY;
+    if (stats->count < LATENCY_HISTORY)
+        stats->count++;
+}
+
+static int compare_floats(const void *a, const void *b) {
+    float difference = *(const float *)a - *(const float *)b;
+    return (difference > 0) - (difference < 0);
+}
+
+float latency_percentile(const LatencyStats *stats, LatencyStage stage,
+                         float percentile) {
+    if (stats->count == 0)
+        return 0;
+
+    float sorted[LATENCY_HISTORY];
+    memcpy(sorted, stats->samples[stage], stats->count * sizeof(float));
+    qsort(sorted, stats->count, sizeof(float), compare_floats);
+
+    size_t index = percentile / 100 * (stats->count - 1) + 0.5;
+    return sorted[index];
+}
+
+void latency_format(const LatencyStats *stats, char *out, size_t size) {
+    size_t length = 0;
+    out[0] = 0;
+    for (size_t stage = 0; stage < LATENCY_STAGE_COUNT && length < size;
+         stage++) {
+        int written = snprintf(
+            out + length, size - length, "%s%s %.1f/%.1f/%.1f ms",
+            stage ? ", " : "", stage_names[stage],
+            latency_percentile(stats, stage, 50),
+            latency_percentile(stats, stage, 95),
+            latency_percentile(stats, stage, 99));
+        if (written < 0)
+            break;
+        length += written;
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef _LATENCY
+#define _LATENCY
+
+/*
+Statistics of the latency from capturing audio to presenting the frame that
+shows it, split into the time until the analysis finished and the time from
+there until the frame was presented. Percentiles are computed over the most
+recent LATENCY_HISTORY analysis results.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LATENCY_HISTORY 1024
+
+typedef enum {
+    // From capture until the analysis finished.
+    LATENCY_ANALYSIS = 0,
+    // From the end of the analysis until the frame was presented.
+    LATENCY_PRESENT,
+    // From capture until the frame was presented.
+    LATENCY_TOTAL,
+    LATENCY_STAGE_COUNT,
+} LatencyStage;
+
+typedef struct {
+    // Latencies in milliseconds, a ring of the latest results.
+    float samples[LATENCY_STAGE_COUNT][LATENCY_HISTORY];
+    size_t count;
+    size_t position;
+    // Capture time of the latest recorded result.
+    uint64_t last_capture_time;
+} LatencyStats;
+
+// Records the latency of the analysis result captured at `capture_time` and
+// analyzed at `analysis_time`, presented at `present_time`, all in
+// nanoseconds. Only the first frame presenting a result is recorded.
+void latency_record(LatencyStats *stats, uint64_t capture_time,
+                    uint64_t analysis_time, uint64_t present_time);
+// The latency in milliseconds of `stage` below which `percentile` (0-100) of
+// the recorded results are. Zero if nothing has been recorded.
+float latency_percentile(const LatencyStats *stats, LatencyStage stage,
+                         float percentile);
+// Writes a one line summary of the median and 95th and 99th percentiles of all
+// stages into `out`.
+void latency_format(const LatencyStats *stats, char *out, size_t size);
+
+#endif
@@ -0,0 +1,208 @@
+#include "loudness.h"
+
+#include <math.h>
+#include <string.h>
+
+// Center of the interpolation filter, in oversampled samples.
+#define PEAK_FILTER_CENTER (LOUDNESS_OVERSAMPLING * LOUDNESS_PEAK_TAPS / 2)
+
+static inline double biquad(LoudnessBiquad *filter, double x) {
+    double y = filter->b0 * x + filter->z1;
+    filter->z1 = filter->b1 * x - filter->a1 * y + filter->z2;
+    filter->z2 = filter->b2 * x - filter->a2 * y;
+    return y;
+}
+
+// The two stages of the K-weighting filter of ITU-R BS.1770 at any sample
+// rate, from the analog prototypes its 48 kHz coefficients come from.
+static void k_weighting(LoudnessBiquad *shelf, LoudnessBiquad *highpass,
+                        uint32_t sample_rate) {
+    // High shelf of about +4 dB above 1.5 kHz, modelling the head
+    double k = tan(M_PI * 1681.974450955533 / sample_rate);
+    double q = 0.7071752369554196;
+    const double vh = pow(10.0, 3.999843853973347 / 20.0);
+    const double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    *shelf = (LoudnessBiquad){
+        .b0 = (vh + vb * k / q + k * k) / a0,
+        .b1 = 2.0 * (k * k - vh) / a0,
+        .b2 = (vh - vb * k / q + k * k) / a0,
+        .a1 = 2.0 * (k * k - 1.0) / a0,
+        .a2 = (1.0 - k / q + k * k) / a0,
+    };
+
+    // High pass at 38 Hz
+    k = tan(M_PI * 38.13547087602444 / sample_rate);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    *highpass = (LoudnessBiquad){
+        .b0 = 1.0,
+        .b1 = -2.0,
+        .b2 = 1.0,
+        .a1 = 2.0 * (k * k - 1.0) / a0,
+        .a2 = (1.0 - k / q + k * k) / a0,
+    };
+}
+
+int loudness_init(LoudnessMeter *meter, uint32_t channels,
+                  uint32_t sample_rate) {
+    memset(meter, 0, sizeof(LoudnessMeter));
+    if (channels == 0 || channels > LOUDNESS_MAX_CHANNELS || sample_rate == 0)
+        return 1;
+    meter->channels = channels;
+    meter->block_frames = sample_rate * LOUDNESS_BLOCK_DURATION + 0.5;
+    if (meter->block_frames == 0)
+        meter->block_frames = 1;
+
+    for (uint32_t channel = 0; channel < channels; channel++)
+        k_weighting(&meter->shelf[channel], &meter->highpass[channel],
+                    sample_rate);
+
+    // Hann windowed sinc, cut off at the Nyquist frequency of the input
+    for (uint32_t phase = 0; phase < LOUDNESS_OVERSAMPLING; phase++)
+        for (uint32_t tap = 0; tap < LOUDNESS_PEAK_TAPS; tap++) {
+            const int n = tap * LOUDNESS_OVERSAMPLING + phase;
+            const double x =
+                (double)(n - PEAK_FILTER_CENTER) / LOUDNESS_OVERSAMPLING;
+            const double sinc = x == 0 ? 1 : sin(M_PI * x) / (M_PI * x);
+            const double window =
+                0.5 - 0.5 * cos(M_PI * n / PEAK_FILTER_CENTER);
+            meter->peak_filter[tap][phase] = sinc * window;
+        }
+    return 0;
+}
+
+static inline float to_lufs(double mean_square) {
+    if (mean_square <= 0)
+        return LOUDNESS_FLOOR;
+    return fmaxf(LOUDNESS_FLOOR, -0.691 + 10 * log10(mean_square));
+}
+
+// Moves the sums of the finished block into the history and publishes the
+// levels after it.
+static void finish_block(LoudnessMeter *meter) {
+    const uint64_t index =
+        atomic_load_explicit(&meter->block_count, memory_order_relaxed);
+    const size_t slot = index % LOUDNESS_HISTORY;
+
+    meter->weighted[slot] = meter->block_weighted / meter->block_frames;
+    meter->square[slot] =
+        meter->block_square / ((double)meter->block_frames * meter->channels);
+    meter->peaks[slot] = meter->block_peak;
+    meter->momentary_sum += meter->weighted[slot];
+    meter->short_term_sum += meter->weighted[slot];
+    meter->square_sum += meter->square[slot];
+    if (index >= LOUDNESS_MOMENTARY_BLOCKS) {
+        const size_t old =
+            (index - LOUDNESS_MOMENTARY_BLOCKS) % LOUDNESS_HISTORY;
+        meter->momentary_sum -= meter->weighted[old];
+        meter->square_sum -= meter->square[old];
+    }
+    if (index >= LOUDNESS_SHORT_TERM_BLOCKS)
+        meter->short_term_sum -=
+            meter->weighted[(index - LOUDNESS_SHORT_TERM_BLOCKS) %
+                            LOUDNESS_HISTORY];
+
+    // Until the windows fill up, they cover the blocks so far
+    const uint64_t momentary_blocks = index + 1 < LOUDNESS_MOMENTARY_BLOCKS
+                                          ? index + 1
+                                          : LOUDNESS_MOMENTARY_BLOCKS;
+    const uint64_t short_term_blocks = index + 1 < LOUDNESS_SHORT_TERM_BLOCKS
+                                           ? index + 1
+                                           : LOUDNESS_SHORT_TERM_BLOCKS;
+    float peak = 0;
+    for (uint64_t i = 0; i < momentary_blocks; i++)
+        peak = fmaxf(peak, meter->peaks[(index - i) % LOUDNESS_HISTORY]);
+
+    meter->levels[slot] = (Loudness){
+        .momentary = to_lufs(meter->momentary_sum / momentary_blocks),
+        .short_term = to_lufs(meter->short_term_sum / short_term_blocks),
+        .rms = sqrt(fmax(0, meter->square_sum / momentary_blocks)),
+        .true_peak = peak,
+    };
+    atomic_store_explicit(&meter->block_count, index + 1,
+                          memory_order_release);
+
+    meter->block_position = 0;
+    meter->block_weighted = 0;
+    meter->block_square = 0;
+    meter->block_peak = 0;
+}
+
+void loudness_feed(LoudnessMeter *meter, const float *frames,
+                   size_t frame_count, size_t stride) {
+    while (frame_count) {
+        // Frames up to the end of the block, summed in locals
+        size_t count = meter->block_frames - meter->block_position;
+        if (count > frame_count)
+            count = frame_count;
+        double weighted_sum = 0, square_sum = 0;
+        float peak = meter->block_peak;
+
+        // One channel at a time, so that its filter state stays in registers
+        for (uint32_t channel = 0; channel < meter->channels; channel++) {
+            LoudnessBiquad shelf = meter->shelf[channel];
+            LoudnessBiquad highpass = meter->highpass[channel];
+            float *history = meter->peak_history[channel];
+            uint32_t position = meter->peak_position;
+            for (size_t i = 0; i < count; i++) {
+                const float x = frames[i * stride + channel];
+                const double weighted = biquad(&highpass, biquad(&shelf, x));
+                weighted_sum += weighted * weighted;
+                square_sum += x * x;
+
+                // Peaks between samples, from the samples interpolated
+                // between the newest ones
+                history[position] = x;
+                history[position + LOUDNESS_PEAK_TAPS] = x;
+                if (++position == LOUDNESS_PEAK_TAPS)
+                    position = 0;
+                float values[LOUDNESS_OVERSAMPLING] = {0};
+                for (uint32_t tap = 0; tap < LOUDNESS_PEAK_TAPS; tap++)
+                    for (uint32_t phase = 0; phase < LOUDNESS_OVERSAMPLING;
+                         phase++)
+                        values[phase] += meter->peak_filter[tap][phase] *
+                                         history[position + tap];
+                for (uint32_t phase = 0; phase < LOUDNESS_OVERSAMPLING;
+                     phase++) {
+                    // Unlike fmaxf(), compiles to a single instruction
+                    const float value = fabsf(values[phase]);
+                    peak = value > peak ? value : peak;
+                }
+            }
+            meter->shelf[channel] = shelf;
+            meter->highpass[channel] = highpass;
+        }
+        meter->peak_position = (meter->peak_position + count) %
+                               LOUDNESS_PEAK_TAPS;
+
+        meter->block_weighted += weighted_sum;
+        meter->block_square += square_sum;
+        meter->block_peak = peak;
+        meter->block_position += count;
+        frames += count * stride;
+        frame_count -= count;
+        if (meter->block_position == meter->block_frames)
+            finish_block(meter);
+    }
+}
+
+int loudness_read(LoudnessMeter *meter, uint64_t frame, Loudness *out_levels) {
+    const uint64_t count =
+        atomic_load_explicit(&meter->block_count, memory_order_acquire);
+    if (count == 0)
+        return 1;
+
+    // Blocks that ended at or before `frame`, keeping clear of the slots the
+    // producer is about to reuse
+    uint64_t ended = frame / meter->block_frames;
+    const uint64_t oldest =
+        count > LOUDNESS_HISTORY / 2 ? count - LOUDNESS_HISTORY / 2 : 1;
+    if (ended > count)
+        ended = count;
+    if (ended < oldest)
+        ended = oldest;
+
+    *out_levels = meter->levels[(ended - 1) % LOUDNESS_HISTORY];
+    return 0;
+}
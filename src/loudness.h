@@ -0,0 +1,104 @@
+#ifndef _LOUDNESS
+#define _LOUDNESS
+
+/*
+Streaming level metering of captured audio, in absolute units that do not
+depend on the normalization of spectra.
+
+Frames are metered as they are fed, on the audio thread, without buffering:
+each channel runs through the two biquads of the ITU-R BS.1770 K-weighting
+filter and a 4x oversampling interpolator for true peaks, and the results are
+collected in blocks of LOUDNESS_BLOCK_DURATION. After each block, the
+momentary (400 ms) and short-term (3 s) loudness, the RMS and the highest true
+peak are published into a ring of levels, so that a reader can look up the
+levels at any recent frame, e.g. one held back by a delay.
+
+The published levels follow the single-producer single-consumer rules of
+sample_ring.h: the reader must not fall more than LOUDNESS_HISTORY blocks
+behind.
+*/
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Length of a metering block in seconds.
+#define LOUDNESS_BLOCK_DURATION 0.01
+// Blocks of levels kept for readers, more than cover MAX_DELAY.
+#define LOUDNESS_HISTORY 512
+// Blocks in the momentary and short-term windows.
+#define LOUDNESS_MOMENTARY_BLOCKS 40
+#define LOUDNESS_SHORT_TERM_BLOCKS 300
+// Loudness reported for silence, in LUFS.
+#define LOUDNESS_FLOOR -70.0f
+// Taps of each phase of the true peak interpolator.
+#define LOUDNESS_PEAK_TAPS 12
+#define LOUDNESS_OVERSAMPLING 4
+// At least MAX_CHANNELS of analyze.h.
+#define LOUDNESS_MAX_CHANNELS 4
+
+typedef struct {
+    // K-weighted loudness over the last 400 ms and 3 s, in LUFS, at least
+    // LOUDNESS_FLOOR. A full scale 1 kHz sine in one channel reads -3 LUFS.
+    float momentary;
+    float short_term;
+    // Root mean square of the samples of all channels over the last 400 ms,
+    // and the highest true peak in that time, where 1.0 is full scale.
+    float rms;
+    float true_peak;
+} Loudness;
+
+typedef struct {
+    // Transposed direct form II biquad, coefficients normalized by a0.
+    double b0, b1, b2, a1, a2;
+    double z1, z2;
+} LoudnessBiquad;
+
+typedef struct {
+    uint32_t channels;
+    uint32_t block_frames;
+
+    LoudnessBiquad shelf[LOUDNESS_MAX_CHANNELS];
+    LoudnessBiquad highpass[LOUDNESS_MAX_CHANNELS];
+    // Interpolation filter, by tap and then phase so that all phases are
+    // computed together.
+    float peak_filter[LOUDNESS_PEAK_TAPS][LOUDNESS_OVERSAMPLING];
+    // Newest samples of each channel, stored twice so that they can be read
+    // in order from `peak_position` without wrapping.
+    float peak_history[LOUDNESS_MAX_CHANNELS][2 * LOUDNESS_PEAK_TAPS];
+    uint32_t peak_position;
+
+    // Sums over the block being metered.
+    uint32_t block_position;
+    double block_weighted;
+    double block_square;
+    float block_peak;
+
+    // Mean squares and peaks of recent blocks, and running sums of the mean
+    // squares over the windows.
+    double weighted[LOUDNESS_HISTORY];
+    double square[LOUDNESS_HISTORY];
+    float peaks[LOUDNESS_HISTORY];
+    double momentary_sum;
+    double short_term_sum;
+    double square_sum;
+
+    Loudness levels[LOUDNESS_HISTORY];
+    // Amount of blocks completed, and levels published.
+    _Atomic uint64_t block_count;
+} LoudnessMeter;
+
+// Initializes `meter` for frames of `channels` samples, up to
+// LOUDNESS_MAX_CHANNELS, at `sample_rate`. Returns 0 on success.
+int loudness_init(LoudnessMeter *meter, uint32_t channels,
+                  uint32_t sample_rate);
+// Meters `frame_count` interleaved `frames` whose samples are `stride` apart,
+// of which the first `channels` are used. Only called by the producer.
+void loudness_feed(LoudnessMeter *meter, const float *frames,
+                   size_t frame_count, size_t stride);
+// Writes the levels of the last block that ended at or before `frame` into
+// `out_levels`, or of the oldest kept block if `frame` is older. Returns 1 if
+// no block has ended yet.
+int loudness_read(LoudnessMeter *meter, uint64_t frame, Loudness *out_levels);
+
+#endif
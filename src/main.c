@@ -1,55 +1,443 @@
+#include "analysis_thread.h"
 #include "analyze.h"
 #include "clargs.h"
+#include "dsp.h"
+#include "frame_graph.h"
 #include "jack_init.h"
+#include "latency.h"
+#include "metrics_shm.h"
+#include "pcm_input.h"
+#include "offline.h"
+#include "playback.h"
+#include "profiler.h"
 #include "pulseaudio_init.h"
 #include "scenes.h"
 
 #include <raylib.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+// Frames drawn per second.
+#define FRAME_RATE 60
+// Seconds between updates of the latency readout and log.
+#define LATENCY_REPORT_INTERVAL 1.0
+// Seconds skipped with the arrow keys during playback.
+#define PLAYBACK_SEEK_STEP 5.0
+// Limit for --periods.
+#define MAX_CAPTURE_PERIODS 64
+// Most scene files in the playlist.
+#define MAX_PLAYLIST_LENGTH 64
+
+// Set by signals that ask to quit, so that the main loop ends and everything is
+// closed outside of signal context.
+static volatile sig_atomic_t quit_requested = 0;
+
+static void request_quit(int sig) {
+    quit_requested = 1;
+    (void)sig;
+}
+
+// Waits until `*next_frame`, in the clock of eventqueue_now(), and moves it on
+// by a frame. Frames are paced here instead of by raylib, which waits within
+// EndDrawing(), so that the time of presenting can be taken before the wait.
+static void wait_for_frame(uint64_t *next_frame) {
+    const uint64_t now = eventqueue_now();
+    // A late frame starts the schedule over rather than rushing to catch up
+    if (*next_frame < now)
+        *next_frame = now;
+    const struct timespec deadline = {
+        .tv_sec = *next_frame / 1000000000,
+        .tv_nsec = *next_frame % 1000000000,
+    };
+    // Interrupted by signals asking to quit
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, 0);
+    *next_frame += 1000000000 / FRAME_RATE;
+}
+
+// Switches scenes of the playlist with the number keys, Page Up and Page Down,
+// and MIDI program changes among the events of `metrics`.
+static void switch_scenes(const AudioMetrics *metrics) {
+    const size_t count = scenes_count();
+    const size_t current = scenes_current();
+    for (size_t i = 0; i < count && i < 9; i++)
+        if (IsKeyPressed(KEY_ONE + i))
+            scenes_switch(i);
+    if (IsKeyPressed(KEY_PAGE_DOWN))
+        scenes_switch((current + 1) % count);
+    if (IsKeyPressed(KEY_PAGE_UP))
+        scenes_switch((current + count - 1) % count);
+
+    for (uint32_t i = 0; i < metrics->event_count; i++)
+        if (metrics->events[i].type == EVENT_PROGRAM_CHANGE)
+            scenes_switch(metrics->events[i].note);
+}
 
 int main(int argc, char **argv) {
-    char *scene = 0;
+    char *scene_paths[MAX_PLAYLIST_LENGTH];
+    size_t scene_count = 0;
     char *device_index = 0;
+    char *window_name = 0;
+    char *fft_size = 0;
+    char *hop_size = 0;
+    char *analysis_rate = 0;
+    char *log_bands = 0;
+    char *mel_bands = 0;
+    char *cqt_bins = 0;
+    char *attack = 0;
+    char *release = 0;
+    char *rate = 0;
+    char *channels = 0;
+    char *period_size = 0;
+    char *periods = 0;
+    char *jack_connect = 0;
+    char *pcm_path = 0;
+    char *pcm_format_name = 0;
+    char *delay = 0;
+    char *latency_log_path = 0;
+    char *analyze_path = 0;
+    char *output_path = 0;
+    char *play_path = 0;
+    char *features_path = 0;
+    char *start = 0;
+    char *trace_path = 0;
+    char *publish_name = 0;
+    char *metrics_source = 0;
+    char *crossfade = 0;
     int use_jack = 0;
+    int show_latency = 0;
 
     CLARG {
-        help("Usage: muscini [file]\n\n\
+        help("Usage: muscini [scene file]...\n\
+       muscini --analyze [audio file] -o [feature file]\n\n\
 Options:\n\
 --help, -h\t\tPrint this message and exit.\n\
---jack\t\t\tStart as a JACK client.\n\
--d [index]\t\tSpecify a device to use for audio capture in non-JACK mode\n\n");
+--jack\t\t\tStart as a JACK client, with one input port per channel.\n\
+--jack-connect [ports]\tConnect the JACK input ports to these ports, comma\n\
+\t\t\tseparated, e.g. system:capture_1,system:capture_2.\n\
+-d [index]\t\tSpecify a device to use for audio capture in non-JACK mode\n\
+--pcm-in [path]\t\tRead raw interleaved PCM at --rate and --channels from\n\
+\t\t\tstandard input (-), a FIFO, a file or a UNIX socket\n\
+\t\t\tinstead of capturing. Files are read at --rate, and\n\
+\t\t\tmuscini quits when the input ends.\n\
+--pcm-format [format]\tSample format of --pcm-in: f32 (default) or s16.\n\
+--rate [hz]\t\tSample rate to capture at in non-JACK mode (def. 48000).\n\
+--channels [count]\tChannels to capture, 1-4 (default 2, or 1 with --jack).\n\
+--period-size [frames]\tFrames per capture period in non-JACK mode, smaller\n\
+\t\t\tfor lower latency at the cost of more CPU time.\n\
+--periods [count]\tPeriods buffered by the capture device in non-JACK mode.\n\
+--play [file]\t\tPlay an audio file instead of capturing, taking the metrics\n\
+\t\t\tfrom its feature file made with --analyze. The arrow\n\
+\t\t\tkeys seek backwards and forwards.\n\
+--features [file]\tFeature file of --play.\n\
+--start [seconds]\tStart --play from this point of the file.\n\
+--publish [name]\tShare each new analysis result and its events with\n\
+\t\t\tother local processes through shared memory under this\n\
+\t\t\tname.\n\
+--metrics-source [src]\tRender the metrics shared by another instance with\n\
+\t\t\tshm:[name] instead of capturing and analyzing audio.\n\
+--window [name]\t\tWindowing function applied before the FFT: none, parzen,\n\
+\t\t\twelch, hanning (default), hamming, blackman or steeper.\n\
+--fft-size [samples]\tSamples in each analysis window, 512-8192 (def. 1024).\n\
+--hop [samples]\t\tSamples between starts of analysis windows (def. 512).\n\
+--analysis-rate [hz]\tRun the analysis on its own thread this many times per\n\
+\t\t\tsecond (e.g. 200) instead of once per rendered frame.\n\
+--log-bands [count]\tAmount of log-spaced frequency bands (default 32).\n\
+--mel-bands [count]\tAmount of mel-spaced frequency bands (default 40).\n\
+--cqt [bins]\t\tAlso run a constant-Q transform with this many bins per\n\
+\t\t\toctave (e.g. 12, at most 48), for scenes that follow\n\
+\t\t\tbass lines and melodies note by note.\n\
+--attack [ms]\t\tTime for the band envelopes to rise (default 10).\n\
+--release [ms]\t\tTime for the band envelopes to fall (default 250).\n\
+--crossfade [ms]\tTime to fade between scenes (default 1000, 0 to cut).\n\
+--delay [ms]\t\tDelay visuals to line up with the sound system, or make\n\
+\t\t\tup for display latency with a negative value.\n\
+--latency\t\tShow capture to present latency in the window title.\n\
+--latency-log [file]\tLog latency percentiles to a file every second.\n\
+--trace [file]\t\tRecord how long each stage of each frame and the audio\n\
+\t\t\tcallbacks take, and write them to a file in Chrome trace\n\
+\t\t\tformat on exit, for chrome://tracing or Perfetto.\n\
+--analyze [file]\tAnalyze an audio file ahead of time on all cores instead\n\
+\t\t\tof running a scene, writing the features to the file\n\
+\t\t\tgiven with -o. Uses the analysis options above.\n\
+-o [file]\t\tOutput file of --analyze.\n\n\
+Several scene files make a playlist, loaded at the start. Press 1-9, Page Up\n\
+or Page Down, or send a MIDI program change to the MIDI port with --jack, to\n\
+switch between them.\n\
+Press F3 to show a graph of the time spent in each stage of recent frames.\n");
 
         flag(use_jack, "--jack");
+        flag_value(jack_connect, "--jack-connect");
         flag_value(device_index, "-d");
+        flag_path(pcm_path, "--pcm-in");
+        flag_value(pcm_format_name, "--pcm-format");
+        flag_value(rate, "--rate");
+        flag_value(channels, "--channels");
+        flag_value(period_size, "--period-size");
+        flag_value(periods, "--periods");
+        flag_value(play_path, "--play");
+        flag_value(features_path, "--features");
+        flag_value(start, "--start");
+        flag_value(publish_name, "--publish");
+        flag_value(metrics_source, "--metrics-source");
+        flag_value(window_name, "--window");
+        flag_value(fft_size, "--fft-size");
+        flag_value(hop_size, "--hop");
+        flag_value(analysis_rate, "--analysis-rate");
+        flag_value(log_bands, "--log-bands");
+        flag_value(mel_bands, "--mel-bands");
+        flag_value(cqt_bins, "--cqt");
+        flag_value(attack, "--attack");
+        flag_value(release, "--release");
+        flag_value(crossfade, "--crossfade");
+        flag_number(delay, "--delay");
+        flag(show_latency, "--latency");
+        flag_value(latency_log_path, "--latency-log");
+        flag_value(trace_path, "--trace");
+        flag_value(analyze_path, "--analyze");
+        flag_value(output_path, "-o");
 
-        file(scene);
+        file_list(scene_paths, scene_count, MAX_PLAYLIST_LENGTH);
     }
 
-    if (!scene) {
-        fprintf(stderr, "Usage: muscini [file]\n\
+    if (!scene_count && !analyze_path) {
+        fprintf(stderr, "Usage: muscini [scene file]...\n\
 Use --help for more information.\n");
         return 1;
     }
+    if (scene_count > MAX_PLAYLIST_LENGTH) {
+        fprintf(stderr, "ERROR: at most %d scene files can be given.\n",
+                MAX_PLAYLIST_LENGTH);
+        return 1;
+    }
+
+    AnalyzeConfig analyze_config = {
+        .window = HANNING,
+        .input_size = DEFAULT_INPUT_SIZE,
+        .hop_size = DEFAULT_HOP_SIZE,
+        .channels = use_jack ? 1 : PULSEAUDIO_DEFAULT_CHANNELS,
+        .log_band_count = DEFAULT_LOG_BAND_COUNT,
+        .mel_band_count = DEFAULT_MEL_BAND_COUNT,
+    };
+    if (window_name &&
+        dsp_window_from_name(window_name, &analyze_config.window)) {
+        fprintf(stderr, "ERROR: unknown windowing function '%s'.\n",
+                window_name);
+        return 1;
+    }
+
+    if (fft_size)
+        analyze_config.input_size = strtol(fft_size, 0, 10);
+    if (hop_size)
+        analyze_config.hop_size = strtol(hop_size, 0, 10);
+    else if (analyze_config.hop_size > analyze_config.input_size)
+        analyze_config.hop_size = analyze_config.input_size / 2;
+
+    if (analyze_config.input_size < MIN_INPUT_SIZE ||
+        analyze_config.input_size > MAX_INPUT_SIZE) {
+        fprintf(stderr, "ERROR: FFT size must be between %d and %d.\n",
+                MIN_INPUT_SIZE, MAX_INPUT_SIZE);
+        return 1;
+    }
+    if (analyze_config.hop_size == 0 ||
+        analyze_config.hop_size > analyze_config.input_size) {
+        fprintf(stderr,
+                "ERROR: hop size must be between 1 and the FFT size.\n");
+        return 1;
+    }
+
+    if (log_bands)
+        analyze_config.log_band_count = strtol(log_bands, 0, 10);
+    if (mel_bands)
+        analyze_config.mel_band_count = strtol(mel_bands, 0, 10);
+    if (analyze_config.log_band_count < 1 ||
+        analyze_config.log_band_count > MAX_BANDS ||
+        analyze_config.mel_band_count < 1 ||
+        analyze_config.mel_band_count > MAX_BANDS) {
+        fprintf(stderr, "ERROR: band counts must be between 1 and %d.\n",
+                MAX_BANDS);
+        return 1;
+    }
+
+    if (analyze_path) {
+        if (!output_path) {
+            fprintf(stderr, "ERROR: --analyze needs an output file, given "
+                            "with -o.\n");
+            return 1;
+        }
+        return offline_analyze(analyze_path, output_path, &analyze_config, 0);
+    }
+
+    uint32_t crossfade_time = DEFAULT_CROSSFADE;
+    if (crossfade) {
+        const long time = strtol(crossfade, 0, 10);
+        if (time < 0 || time > MAX_CROSSFADE) {
+            fprintf(stderr, "ERROR: crossfade must be between 0 and %d ms.\n",
+                    MAX_CROSSFADE);
+            return 1;
+        }
+        crossfade_time = time;
+    }
+
+    if (delay)
+        analyze_config.delay = strtol(delay, 0, 10);
+    if (analyze_config.delay < -MAX_DELAY || analyze_config.delay > MAX_DELAY) {
+        fprintf(stderr, "ERROR: delay must be between -%d and %d ms.\n",
+                MAX_DELAY, MAX_DELAY);
+        return 1;
+    }
+
+    if (cqt_bins) {
+        analyze_config.cqt_bins_per_octave = strtol(cqt_bins, 0, 10);
+        if (analyze_config.cqt_bins_per_octave < 1 ||
+            analyze_config.cqt_bins_per_octave > MAX_CQT_BINS_PER_OCTAVE) {
+            fprintf(stderr, "ERROR: constant-Q bins per octave must be "
+                            "between 1 and %d.\n",
+                    MAX_CQT_BINS_PER_OCTAVE);
+            return 1;
+        }
+    }
+
+    if (attack)
+        analyze_config.envelope_attack = strtol(attack, 0, 10);
+    if (release)
+        analyze_config.envelope_release = strtol(release, 0, 10);
+    if ((attack && (analyze_config.envelope_attack < 1 ||
+                    analyze_config.envelope_attack > MAX_ENVELOPE_TIME)) ||
+        (release && (analyze_config.envelope_release < 1 ||
+                     analyze_config.envelope_release > MAX_ENVELOPE_TIME))) {
+        fprintf(stderr, "ERROR: attack and release must be between 1 and %d "
+                        "ms.\n",
+                MAX_ENVELOPE_TIME);
+        return 1;
+    }
+
+    CaptureConfig capture_config = {
+        .device_index = device_index ? strtol(device_index, 0, 10) : -1,
+        .sample_rate = PULSEAUDIO_DEFAULT_SAMPLE_RATE,
+        .channels = PULSEAUDIO_DEFAULT_CHANNELS,
+    };
+    if (period_size)
+        capture_config.period_size = strtol(period_size, 0, 10);
+    if (periods)
+        capture_config.periods = strtol(periods, 0, 10);
+    if ((period_size && (capture_config.period_size < 1 ||
+                         capture_config.period_size > MAX_SAMPLE_RATE)) ||
+        (periods && (capture_config.periods < 1 ||
+                     capture_config.periods > MAX_CAPTURE_PERIODS))) {
+        fprintf(stderr, "ERROR: period size must be between 1 and %d frames "
+                        "and periods between 1 and %d.\n",
+                MAX_SAMPLE_RATE, MAX_CAPTURE_PERIODS);
+        return 1;
+    }
+    if (rate)
+        capture_config.sample_rate = strtol(rate, 0, 10);
+    if (capture_config.sample_rate < 1 ||
+        capture_config.sample_rate > MAX_SAMPLE_RATE) {
+        fprintf(stderr, "ERROR: sample rate must be between 1 and %d Hz.\n",
+                MAX_SAMPLE_RATE);
+        return 1;
+    }
+    if (channels) {
+        const long count = strtol(channels, 0, 10);
+        if (count < 1 || count > MAX_CHANNELS) {
+            fprintf(stderr, "ERROR: channel count must be between 1 and %d.\n",
+                    MAX_CHANNELS);
+            return 1;
+        }
+        capture_config.channels = count;
+        analyze_config.channels = count;
+    }
+    const JackConfig jack_config = {
+        .ports = analyze_config.channels,
+        .connect = jack_connect,
+    };
+    PcmConfig pcm_config = {
+        .path = pcm_path,
+        .format = PCM_F32,
+        .channels = capture_config.channels,
+        .sample_rate = capture_config.sample_rate,
+    };
+    if (pcm_format_name &&
+        pcm_format_from_name(pcm_format_name, &pcm_config.format)) {
+        fprintf(stderr, "ERROR: unknown PCM format '%s'.\n", pcm_format_name);
+        return 1;
+    }
+
+    FILE *latency_log = 0;
+    if (latency_log_path) {
+        latency_log = fopen(latency_log_path, "w");
+        if (!latency_log) {
+            fprintf(stderr, "ERROR: could not open latency log '%s'.\n",
+                    latency_log_path);
+            return 1;
+        }
+        fprintf(latency_log, "# seconds, then median/95th/99th percentile "
+                             "latencies of each stage\n");
+    }
+
+    if (play_path && !features_path) {
+        fprintf(stderr, "ERROR: --play needs a feature file, given with "
+                        "--features.\n");
+        return 1;
+    }
+
+    const char *shm_source = 0;
+    if (metrics_source) {
+        if (strncmp(metrics_source, "shm:", 4)) {
+            fprintf(stderr, "ERROR: unknown metrics source '%s', expected "
+                            "shm:[name].\n",
+                    metrics_source);
+            return 1;
+        }
+        if (play_path || publish_name) {
+            fprintf(stderr, "ERROR: --metrics-source can not be combined with "
+                            "--play or --publish.\n");
+            return 1;
+        }
+        shm_source = metrics_source + 4;
+    }
 
-    analyze_init();
+    profiler_set_thread_name("render");
+    if (trace_path)
+        profiler_enable(1);
 
+    // Metrics from another instance need no analysis of their own
+    const int analyzing = !play_path && !shm_source;
+    if (analyzing)
+        analyze_init(&analyze_config);
+
+    MetricsShm metrics_shm = {0};
     int result = 0;
 
-    if (use_jack) {
-        result = jack_init();
+    if (shm_source) {
+        result = metricsshm_open(&metrics_shm, shm_source);
+    } else if (play_path) {
+        result = playback_init(play_path, features_path,
+                               analyze_config.delay);
+        if (!result && start)
+            playback_seek(strtod(start, 0));
+    } else if (pcm_path) {
+        result = pcm_input_init(&pcm_config);
+    } else if (use_jack) {
+        result = jack_init(&jack_config);
     } else {
-        int device_i = -1;
-        if (device_index)
-            device_i = strtol(device_index, 0, 10);
-        result = pulseaudio_init(device_i);
+        result = pulseaudio_init(&capture_config);
     }
 
     if (result) {
         fprintf(stderr, "ERROR: could not initialize audio source, exiting.\n");
         return 1;
     }
+    if (publish_name && metricsshm_create(&metrics_shm, publish_name))
+        return 1;
+
+    signal(SIGQUIT, request_quit);
+    signal(SIGTERM, request_quit);
+    signal(SIGHUP, request_quit);
+    signal(SIGINT, request_quit);
 
     scenes_init();
 
@@ -57,25 +445,142 @@ Use --help for more information.\n");
 
     SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     InitWindow(800, 450, "Muscini");
-    SetTargetFPS(60);
+    // Paced by wait_for_frame()
+    SetTargetFPS(0);
+
+    scenes_set_crossfade(crossfade_time);
+    for (size_t i = 0; i < scene_count; i++)
+        scenes_add(scene_paths[i]);
 
-    scenes_add(scene);
+    uint32_t analysis_thread_rate = 0;
+    if (analysis_rate)
+        analysis_thread_rate = strtol(analysis_rate, 0, 10);
+    if (analysis_thread_rate && analyzing &&
+        analysisthread_start(analysis_thread_rate,
+                             publish_name ? &metrics_shm : 0)) {
+        fprintf(stderr, "ERROR: could not start analysis thread.\n");
+        return 1;
+    }
 
     AudioMetrics metrics = {0};
+    // The analysis thread publishes each result itself, along with its events.
+    // They are read back like another instance would, so that no events are
+    // lost between frames.
+    MetricsShm published_shm = {0};
+    const int read_published =
+        analysis_thread_rate && analyzing && publish_name;
+    if (read_published) {
+        metricsshm_open(&published_shm, publish_name);
+        metrics = *analysisthread_get_metrics();
+    }
+    LatencyStats latency = {0};
+    double next_latency_report = 0;
+    // Analysis time of the last published metrics
+    uint64_t published_analysis = 0;
+    uint64_t next_frame = eventqueue_now();
+
+    while (!WindowShouldClose() && !quit_requested) {
+        if (pcm_path && pcm_input_ended()) {
+            printf("INFO: PCM input ended.\n");
+            break;
+        }
+        if (IsKeyPressed(KEY_F3))
+            framegraph_toggle(trace_path != 0);
+        if (use_jack)
+            jack_poll();
 
-    while (!WindowShouldClose()) {
-        analyze_get_metrics(&metrics);
-        scenes_update_current(&metrics);
+        AudioMetrics *current = &metrics;
+        uint64_t begin = profiler_begin();
+        if (shm_source) {
+            metricsshm_read(&metrics_shm, &metrics);
+        } else if (read_published) {
+            metricsshm_read(&published_shm, &metrics);
+        } else if (play_path) {
+            if (IsKeyPressed(KEY_LEFT))
+                playback_seek(playback_position() - PLAYBACK_SEEK_STEP);
+            if (IsKeyPressed(KEY_RIGHT))
+                playback_seek(playback_position() + PLAYBACK_SEEK_STEP);
+            playback_get_metrics(&metrics);
+        } else {
+            if (analysis_thread_rate)
+                current = analysisthread_get_metrics();
+            else
+                analyze_get_metrics(&metrics);
+            analyze_drain_events(current);
+        }
+        // Frames without a new result or events would only publish a copy
+        if (publish_name && !read_published &&
+            (current->analysis_time != published_analysis ||
+             current->event_count || current->beat)) {
+            metricsshm_publish(&metrics_shm, current);
+            published_analysis = current->analysis_time;
+        }
+        profiler_end_stage(PROFILE_ANALYSIS, begin);
+        switch_scenes(current);
+
+        BeginDrawing();
+        scenes_update_current(current);
+        framegraph_draw();
+        begin = profiler_begin();
+        EndDrawing();
+        const uint64_t presented = eventqueue_now();
+        wait_for_frame(&next_frame);
+        profiler_end_stage(PROFILE_PRESENT, begin);
+
+        latency_record(&latency, current->capture_time,
+                       current->analysis_time, presented);
+
+        if ((show_latency || latency_log) &&
+            GetTime() >= next_latency_report) {
+            next_latency_report = GetTime() + LATENCY_REPORT_INTERVAL;
+            char summary[256];
+            latency_format(&latency, summary, sizeof(summary));
+            if (show_latency) {
+                char title[300];
+                snprintf(title, sizeof(title), "Muscini - %s", summary);
+                SetWindowTitle(title);
+            }
+            if (latency_log) {
+                fprintf(latency_log, "%.1f %s\n", GetTime(), summary);
+                fflush(latency_log);
+            }
+        }
+
+        profiler_end_frame();
     }
 
-    if (use_jack)
+    analysisthread_stop();
+    if (read_published)
+        metricsshm_close(&published_shm);
+
+    if (play_path)
+        playback_deinit();
+    else if (shm_source)
+        metricsshm_close(&metrics_shm);
+    else if (pcm_path)
+        pcm_input_deinit();
+    else if (use_jack)
         jack_deinit();
     else
         pulseaudio_deinit();
+    if (publish_name)
+        metricsshm_close(&metrics_shm);
+
+    if (trace_path) {
+        if (profiler_write_trace(trace_path))
+            fprintf(stderr, "ERROR: could not write trace '%s'.\n",
+                    trace_path);
+        else
+            printf("INFO: Wrote trace to %s.\n", trace_path);
+    }
 
     scenes_deinit();
-    analyze_deinit();
+    if (analyzing)
+        analyze_deinit();
     CloseWindow();
 
+    if (latency_log)
+        fclose(latency_log);
+
     return 0;
 }
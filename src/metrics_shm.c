@@ -0,0 +1,259 @@
+#include "metrics_shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Attempts of a read before giving up until the next call, in case the
+// publisher keeps overwriting the slot being read.
+#define MAX_READ_ATTEMPTS 8
+
+static int set_name(MetricsShm *shm, const char *name) {
+    if (!*name || strlen(name) > METRICS_SHM_MAX_NAME || strchr(name, '/')) {
+        fprintf(stderr, "ERROR: shared memory name '%s' must have 1 to %d "
+                        "characters and no slashes.\n",
+                name, METRICS_SHM_MAX_NAME);
+        return 1;
+    }
+    snprintf(shm->object_name, sizeof(shm->object_name), "/muscini-%s",
+             name);
+    return 0;
+}
+
+int metricsshm_create(MetricsShm *shm, const char *name) {
+    memset(shm, 0, sizeof(*shm));
+    if (set_name(shm, name))
+        return 1;
+
+    // Readers of an object left by a previous publisher move on to the new one
+    shm_unlink(shm->object_name);
+    int fd = shm_open(shm->object_name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC,
+                      0644);
+    if (fd >= 0 && !ftruncate(fd, sizeof(MetricsShmRegion)))
+        shm->region = mmap(0, sizeof(MetricsShmRegion), PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fd, 0);
+    if (!shm->region || shm->region == MAP_FAILED) {
+        fprintf(stderr, "ERROR: could not create shared memory '%s': %s.\n",
+                shm->object_name, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(shm->object_name);
+        }
+        shm->region = 0;
+        return 1;
+    }
+    close(fd);
+    shm->publisher = 1;
+
+    // ftruncate() has zeroed the rest
+    MetricsShmRegion *region = shm->region;
+    region->version = METRICS_SHM_VERSION;
+    region->metrics_size = sizeof(AudioMetrics);
+    region->slot_count = METRICS_SHM_SLOTS;
+    atomic_store_explicit(&region->magic, METRICS_SHM_MAGIC,
+                          memory_order_release);
+    printf("INFO: Publishing metrics to shared memory %s.\n",
+           shm->object_name);
+    return 0;
+}
+
+void metricsshm_publish(MetricsShm *shm, const AudioMetrics *metrics) {
+    MetricsShmRegion *region = shm->region;
+    const uint64_t publication =
+        atomic_load_explicit(&region->published, memory_order_relaxed);
+    MetricsShmSlot *slot = &region->slots[publication % METRICS_SHM_SLOTS];
+    const uint32_t sequence =
+        atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+
+    atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_relaxed);
+    // Readers must not see any of the writes below without the odd sequence
+    atomic_thread_fence(memory_order_release);
+    slot->publication = publication;
+    slot->publish_time = eventqueue_now();
+    memcpy(&slot->metrics, metrics, sizeof(*metrics));
+    atomic_store_explicit(&slot->sequence, sequence + 2, memory_order_release);
+
+    atomic_store_explicit(&region->published, publication + 1,
+                          memory_order_release);
+}
+
+// Maps the object named in `shm` if it has the expected layout and is not the
+// one mapped already. Returns 0 if a new object was mapped.
+static int map_region(MetricsShm *shm) {
+    int fd = shm_open(shm->object_name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+        return 1;
+    struct stat status;
+    MetricsShmRegion *region = MAP_FAILED;
+    if (!fstat(fd, &status) &&
+        (!shm->region || status.st_dev != shm->device ||
+         status.st_ino != shm->inode) &&
+        status.st_size >= (off_t)sizeof(MetricsShmRegion))
+        region = mmap(0, sizeof(MetricsShmRegion), PROT_READ, MAP_SHARED, fd,
+                      0);
+    close(fd);
+    if (region == MAP_FAILED)
+        return 1;
+
+    // The publisher may still be setting up the header
+    int compatible = 0;
+    if (atomic_load_explicit(&region->magic, memory_order_acquire) ==
+        METRICS_SHM_MAGIC) {
+        compatible = region->version == METRICS_SHM_VERSION &&
+                     region->metrics_size == sizeof(AudioMetrics) &&
+                     region->slot_count == METRICS_SHM_SLOTS;
+        if (!compatible)
+            fprintf(stderr, "ERROR: metrics in shared memory %s are from an "
+                            "incompatible version of muscini.\n",
+                    shm->object_name);
+        // Not looked at again either way
+        shm->device = status.st_dev;
+        shm->inode = status.st_ino;
+    }
+    if (!compatible) {
+        munmap(region, sizeof(MetricsShmRegion));
+        return 1;
+    }
+
+    if (shm->region)
+        munmap(shm->region, sizeof(MetricsShmRegion));
+    else
+        printf("INFO: Reading metrics from shared memory %s.\n",
+               shm->object_name);
+    shm->region = region;
+    // Events of publications before the newest are too old to be of use
+    const uint64_t published =
+        atomic_load_explicit(&region->published, memory_order_acquire);
+    shm->read = published ? published - 1 : 0;
+    return 0;
+}
+
+int metricsshm_open(MetricsShm *shm, const char *name) {
+    memset(shm, 0, sizeof(*shm));
+    if (set_name(shm, name))
+        return 1;
+    shm->scratch = malloc(sizeof(AudioMetrics));
+    if (!shm->scratch)
+        abort();
+    if (map_region(shm))
+        printf("INFO: Waiting for metrics in shared memory %s.\n",
+               shm->object_name);
+    return 0;
+}
+
+// Copies the metrics of `publication` into `out`, only its events and beat if
+// `events_only` is set, along with their publish time. Returns 1 if the slot
+// was being written or does not hold the publication anymore.
+static int read_slot(const MetricsShmRegion *region, uint64_t publication,
+                     int events_only, AudioMetrics *out,
+                     uint64_t *out_publish_time) {
+    const MetricsShmSlot *slot =
+        &region->slots[publication % METRICS_SHM_SLOTS];
+    const uint32_t sequence =
+        atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if (sequence & 1)
+        return 1;
+
+    const uint64_t held = slot->publication;
+    *out_publish_time = slot->publish_time;
+    if (events_only) {
+        memcpy(out->events, slot->metrics.events, sizeof(out->events));
+        out->event_count = slot->metrics.event_count;
+        out->beat = slot->metrics.beat;
+    } else {
+        memcpy(out, &slot->metrics, sizeof(*out));
+    }
+
+    // The copy must be done before the sequence is checked again
+    atomic_thread_fence(memory_order_acquire);
+    return held != publication ||
+           atomic_load_explicit(&slot->sequence, memory_order_relaxed) !=
+               sequence;
+}
+
+// Appends the events of `metrics`, published at `publish_time`, to `events`,
+// with their offsets moved to `now`.
+static void append_events(FrameEvent *events, uint32_t *count,
+                          const AudioMetrics *metrics, uint64_t publish_time,
+                          uint64_t now) {
+    const float shift = ((int64_t)publish_time - (int64_t)now) / 1e9;
+    for (uint32_t i = 0;
+         i < metrics->event_count && *count < MAX_FRAME_EVENTS; i++) {
+        events[*count] = metrics->events[i];
+        events[(*count)++].offset += shift;
+    }
+}
+
+uint32_t metricsshm_read(MetricsShm *shm, AudioMetrics *out) {
+    const uint64_t now = eventqueue_now();
+    out->event_count = 0;
+    out->beat = 0;
+
+    if (!shm->region ||
+        atomic_load_explicit(&shm->region->published, memory_order_acquire) ==
+            shm->read) {
+        // The publisher may have been started again with a new object
+        if (now < shm->next_open)
+            return 0;
+        shm->next_open = now + METRICS_SHM_REOPEN_INTERVAL * 1e9;
+        if (map_region(shm))
+            return 0;
+    }
+    const MetricsShmRegion *region = shm->region;
+    AudioMetrics *scratch = shm->scratch;
+
+    FrameEvent events[MAX_FRAME_EVENTS];
+    for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+        const uint64_t published =
+            atomic_load_explicit(&region->published, memory_order_acquire);
+        if (published == shm->read)
+            return 0;
+        // The slot after the newest may be being written
+        uint64_t publication = shm->read;
+        if (published - publication > METRICS_SHM_SLOTS - 1)
+            publication = published - (METRICS_SHM_SLOTS - 1);
+
+        uint32_t event_count = 0;
+        float beat = 0;
+        uint64_t publish_time;
+        // Slots lost to the publisher meanwhile only lose their events
+        for (; publication + 1 < published; publication++) {
+            if (read_slot(region, publication, 1, scratch, &publish_time))
+                continue;
+            append_events(events, &event_count, scratch, publish_time, now);
+            beat = scratch->beat > beat ? scratch->beat : beat;
+        }
+        if (read_slot(region, publication, 0, scratch, &publish_time))
+            continue;
+        append_events(events, &event_count, scratch, publish_time, now);
+        beat = scratch->beat > beat ? scratch->beat : beat;
+
+        memcpy(out, scratch, sizeof(*out));
+        memcpy(out->events, events, event_count * sizeof(FrameEvent));
+        out->event_count = event_count;
+        out->beat = beat;
+        const uint32_t new_count = published - shm->read;
+        shm->read = published;
+        return new_count;
+    }
+
+    out->event_count = 0;
+    out->beat = 0;
+    return 0;
+}
+
+void metricsshm_close(MetricsShm *shm) {
+    if (shm->region)
+        munmap(shm->region, sizeof(MetricsShmRegion));
+    if (shm->publisher)
+        shm_unlink(shm->object_name);
+    free(shm->scratch);
+    shm->scratch = 0;
+    shm->region = 0;
+    shm->publisher = 0;
+}
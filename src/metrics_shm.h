@@ -0,0 +1,107 @@
+#ifndef _METRICS_SHM
+#define _METRICS_SHM
+
+/*
+Shares analysis results with other local processes through POSIX shared
+memory, so that several renderers, or other programs like a lighting bridge,
+can follow the same audio without each capturing and analyzing it.
+
+The publisher writes each AudioMetrics into the next slot of a small ring in
+the shared memory object "/muscini-<name>". Each slot is guarded by a sequence
+counter that is odd while the slot is being written, in the manner of a
+seqlock: readers copy a slot and check that its counter did not change
+meanwhile, retrying otherwise, so neither side ever blocks or waits for the
+other. A reader takes the metrics of the newest slot, and collects the events
+and beats of the slots published since its previous read, so that none are
+lost when it renders at a lower frame rate than the publisher. Event offsets
+are moved to the time of the read.
+
+The layout is MetricsShmRegion, which readers check against their own through
+its magic number, version and the size of AudioMetrics. There is one publisher
+per name. It removes the object when it closes, and while nothing is published
+readers look for the object of a publisher that has been started again every
+METRICS_SHM_REOPEN_INTERVAL seconds, so either side can be restarted.
+*/
+
+#include "analyze.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define METRICS_SHM_MAGIC 0x4d53434d
+#define METRICS_SHM_VERSION 1
+// Slots in the ring. The slot being written is never read, so a reader
+// collects events from up to METRICS_SHM_SLOTS - 1 publications.
+#define METRICS_SHM_SLOTS 4
+// Seconds between looks for a new object by a reader while nothing is
+// published.
+#define METRICS_SHM_REOPEN_INTERVAL 1.0
+// Longest name of a shared memory object.
+#define METRICS_SHM_MAX_NAME 64
+
+typedef struct {
+    // Odd while the publisher writes the slot.
+    _Atomic uint32_t sequence;
+    // Index of the publication in the slot, counting from 0.
+    uint64_t publication;
+    // Time the metrics were published, on the clock of eventqueue_now(). The
+    // offsets of their events are relative to it.
+    uint64_t publish_time;
+    AudioMetrics metrics;
+} MetricsShmSlot;
+
+typedef struct {
+    // METRICS_SHM_MAGIC, set last once the rest of the header is valid.
+    _Atomic uint32_t magic;
+    uint32_t version;
+    // sizeof(AudioMetrics) of the publisher.
+    uint32_t metrics_size;
+    uint32_t slot_count;
+    // Amount of publications so far. Publication `n` is in slot
+    // `n % slot_count`.
+    _Atomic uint64_t published;
+    MetricsShmSlot slots[METRICS_SHM_SLOTS];
+} MetricsShmRegion;
+
+typedef struct {
+    MetricsShmRegion *region;
+    // "/muscini-<name>".
+    char object_name[METRICS_SHM_MAX_NAME + sizeof("/muscini-")];
+    int publisher;
+    // Identity of the mapped object, to tell whether the name now belongs to
+    // another one.
+    dev_t device;
+    ino_t inode;
+    // Publications read so far by a reader.
+    uint64_t read;
+    // Time of the next look for a new object by a reader, on the clock of
+    // eventqueue_now().
+    uint64_t next_open;
+    // Copy of a slot being read, only handed out once it is known to be
+    // whole.
+    AudioMetrics *scratch;
+} MetricsShm;
+
+// Creates the shared memory object for `name` and maps it into `shm` for
+// publishing, replacing any object left with that name. Returns 0 on success.
+int metricsshm_create(MetricsShm *shm, const char *name);
+// Copies `metrics` into the next slot.
+void metricsshm_publish(MetricsShm *shm, const AudioMetrics *metrics);
+
+// Sets up `shm` for reading the metrics published as `name`, mapping its
+// object if it exists already. Returns 0 on success, 1 if `name` is not
+// valid.
+int metricsshm_open(MetricsShm *shm, const char *name);
+// Copies the newest published metrics into `out` along with the events and
+// beats since the previous call, like analyze_get_metrics() followed by
+// analyze_drain_events(). `out` is left as it is, apart from having no events
+// and no beat, if nothing has been published since. Returns the amount of new
+// publications.
+uint32_t metricsshm_read(MetricsShm *shm, AudioMetrics *out);
+
+// Unmaps the object, and removes it if `shm` is the publisher. Frees the
+// memory of a reader.
+void metricsshm_close(MetricsShm *shm);
+
+#endif
@@ -0,0 +1,441 @@
+#include "offline.h"
+#include "analyzer.h"
+#include "bands.h"
+#include "feature_file.h"
+#include "loudness.h"
+#include "miniaudio.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Frames decoded at once while reading the file, beyond those requested.
+#define DECODE_BLOCK 65536
+#define MAX_THREADS 64
+
+// Frames of a file decoded as they are needed, of which only those from the
+// latest request on are kept.
+typedef struct {
+    ma_decoder decoder;
+    uint32_t channels;
+    // Frames `first` up to `first + count` of the file, with room for
+    // `capacity`.
+    float *frames;
+    uint64_t first;
+    uint64_t count;
+    uint64_t capacity;
+} DecodedStream;
+
+typedef struct {
+    const AnalyzeConfig *config;
+    uint32_t sample_rate;
+    const char *path;
+    // Range of records of this chunk.
+    uint64_t first_record;
+    uint64_t end_record;
+    // Normalization level of the second pass, 0 in the first pass.
+    float maximum;
+    FeatureFile *output;
+    // Results of the first pass.
+    float peak;
+    uint32_t cqt_bin_count;
+    int failed;
+} Chunk;
+
+// Opens `path` for decoding into interleaved frames of at most MAX_CHANNELS
+// channels. Returns 0 on success.
+static int open_decoder(const char *path, ma_decoder *decoder) {
+    ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 0, 0);
+    if (ma_decoder_init_file(path, &config, decoder) != MA_SUCCESS)
+        return 1;
+    if (decoder->outputChannels > MAX_CHANNELS) {
+        // Let the decoder mix down the rest
+        ma_decoder_uninit(decoder);
+        config = ma_decoder_config_init(ma_format_f32, MAX_CHANNELS, 0);
+        if (ma_decoder_init_file(path, &config, decoder) != MA_SUCCESS)
+            return 1;
+    }
+    return 0;
+}
+
+// Amount of frames `decoder` yields, decoding them all if the format does not
+// tell.
+static uint64_t count_frames(ma_decoder *decoder) {
+    ma_uint64 length = 0;
+    if (ma_decoder_get_length_in_pcm_frames(decoder, &length) == MA_SUCCESS &&
+        length > 0)
+        return length;
+
+    float *block =
+        malloc(DECODE_BLOCK * decoder->outputChannels * sizeof(float));
+    if (!block)
+        abort();
+    uint64_t frame_count = 0;
+    for (;;) {
+        ma_uint64 read = 0;
+        ma_result result =
+            ma_decoder_read_pcm_frames(decoder, block, DECODE_BLOCK, &read);
+        frame_count += read;
+        if (result != MA_SUCCESS || read == 0)
+            break;
+    }
+    free(block);
+    return frame_count;
+}
+
+// Opens `path` for reading its frames from `start` on, at most `longest` at a
+// time. Returns 0 on success.
+static int stream_open(DecodedStream *stream, const char *path, uint64_t start,
+                       uint32_t longest) {
+    memset(stream, 0, sizeof(*stream));
+    if (open_decoder(path, &stream->decoder))
+        return 1;
+    if (start &&
+        ma_decoder_seek_to_pcm_frame(&stream->decoder, start) != MA_SUCCESS) {
+        ma_decoder_uninit(&stream->decoder);
+        return 1;
+    }
+    stream->channels = stream->decoder.outputChannels;
+    stream->first = start;
+    stream->capacity = longest + DECODE_BLOCK;
+    stream->frames =
+        malloc(stream->capacity * stream->channels * sizeof(float));
+    if (!stream->frames)
+        abort();
+    return 0;
+}
+
+// Returns frames `first` up to `first + count` of the file, which are zero past
+// its end. `first` must not be before that of the previous call, nor before
+// the `start` of stream_open().
+static const float *stream_read(DecodedStream *stream, uint64_t first,
+                                uint32_t count) {
+    const uint32_t channels = stream->channels;
+    const uint64_t buffered_end = stream->first + stream->count;
+    if (first + count <= buffered_end)
+        return stream->frames + (first - stream->first) * channels;
+
+    // Keep the requested frames that are buffered already, then fill up the
+    // rest of the buffer
+    if (first < buffered_end) {
+        const uint64_t kept = buffered_end - first;
+        memmove(stream->frames,
+                stream->frames + (first - stream->first) * channels,
+                kept * channels * sizeof(float));
+        stream->count = kept;
+    } else {
+        if (first > buffered_end)
+            ma_decoder_seek_to_pcm_frame(&stream->decoder, first);
+        stream->count = 0;
+    }
+    stream->first = first;
+
+    while (stream->count < count) {
+        ma_uint64 read = 0;
+        ma_result result = ma_decoder_read_pcm_frames(
+            &stream->decoder, stream->frames + stream->count * channels,
+            stream->capacity - stream->count, &read);
+        stream->count += read;
+        if (result != MA_SUCCESS || read == 0)
+            break;
+    }
+    if (stream->count < count) {
+        // Past the end of the file
+        memset(stream->frames + stream->count * channels, 0,
+               (count - stream->count) * channels * sizeof(float));
+        stream->count = count;
+    }
+    return stream->frames;
+}
+
+static void stream_close(DecodedStream *stream) {
+    ma_decoder_uninit(&stream->decoder);
+    free(stream->frames);
+}
+
+// The window of the record at `index`, decoded from the file, or zero-padded
+// in `padded` if it starts before the first frame.
+static inline const float *record_window(const Chunk *chunk,
+                                         DecodedStream *stream, uint64_t index,
+                                         float *padded) {
+    const uint32_t input_size = chunk->config->input_size;
+    const uint32_t channels = chunk->config->channels;
+    const uint64_t end = (index + 1) * chunk->config->hop_size;
+    if (end >= input_size)
+        return stream_read(stream, end - input_size, input_size);
+
+    size_t missing = input_size - end;
+    memset(padded, 0, missing * channels * sizeof(float));
+    memcpy(padded + missing * channels, stream_read(stream, 0, end),
+           end * channels * sizeof(float));
+    return padded;
+}
+
+// First frame of the window of the record at `index`.
+static inline uint64_t window_start(const AnalyzeConfig *config,
+                                    uint64_t index) {
+    const uint64_t end = (index + 1) * config->hop_size;
+    return end > config->input_size ? end - config->input_size : 0;
+}
+
+static void *analyze_chunk(void *arg) {
+    Chunk *chunk = arg;
+    const AnalyzeConfig *config = chunk->config;
+
+    Analyzer analyzer;
+    AudioMetrics *metrics = calloc(1, sizeof(AudioMetrics));
+    float *padded = malloc(config->input_size * config->channels *
+                           sizeof(float));
+    if (!metrics || !padded)
+        abort();
+    if (analyzer_init(&analyzer, config, chunk->sample_rate)) {
+        chunk->failed = 1;
+        analyzer_free(&analyzer);
+        free(metrics);
+        free(padded);
+        return 0;
+    }
+
+    // The constant-Q transform of a window covers the frames of this many
+    // hops, which are fed first in both passes
+    const uint32_t hop_size = config->hop_size;
+    const uint64_t cqt_pre_roll =
+        (analyzer.cqt.fft_size + hop_size - 1) / hop_size;
+    uint64_t pre_roll = cqt_pre_roll;
+    if (chunk->maximum != 0) {
+        // Onset detection depends on its history and the time since the last
+        // onset, both of which are identical after this many hops
+        uint64_t onset_pre_roll = ONSET_HISTORY_LENGTH + 1 +
+                                  analyzer.onset_detector.minimum_interval;
+        if (pre_roll < onset_pre_roll)
+            pre_roll = onset_pre_roll;
+    }
+    const uint64_t start =
+        chunk->first_record > pre_roll ? chunk->first_record - pre_roll : 0;
+
+    // Only the frames of this chunk and its pre-roll are decoded
+    DecodedStream stream;
+    if (stream_open(&stream, chunk->path, window_start(config, start),
+                    config->input_size)) {
+        chunk->failed = 1;
+        analyzer_free(&analyzer);
+        free(metrics);
+        free(padded);
+        return 0;
+    }
+
+    if (chunk->maximum == 0) {
+        // First pass
+        chunk->cqt_bin_count = analyzer.cqt.bin_count;
+        for (uint64_t i = start; i < chunk->end_record; i++) {
+            const float *window = record_window(chunk, &stream, i, padded);
+            float peak = analyzer_transform(&analyzer, window, metrics);
+            if (i >= chunk->first_record)
+                chunk->peak = fmaxf(chunk->peak, peak);
+        }
+    } else {
+        analyzer_set_fixed_maximum(&analyzer, chunk->maximum);
+        float strengths[ONSET_BAND_COUNT];
+        for (uint64_t i = start; i < chunk->end_record; i++) {
+            const float *window = record_window(chunk, &stream, i, padded);
+            memset(metrics->onsets, 0, sizeof(metrics->onsets));
+            analyzer_process(&analyzer, window, metrics, strengths);
+            if (i >= chunk->first_record)
+                featurefile_write_metrics(chunk->output, i, metrics);
+        }
+    }
+
+    stream_close(&stream);
+    analyzer_free(&analyzer);
+    free(metrics);
+    free(padded);
+    return 0;
+}
+
+// Runs analyze_chunk() on all `chunks` in parallel. Returns 0 on success.
+static int run_chunks(Chunk *chunks, uint32_t count) {
+    pthread_t threads[MAX_THREADS];
+    uint32_t started = 0;
+    for (; started < count; started++)
+        if (pthread_create(&threads[started], 0, analyze_chunk,
+                           &chunks[started]))
+            break;
+    for (uint32_t i = 0; i < started; i++)
+        pthread_join(threads[i], 0);
+
+    int failed = started < count;
+    for (uint32_t i = 0; i < count; i++)
+        failed |= chunks[i].failed;
+    return failed;
+}
+
+// Estimates harmony, follows the envelopes and meters the loudness of all
+// records of `output` in order, since they depend on every hop before. The
+// spectra and bands need to be stored already. The loudness is metered on the
+// frames of `path`, decoded a block at a time. Returns 0 on success.
+static int follow_records(FeatureFile *output, const AnalyzeConfig *config,
+                          const char *path, uint32_t sample_rate) {
+    const FeatureHeader *header = output->header;
+    const uint32_t hop_size = header->hop_size;
+    const uint32_t channels = header->channels;
+
+    // Only needs the harmony estimator and the envelopes
+    AnalyzeConfig follow_config = *config;
+    follow_config.cqt_bins_per_octave = 0;
+    Analyzer analyzer;
+    AudioMetrics *metrics = calloc(1, sizeof(AudioMetrics));
+    LoudnessMeter *meter = calloc(1, sizeof(LoudnessMeter));
+    if (!metrics || !meter)
+        abort();
+    DecodedStream stream;
+    if (stream_open(&stream, path, 0, hop_size)) {
+        free(metrics);
+        free(meter);
+        return 1;
+    }
+    int failed = analyzer_init(&analyzer, &follow_config, sample_rate) ||
+                 loudness_init(meter, channels, sample_rate);
+
+    // Like captured audio before the first metering block ends
+    Loudness levels = {
+        .momentary = LOUDNESS_FLOOR,
+        .short_term = LOUDNESS_FLOOR,
+    };
+    for (uint64_t i = 0; !failed && i < header->record_count; i++) {
+        loudness_feed(meter, stream_read(&stream, i * hop_size, hop_size),
+                      hop_size, channels);
+        loudness_read(meter, (i + 1) * hop_size, &levels);
+
+        featurefile_read_metrics(output, i, metrics);
+        analyzer_follow(&analyzer, metrics);
+        metrics->loudness = levels;
+        featurefile_write_metrics(output, i, metrics);
+    }
+
+    stream_close(&stream);
+    analyzer_free(&analyzer);
+    free(metrics);
+    free(meter);
+    return failed;
+}
+
+static inline double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) +
+           (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int offline_analyze(const char *input_path, const char *output_path,
+                    const AnalyzeConfig *config, uint32_t thread_count) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // The frames are decoded by each pass as they are analyzed, rather than
+    // all kept in memory
+    ma_decoder decoder;
+    if (open_decoder(input_path, &decoder)) {
+        fprintf(stderr, "ERROR: could not decode '%s'.\n", input_path);
+        return 1;
+    }
+    const uint64_t frame_count = count_frames(&decoder);
+    const uint32_t channels = decoder.outputChannels;
+    const uint32_t sample_rate = decoder.outputSampleRate;
+    ma_decoder_uninit(&decoder);
+    if (sample_rate > MAX_SAMPLE_RATE) {
+        fprintf(stderr, "ERROR: sample rate of '%s' is above %d Hz.\n",
+                input_path, MAX_SAMPLE_RATE);
+        return 1;
+    }
+
+    AnalyzeConfig file_config = *config;
+    file_config.channels = channels;
+    const uint64_t record_count = frame_count / config->hop_size;
+    if (record_count == 0) {
+        fprintf(stderr, "ERROR: '%s' is shorter than one hop.\n", input_path);
+        return 1;
+    }
+
+    if (thread_count == 0)
+        thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (thread_count < 1)
+        thread_count = 1;
+    if (thread_count > MAX_THREADS)
+        thread_count = MAX_THREADS;
+    if (thread_count > record_count)
+        thread_count = record_count;
+
+    Chunk chunks[MAX_THREADS];
+    for (uint32_t i = 0; i < thread_count; i++)
+        chunks[i] = (Chunk){
+            .config = &file_config,
+            .sample_rate = sample_rate,
+            .path = input_path,
+            .first_record = record_count * i / thread_count,
+            .end_record = record_count * (i + 1) / thread_count,
+        };
+
+    int result = run_chunks(chunks, thread_count);
+    float maximum = 0;
+    for (uint32_t i = 0; i < thread_count; i++)
+        maximum = fmaxf(maximum, chunks[i].peak);
+    // Silence is normalized like in live analysis
+    maximum = fmaxf(maximum, 0.001);
+
+    FeatureFile output = {0};
+    FeatureHeader header = {
+        .sample_rate = sample_rate,
+        .input_size = config->input_size,
+        .hop_size = config->hop_size,
+        .channels = channels,
+        .frequency_count = config->input_size / 2,
+        .log_band_count = config->log_band_count,
+        .mel_band_count = config->mel_band_count,
+        .cqt_bin_count = chunks[0].cqt_bin_count,
+        .cqt_bins_per_octave = config->cqt_bins_per_octave,
+        .frequency_resolution = (float)sample_rate / config->input_size,
+        .maximum = maximum,
+        .record_count = record_count,
+        .frame_count = frame_count,
+    };
+    // The amount of 1/3-octave bands depends on the sample rate
+    BandLayout third_octave_bands = {0};
+    if (bands_create_third_octave(&third_octave_bands, header.frequency_count,
+                                  header.frequency_resolution))
+        abort();
+    header.third_octave_band_count = third_octave_bands.count;
+    bands_free(&third_octave_bands);
+
+    if (!result && featurefile_create(&output, output_path, &header)) {
+        fprintf(stderr, "ERROR: could not create '%s'.\n", output_path);
+        return 1;
+    }
+
+    if (!result) {
+        for (uint32_t i = 0; i < thread_count; i++) {
+            chunks[i].maximum = maximum;
+            chunks[i].output = &output;
+        }
+        result = run_chunks(chunks, thread_count);
+    }
+    if (!result)
+        result = follow_records(&output, &file_config, input_path,
+                                sample_rate);
+    featurefile_close(&output);
+
+    if (result) {
+        fprintf(stderr, "ERROR: analysis of '%s' failed.\n", input_path);
+        return 1;
+    }
+
+    double duration = (double)frame_count / sample_rate;
+    double elapsed = seconds_since(&start);
+    printf("INFO: Analyzed %.1f s of audio in %.2f s (%.0fx real time) on %u "
+           "threads into %s.\n",
+           duration, elapsed, duration / elapsed, thread_count, output_path);
+    return 0;
+}
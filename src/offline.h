@@ -0,0 +1,27 @@
+#ifndef _OFFLINE
+#define _OFFLINE
+
+/*
+Offline analysis of audio files into feature files (see feature_file.h).
+
+The hops of the file are split into one chunk per thread. Each chunk decodes
+only its own frames and those of its pre-roll, a block at a time, so memory
+use does not grow with the length of the file. A first pass finds the loudest
+magnitude, so that all chunks normalize to the same level. In the second pass
+each chunk first analyzes a pre-roll of the hops before it, so that onset
+detection and the constant-Q transform are in the same state as if the whole
+file had been analyzed in order. Harmony, envelopes and loudness carry state
+over every hop before, so a last pass computes them in order from the stored
+spectra and the frames decoded once more. The result does not depend on the
+amount of threads.
+*/
+
+#include "analyze.h"
+
+// Analyzes the audio file at `input_path` with `config`, whose channel count
+// is taken from the file, on `thread_count` threads (0 for one per core), and
+// writes the features into `output_path`. Returns 0 on success.
+int offline_analyze(const char *input_path, const char *output_path,
+                    const AnalyzeConfig *config, uint32_t thread_count);
+
+#endif
@@ -0,0 +1,122 @@
+#include "onset.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Scale of the logarithmic compression of magnitudes, which makes the flux
+// depend on relative rather than absolute changes in level. Changes more than
+// 40 dB below the normalization level barely count.
+#define COMPRESSION 100.0
+// Flux needs to exceed the median of its history by this factor, plus
+// THRESHOLD_OFFSET, to count as an onset.
+#define THRESHOLD_MULTIPLIER 1.5
+#define THRESHOLD_OFFSET 0.3
+// Minimum time between two onsets in the same band, in seconds.
+#define MINIMUM_INTERVAL 0.08
+
+// Frequency ranges in Hz of the bands in OnsetBand.
+static const float band_ranges[ONSET_BAND_COUNT][2] = {
+    [ONSET_KICK] = {30, 150},
+    [ONSET_SNARE] = {250, 3000},
+    [ONSET_HAT] = {6000, 16000},
+};
+
+static inline uint32_t clamp_bin(float frequency, float resolution,
+                                 uint32_t frequency_count) {
+    uint32_t bin = frequency / resolution + 0.5;
+    if (bin >= frequency_count)
+        bin = frequency_count - 1;
+    return bin;
+}
+
+int onset_init(OnsetDetector *detector, uint32_t frequency_count,
+               float resolution, float hop_duration) {
+    memset(detector, 0, sizeof(OnsetDetector));
+    detector->frequency_count = frequency_count;
+    detector->previous = calloc(frequency_count, sizeof(float));
+    if (!detector->previous)
+        return 1;
+
+    for (size_t band = 0; band < ONSET_BAND_COUNT; band++) {
+        detector->band_from[band] =
+            clamp_bin(band_ranges[band][0], resolution, frequency_count);
+        detector->band_to[band] =
+            clamp_bin(band_ranges[band][1], resolution, frequency_count);
+        // The DC bin says nothing about onsets
+        if (detector->band_from[band] == 0)
+            detector->band_from[band] = 1;
+        if (detector->band_to[band] < detector->band_from[band])
+            detector->band_to[band] = detector->band_from[band];
+    }
+
+    detector->minimum_interval = ceilf(MINIMUM_INTERVAL / hop_duration);
+    for (size_t band = 0; band < ONSET_BAND_COUNT; band++)
+        detector->hops_since_onset[band] = detector->minimum_interval;
+    return 0;
+}
+
+void onset_free(OnsetDetector *detector) {
+    free(detector->previous);
+    detector->previous = 0;
+}
+
+// Median of the history of `band`, computed with an insertion sort of a copy.
+static inline float history_median(OnsetDetector *detector, size_t band) {
+    float sorted[ONSET_HISTORY_LENGTH];
+    for (size_t i = 0; i < ONSET_HISTORY_LENGTH; i++) {
+        float value = detector->history[band][i];
+        size_t j = i;
+        for (; j > 0 && sorted[j - 1] > value; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = value;
+    }
+    return sorted[ONSET_HISTORY_LENGTH / 2];
+}
+
+uint32_t onset_process(OnsetDetector *detector, const float *magnitudes,
+                       float *out_strengths) {
+    float flux[ONSET_BAND_COUNT] = {0};
+
+    for (size_t band = 0; band < ONSET_BAND_COUNT; band++) {
+        uint32_t from = detector->band_from[band];
+        uint32_t to = detector->band_to[band];
+        float sum = 0;
+        for (uint32_t bin = from; bin <= to; bin++) {
+            float compressed = log1pf(COMPRESSION * magnitudes[bin]);
+            float increase = compressed - detector->previous[bin];
+            if (increase > 0)
+                sum += increase;
+            detector->previous[bin] = compressed;
+        }
+        flux[band] = sum / (to - from + 1);
+    }
+
+    uint32_t onsets = 0;
+    for (size_t band = 0; band < ONSET_BAND_COUNT; band++) {
+        float threshold =
+            history_median(detector, band) * THRESHOLD_MULTIPLIER +
+            THRESHOLD_OFFSET;
+
+        out_strengths[band] = 0;
+        if (detector->hops_since_onset[band] < detector->minimum_interval)
+            detector->hops_since_onset[band]++;
+
+        // Only the rising edge counts, so one onset is reported as soon as the
+        // flux crosses the threshold.
+        if (flux[band] > threshold &&
+            flux[band] > detector->previous_flux[band] &&
+            detector->hops_since_onset[band] >= detector->minimum_interval) {
+            out_strengths[band] = 1.0 - threshold / flux[band];
+            detector->hops_since_onset[band] = 0;
+            onsets |= 1 << band;
+        }
+
+        detector->previous_flux[band] = flux[band];
+        detector->history[band][detector->history_position] = flux[band];
+    }
+    detector->history_position =
+        (detector->history_position + 1) % ONSET_HISTORY_LENGTH;
+
+    return onsets;
+}
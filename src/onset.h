@@ -0,0 +1,58 @@
+#ifndef _ONSET
+#define _ONSET
+
+/*
+Onset detection from consecutive magnitude spectra.
+
+For each band, the onset detection function is the half-wave rectified
+spectral flux: the average increase of log-compressed magnitude over the
+band's bins since the previous hop. An onset is reported when the flux rises
+above an adaptive threshold derived from the median of its recent history,
+with a minimum interval between onsets in the same band. Detection happens on
+the first hop above the threshold, so it adds no latency beyond the hop
+itself.
+*/
+
+#include <stdint.h>
+
+// Amount of past hops the adaptive threshold is computed over.
+#define ONSET_HISTORY_LENGTH 24
+
+typedef enum {
+    ONSET_KICK = 0,
+    ONSET_SNARE,
+    ONSET_HAT,
+    ONSET_BAND_COUNT,
+} OnsetBand;
+
+typedef struct {
+    uint32_t frequency_count;
+    // Log-compressed magnitudes of the previous hop.
+    float *previous;
+    // Range of bins of each band, inclusive.
+    uint32_t band_from[ONSET_BAND_COUNT];
+    uint32_t band_to[ONSET_BAND_COUNT];
+
+    float history[ONSET_BAND_COUNT][ONSET_HISTORY_LENGTH];
+    uint32_t history_position;
+    float previous_flux[ONSET_BAND_COUNT];
+    uint32_t hops_since_onset[ONSET_BAND_COUNT];
+    uint32_t minimum_interval;
+} OnsetDetector;
+
+// Initializes `detector` for spectra of `frequency_count` bins each
+// `resolution` Hz wide, computed every `hop_duration` seconds. Returns 0 on
+// success.
+int onset_init(OnsetDetector *detector, uint32_t frequency_count,
+               float resolution, float hop_duration);
+// Frees memory used by `detector`.
+void onset_free(OnsetDetector *detector);
+
+// Processes the magnitude spectrum of one hop, normalized so that 1.0 is a
+// recent maximum. Writes the strength
+// of an onset in each band into `out_strengths`, between 0.0 (no onset) and
+// 1.0. Returns a bitmask of the bands with an onset (1 << OnsetBand).
+uint32_t onset_process(OnsetDetector *detector, const float *magnitudes,
+                       float *out_strengths);
+
+#endif
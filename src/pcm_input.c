@@ -0,0 +1,237 @@
+#include "pcm_input.h"
+#include "analyze.h"
+#include "profiler.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// Most frames read at a time.
+#define READ_FRAMES 512
+// Milliseconds a read waits for data before checking whether to stop.
+#define POLL_TIMEOUT 100
+
+typedef enum {
+    SOURCE_STDIN = 0,
+    SOURCE_FILE,
+    SOURCE_FIFO,
+    SOURCE_SOCKET,
+} SourceType;
+
+static PcmConfig config;
+static SourceType source_type;
+static int fd = -1;
+static size_t frame_bytes = 0;
+
+// Whether the source is a regular file, whose frames are all there up front,
+// and when it was opened and how many frames have been read from it since.
+static int paced = 0;
+static uint64_t paced_start = 0;
+static uint64_t frames_read = 0;
+
+// Bytes of a frame that has not been read completely.
+static unsigned char partial_frame[MAX_CHANNELS * sizeof(float)];
+static size_t partial_bytes = 0;
+// Samples read in PCM_S16 before they are converted into the ring.
+static int16_t s16_buffer[READ_FRAMES * MAX_CHANNELS];
+
+static pthread_t thread_id = 0;
+static _Atomic int running = 0;
+static _Atomic int ended = 0;
+
+int pcm_format_from_name(const char *name, PcmFormat *out_format) {
+    if (!strcmp(name, "f32"))
+        *out_format = PCM_F32;
+    else if (!strcmp(name, "s16"))
+        *out_format = PCM_S16;
+    else
+        return 1;
+    return 0;
+}
+
+static int connect_socket(const char *path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path))
+        return -1;
+    strcpy(address.sun_path, path);
+
+    int socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket_fd < 0)
+        return -1;
+    if (connect(socket_fd, (struct sockaddr *)&address, sizeof(address))) {
+        close(socket_fd);
+        return -1;
+    }
+    return socket_fd;
+}
+
+// Opens the source at `config.path` into `fd`. Returns 0 on success.
+static int open_source(void) {
+    struct stat status;
+    paced_start = eventqueue_now();
+    frames_read = 0;
+
+    if (!strcmp(config.path, "-")) {
+        source_type = SOURCE_STDIN;
+        fd = STDIN_FILENO;
+        paced = !fstat(fd, &status) && S_ISREG(status.st_mode);
+        return 0;
+    }
+
+    if (stat(config.path, &status))
+        return 1;
+    paced = S_ISREG(status.st_mode);
+    if (S_ISSOCK(status.st_mode)) {
+        source_type = SOURCE_SOCKET;
+        fd = connect_socket(config.path);
+    } else if (S_ISFIFO(status.st_mode)) {
+        // Also being a writer keeps the FIFO from ending between writers
+        source_type = SOURCE_FIFO;
+        fd = open(config.path, O_RDWR | O_CLOEXEC);
+    } else {
+        source_type = SOURCE_FILE;
+        fd = open(config.path, O_RDONLY | O_CLOEXEC);
+    }
+    return fd < 0;
+}
+
+static void close_source(void) {
+    if (fd > STDIN_FILENO)
+        close(fd);
+    fd = -1;
+    partial_bytes = 0;
+}
+
+// Reads what is available of up to READ_FRAMES frames into the sample ring.
+// Returns 1 if the source has ended or failed.
+static int read_frames(void) {
+    uint32_t frame_count = READ_FRAMES;
+    float *frames = analyze_feed_begin(&frame_count);
+    unsigned char *target = config.format == PCM_F32
+                                ? (unsigned char *)frames
+                                : (unsigned char *)s16_buffer;
+
+    // The start of a frame may have come with the previous read
+    memcpy(target, partial_frame, partial_bytes);
+    ssize_t length = read(fd, target + partial_bytes,
+                          frame_count * frame_bytes - partial_bytes);
+    if (length <= 0) {
+        analyze_feed_commit(0);
+        return length == 0 || (errno != EINTR && errno != EAGAIN);
+    }
+
+    const size_t total = partial_bytes + length;
+    const uint32_t complete = total / frame_bytes;
+    partial_bytes = total % frame_bytes;
+    memcpy(partial_frame, target + complete * frame_bytes, partial_bytes);
+
+    if (config.format == PCM_S16)
+        for (size_t i = 0; i < complete * config.channels; i++)
+            frames[i] = s16_buffer[i] / 32768.0f;
+    analyze_feed_commit(complete);
+    frames_read += complete;
+    return 0;
+}
+
+// Waits until the frames of the next read would have been captured, had the
+// file been captured since it was opened.
+static void wait_for_frames(void) {
+    const uint64_t frames = frames_read + READ_FRAMES;
+    const uint64_t due =
+        paced_start + frames / config.sample_rate * 1000000000 +
+        frames % config.sample_rate * 1000000000 / config.sample_rate;
+    const struct timespec deadline = {
+        .tv_sec = due / 1000000000,
+        .tv_nsec = due % 1000000000,
+    };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, 0);
+}
+
+static void *read_loop(void *arg) {
+    profiler_set_thread_name("pcm input");
+    uint64_t next_connect = 0;
+
+    while (atomic_load_explicit(&running, memory_order_relaxed)) {
+        if (fd < 0) {
+            // Only sockets are connected again
+            const uint64_t now = eventqueue_now();
+            if (now < next_connect || open_source()) {
+                if (now >= next_connect)
+                    next_connect = now + PCM_RECONNECT_INTERVAL * 1e9;
+                poll(0, 0, POLL_TIMEOUT);
+                continue;
+            }
+            printf("INFO: Reconnected to %s.\n", config.path);
+        }
+
+        // Files would otherwise be read as fast as they can be
+        if (paced)
+            wait_for_frames();
+
+        struct pollfd request = {.fd = fd, .events = POLLIN};
+        if (poll(&request, 1, POLL_TIMEOUT) <= 0)
+            continue;
+
+        PROFILE_SCOPE("pcm read");
+        if (!read_frames())
+            continue;
+
+        close_source();
+        if (source_type != SOURCE_SOCKET) {
+            atomic_store_explicit(&ended, 1, memory_order_release);
+            break;
+        }
+        printf("INFO: Lost %s, reconnecting.\n", config.path);
+    }
+
+    (void)arg;
+    return 0;
+}
+
+int pcm_input_init(const PcmConfig *pcm_config) {
+    config = *pcm_config;
+    frame_bytes = config.channels *
+                  (config.format == PCM_F32 ? sizeof(float) : sizeof(int16_t));
+    partial_bytes = 0;
+    atomic_store(&ended, 0);
+
+    if (open_source()) {
+        fprintf(stderr, "ERROR: could not open PCM input '%s': %s.\n",
+                config.path, strerror(errno));
+        return 1;
+    }
+    analyze_set_sample_rate(config.sample_rate);
+    printf("INFO: Reading %u channels of %s PCM at %u Hz from %s.\n",
+           config.channels, config.format == PCM_F32 ? "f32" : "s16",
+           config.sample_rate, config.path);
+
+    atomic_store(&running, 1);
+    if (pthread_create(&thread_id, 0, &read_loop, 0)) {
+        perror("ERROR: could not create PCM input thread");
+        atomic_store(&running, 0);
+        close_source();
+        return 1;
+    }
+    return 0;
+}
+
+void pcm_input_deinit(void) {
+    if (!atomic_load(&running))
+        return;
+    atomic_store(&running, 0);
+    pthread_join(thread_id, 0);
+    close_source();
+}
+
+int pcm_input_ended(void) {
+    return atomic_load_explicit(&ended, memory_order_acquire);
+}
@@ -0,0 +1,53 @@
+#ifndef _PCM_INPUT
+#define _PCM_INPUT
+
+/*
+Raw PCM as an audio data source for analysis, for audio that comes from
+another local process rather than a sound server.
+
+Interleaved frames of the analyzed amount of channels, as 32-bit floats or
+16-bit signed integers in native byte order, are read from standard input, a
+FIFO, a file or a UNIX domain stream socket. A thread reads them straight into
+the sample ring of the analysis (see analyze_feed_begin()), converting 16-bit
+samples on the way, so frames are not copied in between.
+
+A FIFO is kept open for writing too, so writers can come and go. When the
+process on the other end of a socket goes away, the socket is connected again
+every PCM_RECONNECT_INTERVAL seconds. Standard input and files are read until
+they end. Regular files, also when redirected to standard input, are read at
+the sample rate as if they were being captured, rather than as fast as they
+can be.
+*/
+
+#include <stdint.h>
+
+// Seconds between attempts to connect to the socket again.
+#define PCM_RECONNECT_INTERVAL 1.0
+
+typedef enum {
+    PCM_F32 = 0,
+    PCM_S16,
+} PcmFormat;
+
+typedef struct {
+    // "-" for standard input, or the path of a FIFO, file or socket.
+    const char *path;
+    PcmFormat format;
+    // Amount of interleaved channels, the same as analyzed, and their sample
+    // rate.
+    uint8_t channels;
+    uint32_t sample_rate;
+} PcmConfig;
+
+// Parses "f32" or "s16" into `out_format`. Returns 0 on success.
+int pcm_format_from_name(const char *name, PcmFormat *out_format);
+
+// Starts reading frames as described by `config` for analysis. Returns 0 on
+// success.
+int pcm_input_init(const PcmConfig *config);
+// Stops reading and closes the source.
+void pcm_input_deinit(void);
+// Whether the source has ended, so no frames will arrive anymore.
+int pcm_input_ended(void);
+
+#endif
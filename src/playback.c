@@ -0,0 +1,222 @@
+#include "playback.h"
+
+#include "event_queue.h"
+#include "feature_file.h"
+#include "miniaudio.h"
+#include "profiler.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FORMAT ma_format_f32
+
+static ma_device audio_device;
+static ma_decoder decoder;
+static FeatureFile features;
+
+// Frames handed to the device so far, and when the last of them were handed
+// over. Written by the audio callback, `cursor_sequence` is odd while they are
+// being changed.
+static _Atomic uint32_t cursor_sequence;
+static _Atomic uint64_t cursor;
+static _Atomic uint64_t cursor_time;
+// Frame to continue playback from, or -1.
+static _Atomic int64_t seek_request = -1;
+
+// Frames buffered by the device before they are heard.
+static uint64_t device_latency;
+static int64_t delay_frames;
+// Record passed to the previous frame, -1 before the first.
+static int64_t previous_record = -1;
+
+static void data_callback(ma_device *device_context, void *output,
+                          const void *input, ma_uint32 frame_count) {
+    profiler_set_thread_name("audio");
+    PROFILE_SCOPE("audio callback");
+    uint64_t position = atomic_load_explicit(&cursor, memory_order_relaxed);
+
+    int64_t seek =
+        atomic_exchange_explicit(&seek_request, -1, memory_order_acquire);
+    if (seek >= 0 && ma_decoder_seek_to_pcm_frame(&decoder, seek) == MA_SUCCESS)
+        position = seek;
+
+    // Output is silenced before the callback, so after the end of the file
+    // the rest stays silent
+    ma_uint64 read = 0;
+    ma_decoder_read_pcm_frames(&decoder, output, frame_count, &read);
+
+    atomic_fetch_add_explicit(&cursor_sequence, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&cursor, position + read, memory_order_relaxed);
+    atomic_store_explicit(&cursor_time, eventqueue_now(),
+                          memory_order_relaxed);
+    atomic_fetch_add_explicit(&cursor_sequence, 1, memory_order_release);
+
+    (void)device_context;
+    (void)input;
+}
+
+// Frame that is heard at `now`, interpolated from the frames handed to the
+// device at the last callback.
+static uint64_t heard_frame(uint64_t now) {
+    uint32_t sequence;
+    uint64_t handed, time;
+    do {
+        sequence =
+            atomic_load_explicit(&cursor_sequence, memory_order_acquire);
+        handed = atomic_load_explicit(&cursor, memory_order_relaxed);
+        time = atomic_load_explicit(&cursor_time, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+    } while (sequence & 1 ||
+             sequence != atomic_load_explicit(&cursor_sequence,
+                                              memory_order_relaxed));
+
+    const uint32_t sample_rate = features.header->sample_rate;
+    uint64_t elapsed = 0;
+    if (time && now > time)
+        elapsed = (now - time) * sample_rate / 1000000000;
+    if (elapsed > device_latency)
+        elapsed = device_latency;
+
+    int64_t frame = (int64_t)(handed + elapsed - device_latency);
+    frame -= delay_frames;
+    return frame > 0 ? frame : 0;
+}
+
+int playback_init(const char *audio_path, const char *feature_path,
+                  int32_t delay) {
+    if (featurefile_open(&features, feature_path)) {
+        fprintf(stderr, "ERROR: could not read feature file '%s'.\n",
+                feature_path);
+        return 1;
+    }
+
+    ma_decoder_config decoder_config = ma_decoder_config_init(FORMAT, 0, 0);
+    if (ma_decoder_init_file(audio_path, &decoder_config, &decoder) !=
+        MA_SUCCESS) {
+        fprintf(stderr, "ERROR: could not decode '%s'.\n", audio_path);
+        featurefile_close(&features);
+        return 1;
+    }
+
+    // Not every format knows its length up front, those are trusted
+    ma_uint64 length = 0;
+    ma_decoder_get_length_in_pcm_frames(&decoder, &length);
+    if (decoder.outputSampleRate != features.header->sample_rate ||
+        (length && length != features.header->frame_count)) {
+        fprintf(stderr, "ERROR: '%s' was not analyzed from '%s'.\n",
+                feature_path, audio_path);
+        ma_decoder_uninit(&decoder);
+        featurefile_close(&features);
+        return 1;
+    }
+
+    ma_device_config device_config =
+        ma_device_config_init(ma_device_type_playback);
+    device_config.playback.format = FORMAT;
+    device_config.playback.channels = decoder.outputChannels;
+    device_config.sampleRate = decoder.outputSampleRate;
+    device_config.dataCallback = &data_callback;
+
+    if (ma_device_init(0, &device_config, &audio_device) != MA_SUCCESS) {
+        fprintf(stderr, "ERROR: Failed to initialize playback device.\n");
+        ma_decoder_uninit(&decoder);
+        featurefile_close(&features);
+        return 1;
+    }
+
+    device_latency =
+        (uint64_t)audio_device.playback.internalPeriodSizeInFrames *
+        audio_device.playback.internalPeriods;
+    delay_frames = (int64_t)delay * features.header->sample_rate / 1000;
+    previous_record = -1;
+
+    if (ma_device_start(&audio_device) != MA_SUCCESS) {
+        fprintf(stderr, "ERROR: Failed to start device.\n");
+        ma_device_uninit(&audio_device);
+        ma_decoder_uninit(&decoder);
+        featurefile_close(&features);
+        return 1;
+    }
+
+    printf("INFO: Playing %s on %s.\n", audio_path,
+           audio_device.playback.name);
+    return 0;
+}
+
+void playback_deinit(void) {
+    ma_device_uninit(&audio_device);
+    ma_decoder_uninit(&decoder);
+    featurefile_close(&features);
+}
+
+uint32_t playback_get_metrics(AudioMetrics *out_metrics) {
+    const FeatureHeader *header = features.header;
+    const uint64_t now = eventqueue_now();
+    const uint64_t frame = heard_frame(now);
+
+    out_metrics->event_count = 0;
+    out_metrics->beat = 0;
+    memset(out_metrics->onsets, 0, sizeof(out_metrics->onsets));
+
+    uint64_t record;
+    if (featurefile_record_at(&features, frame, &record))
+        return 0;
+
+    // After seeking, or when far behind, only the current record counts
+    int64_t first = previous_record + 1;
+    if ((int64_t)record < previous_record ||
+        (int64_t)record - previous_record > MAX_FRAME_EVENTS)
+        first = record;
+    previous_record = record;
+    if (first > (int64_t)record)
+        return 0;
+
+    featurefile_read_metrics(&features, record, out_metrics);
+    out_metrics->beat = 0;
+
+    for (uint64_t i = first; i <= record; i++) {
+        const float *onsets = featurefile_record(&features, i) +
+                              header->onsets_offset;
+        const float offset =
+            ((int64_t)((i + 1) * header->hop_size) - (int64_t)frame) /
+            (float)header->sample_rate;
+
+        for (uint8_t band = 0; band < ONSET_BAND_COUNT; band++) {
+            if (onsets[band] > out_metrics->onsets[band])
+                out_metrics->onsets[band] = onsets[band];
+            if (onsets[band] <= 0 ||
+                out_metrics->event_count == MAX_FRAME_EVENTS)
+                continue;
+
+            const int beat = band == ONSET_KICK;
+            if (beat)
+                out_metrics->beat = 1;
+            out_metrics->events[out_metrics->event_count++] = (FrameEvent){
+                .type = EVENT_ONSET,
+                .note = band,
+                .velocity = 1 + onsets[band] * 126,
+                .beat = beat,
+                .offset = offset,
+            };
+        }
+    }
+
+    out_metrics->analysis_time = now;
+    return record + 1 - first;
+}
+
+void playback_seek(double seconds) {
+    if (seconds < 0)
+        seconds = 0;
+    int64_t frame = seconds * features.header->sample_rate;
+    if ((uint64_t)frame > features.header->frame_count)
+        frame = features.header->frame_count;
+    atomic_store_explicit(&seek_request, frame, memory_order_release);
+}
+
+double playback_position(void) {
+    return (double)heard_frame(eventqueue_now()) /
+           features.header->sample_rate;
+}
@@ -0,0 +1,38 @@
+#ifndef _PLAYBACK
+#define _PLAYBACK
+
+/*
+Playback of an audio file together with its precomputed features (see
+feature_file.h), as a source of metrics instead of live analysis.
+
+The audio callback counts the frames it hands to the output device. The render
+thread turns that count into the frame that is currently heard, and looks up
+the record of the window ending there, so the visuals follow the sound without
+any analysis and are the same on every run. The onsets of all records passed
+since the previous frame become events, so none are missed at low frame rates.
+*/
+
+#include "analyze.h"
+
+#include <stdint.h>
+
+// Starts playing the audio file at `audio_path` on the default output device,
+// with the features in `feature_path`, which must have been analyzed from the
+// same file. Metrics are delayed by `delay` milliseconds, like with
+// AnalyzeConfig. Returns 0 on success.
+int playback_init(const char *audio_path, const char *feature_path,
+                  int32_t delay);
+// Stops playback and closes the files.
+void playback_deinit(void);
+
+// Writes the metrics of the audio that is currently heard into `out_metrics`,
+// including the events and beat since the previous call. Returns the amount
+// of records passed since the previous call.
+uint32_t playback_get_metrics(AudioMetrics *out_metrics);
+// Moves playback to `seconds` from the start of the file, clamped to its
+// length. Safe to call from any thread.
+void playback_seek(double seconds);
+// Seconds from the start of the file to the audio that is currently heard.
+double playback_position(void);
+
+#endif
@@ -0,0 +1,267 @@
+#include "profiler.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    uint64_t begin;
+    uint64_t end;
+    char name[PROFILER_NAME_LENGTH];
+} ProfileScope;
+
+typedef struct {
+    // Ring of PROFILER_RING_SIZE scopes in `rings`, set once the thread has
+    // claimed it.
+    ProfileScope *_Atomic scopes;
+    // Amount of scopes ever written, only changed by the owning thread.
+    _Atomic uint64_t written;
+    const char *_Atomic name;
+    // Whether the ring belongs to a running thread. Only cleared when a
+    // registered thread exits, see profiler_register_thread().
+    _Atomic int owned;
+} ProfileThread;
+
+_Atomic int profiler_enabled = 0;
+
+// Never allocated at runtime, since the threads recording include the
+// realtime audio threads. Pages of unclaimed rings are never touched.
+static ProfileScope rings[PROFILER_MAX_THREADS][PROFILER_RING_SIZE];
+static ProfileThread threads[PROFILER_MAX_THREADS];
+static _Atomic uint32_t thread_count = 0;
+static _Thread_local ProfileThread *current_thread = 0;
+static _Thread_local int thread_ignored = 0;
+static _Thread_local const char *thread_name = 0;
+// Releases the ring of a registered thread when it exits.
+static pthread_key_t release_key;
+static pthread_once_t release_key_once = PTHREAD_ONCE_INIT;
+static int release_key_created = 0;
+
+// Time the profiler was first enabled, the zero point of traces.
+static uint64_t start_time = 0;
+
+// Nanoseconds spent in each stage during this frame.
+static _Atomic uint64_t stage_times[PROFILE_STAGE_COUNT];
+// Milliseconds of each stage and then the whole frame, of previous frames.
+static float history[PROFILER_HISTORY][PROFILE_STAGE_COUNT + 1];
+static size_t history_position = 0;
+static size_t history_count = 0;
+static uint64_t frame_start = 0;
+
+static const char *stage_names[PROFILE_STAGE_COUNT] = {
+    [PROFILE_FIREWATCH] = "firewatch_check",
+    [PROFILE_ANALYSIS] = "analysis",
+    [PROFILE_SCENE] = "scene_update",
+    [PROFILE_PRESENT] = "EndDrawing",
+};
+
+static ProfileThread *get_thread(void) {
+    if (current_thread || thread_ignored)
+        return current_thread;
+
+    uint32_t index = atomic_fetch_add(&thread_count, 1);
+    if (index >= PROFILER_MAX_THREADS) {
+        thread_ignored = 1;
+        return 0;
+    }
+    atomic_store(&threads[index].owned, 1);
+    atomic_store_explicit(&threads[index].name, thread_name,
+                          memory_order_relaxed);
+    atomic_store_explicit(&threads[index].scopes, rings[index],
+                          memory_order_release);
+    current_thread = threads + index;
+    return current_thread;
+}
+
+void profiler_enable(int enabled) {
+    if (enabled && !start_time)
+        start_time = eventqueue_now();
+    atomic_store_explicit(&profiler_enabled, enabled, memory_order_relaxed);
+}
+
+void profiler_end(const char *name, uint64_t begin) {
+    if (!begin)
+        return;
+    uint64_t end = eventqueue_now();
+
+    ProfileThread *thread = get_thread();
+    if (!thread)
+        return;
+    uint64_t written =
+        atomic_load_explicit(&thread->written, memory_order_relaxed);
+    // A trace being written must not see the scope change without seeing
+    // `written` reach it, see profiler_write_trace()
+    atomic_thread_fence(memory_order_release);
+    ProfileScope *scope =
+        rings[thread - threads] + (written & (PROFILER_RING_SIZE - 1));
+    scope->begin = begin;
+    scope->end = end;
+    strncpy(scope->name, name, PROFILER_NAME_LENGTH - 1);
+    scope->name[PROFILER_NAME_LENGTH - 1] = 0;
+    atomic_store_explicit(&thread->written, written + 1,
+                          memory_order_release);
+}
+
+void profiler_end_stage(ProfileStage stage, uint64_t begin) {
+    if (!begin)
+        return;
+    atomic_fetch_add_explicit(stage_times + stage, eventqueue_now() - begin,
+                              memory_order_relaxed);
+    profiler_end(stage_names[stage], begin);
+}
+
+void profiler_end_frame(void) {
+    uint64_t now = profiler_begin();
+    if (!now) {
+        frame_start = 0;
+        return;
+    }
+
+    float *frame = history[history_position];
+    for (size_t stage = 0; stage < PROFILE_STAGE_COUNT; stage++)
+        frame[stage] = atomic_exchange_explicit(stage_times + stage, 0,
+                                                memory_order_relaxed) /
+                       1e6;
+    frame[PROFILE_STAGE_COUNT] = frame_start ? (now - frame_start) / 1e6 : 0;
+    frame_start = now;
+
+    history_position = (history_position + 1) % PROFILER_HISTORY;
+    if (history_count < PROFILER_HISTORY)
+        history_count++;
+}
+
+void profiler_set_thread_name(const char *name) {
+    thread_name = name;
+    if (current_thread)
+        atomic_store_explicit(&current_thread->name, name,
+                              memory_order_relaxed);
+}
+
+static void release_thread(void *thread) {
+    atomic_store(&((ProfileThread *)thread)->owned, 0);
+}
+
+static void create_release_key(void) {
+    release_key_created = !pthread_key_create(&release_key, release_thread);
+}
+
+// Takes over the ring of an exited thread that was registered as `name`.
+// Returns 0 if there is none.
+static ProfileThread *reclaim_thread(const char *name) {
+    uint32_t count = atomic_load(&thread_count);
+    if (count > PROFILER_MAX_THREADS)
+        count = PROFILER_MAX_THREADS;
+    for (uint32_t i = 0; i < count; i++) {
+        // Set after `owned` by a thread claiming a new ring
+        const char *owner = atomic_load(&threads[i].name);
+        int owned = 0;
+        if (owner && !strcmp(owner, name) &&
+            atomic_compare_exchange_strong(&threads[i].owned, &owned, 1))
+            return threads + i;
+    }
+    return 0;
+}
+
+void profiler_register_thread(const char *name) {
+    profiler_set_thread_name(name);
+    ProfileThread *thread = current_thread;
+    if (!thread && !thread_ignored)
+        thread = current_thread = reclaim_thread(name);
+    if (!thread) {
+        thread = get_thread();
+        if (!thread)
+            return;
+        // Faults in the pages of the ring now rather than in the first scopes
+        memset(rings[thread - threads], 0, sizeof(rings[0]));
+    }
+
+    pthread_once(&release_key_once, create_release_key);
+    if (release_key_created)
+        pthread_setspecific(release_key, thread);
+}
+
+int profiler_frame(size_t age, float *out_stages, float *out_frame) {
+    if (age >= history_count)
+        return 1;
+    const float *frame =
+        history[(history_position + PROFILER_HISTORY - 1 - age) %
+                PROFILER_HISTORY];
+    memcpy(out_stages, frame, PROFILE_STAGE_COUNT * sizeof(float));
+    *out_frame = frame[PROFILE_STAGE_COUNT];
+    return 0;
+}
+
+const char *profiler_stage_name(ProfileStage stage) {
+    return stage_names[stage];
+}
+
+// Writes `text` as a JSON string.
+static void write_string(FILE *file, const char *text) {
+    fputc('"', file);
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\')
+            fputc('\\', file);
+        if ((unsigned char)*text >= ' ')
+            fputc(*text, file);
+    }
+    fputc('"', file);
+}
+
+int profiler_write_trace(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file)
+        return 1;
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    int first = 1;
+    uint32_t count = atomic_load(&thread_count);
+    if (count > PROFILER_MAX_THREADS)
+        count = PROFILER_MAX_THREADS;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const ProfileThread *thread = threads + i;
+        const ProfileScope *scopes =
+            atomic_load_explicit(&thread->scopes, memory_order_acquire);
+        if (!scopes)
+            continue;
+
+        const char *name =
+            atomic_load_explicit(&thread->name, memory_order_relaxed);
+        if (name) {
+            fprintf(file,
+                    "%s{\"name\": \"thread_name\", \"ph\": \"M\", "
+                    "\"pid\": 1, \"tid\": %u, \"args\": {\"name\": ",
+                    first ? "" : ",\n", i + 1);
+            write_string(file, name);
+            fprintf(file, "}}");
+            first = 0;
+        }
+
+        uint64_t written =
+            atomic_load_explicit(&thread->written, memory_order_acquire);
+        uint64_t oldest =
+            written > PROFILER_RING_SIZE ? written - PROFILER_RING_SIZE : 0;
+        for (uint64_t j = oldest; j < written; j++) {
+            ProfileScope scope = scopes[j & (PROFILER_RING_SIZE - 1)];
+            // The thread may have begun writing scope `j + RING_SIZE` over
+            // this one meanwhile
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&thread->written, memory_order_relaxed) >=
+                j + PROFILER_RING_SIZE)
+                continue;
+
+            scope.name[PROFILER_NAME_LENGTH - 1] = 0;
+            fprintf(file, "%s{\"name\": ", first ? "" : ",\n");
+            write_string(file, scope.name);
+            fprintf(file,
+                    ", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, "
+                    "\"ts\": %.3f, \"dur\": %.3f}",
+                    i + 1, (scope.begin - start_time) / 1e3,
+                    (scope.end - scope.begin) / 1e3);
+            first = 0;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    return fclose(file) ? 1 : 0;
+}
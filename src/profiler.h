@@ -0,0 +1,107 @@
+#ifndef _PROFILER
+#define _PROFILER
+
+/*
+Low-overhead profiler of named scopes, for finding which stage of a frame or
+which thread makes a show stutter.
+
+Each thread writes the scopes it finishes into its own ring buffer, so
+recording never locks or allocates and only the newest PROFILER_RING_SIZE
+scopes of each thread are kept. The rings of all PROFILER_MAX_THREADS threads
+are static. They can be written out in the Chrome trace event format, which
+chrome://tracing and Perfetto open, even while threads keep recording.
+
+The main loop stages (see ProfileStage) are also summed per frame into a short
+history for the on-screen frame time graph (see frame_graph.h).
+
+Nothing is recorded until the profiler is enabled, and then a scope costs two
+clock reads and a copy of its name.
+*/
+
+#include "event_queue.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Scopes kept per thread, a power of two. About 15 seconds of the main loop,
+// whose frames each finish four scopes, in 160 KB per ring.
+#define PROFILER_RING_SIZE 4096
+// Threads that can record scopes, others are ignored.
+#define PROFILER_MAX_THREADS 16
+// Longest stored scope name, longer ones are truncated.
+#define PROFILER_NAME_LENGTH 24
+// Frames kept in the history of stage times.
+#define PROFILER_HISTORY 240
+
+typedef enum {
+    PROFILE_FIREWATCH = 0,
+    PROFILE_ANALYSIS,
+    // The whole scene_update(), or both during a crossfade.
+    PROFILE_SCENE,
+    // EndDrawing(): swapping buffers and waiting for the next frame.
+    PROFILE_PRESENT,
+    PROFILE_STAGE_COUNT,
+} ProfileStage;
+
+typedef struct {
+    const char *name;
+    uint64_t begin;
+} ProfileScopeGuard;
+
+// Whether scopes are recorded, see profiler_enable().
+extern _Atomic int profiler_enabled;
+
+// Starts or stops recording.
+void profiler_enable(int enabled);
+
+// Time to pass to profiler_end() when the scope ends, 0 if not recording.
+static inline uint64_t profiler_begin(void) {
+    if (!atomic_load_explicit(&profiler_enabled, memory_order_relaxed))
+        return 0;
+    return eventqueue_now();
+}
+
+// Records the scope `name` that began at `begin`. Ignored if `begin` is 0.
+void profiler_end(const char *name, uint64_t begin);
+// Like profiler_end(), and adds the duration to `stage` of this frame.
+void profiler_end_stage(ProfileStage stage, uint64_t begin);
+// Moves the stage times of this frame into the history. Called once per frame
+// by the render thread.
+void profiler_end_frame(void);
+// Name of the calling thread in traces. Cheap enough to call on every audio
+// callback.
+void profiler_set_thread_name(const char *name);
+// Names the calling thread and claims its ring up front, so that a realtime
+// thread does not page fault in its first scopes. The pages of the ring are
+// faulted in now if recording is enabled, or else when it is first enabled. The ring of a registered thread that
+// has exited is taken over by the next thread registered with the same name,
+// so that threads created again, e.g. by a reconnected audio server, do not
+// use up the PROFILER_MAX_THREADS rings.
+void profiler_register_thread(const char *name);
+
+// Writes the milliseconds spent in each stage, and in the whole frame, `age`
+// frames ago (0 is the previous frame) into `out_stages` and `out_frame`.
+// Returns 1 if the history does not reach that far.
+int profiler_frame(size_t age, float *out_stages, float *out_frame);
+// Name of `stage` in traces and the frame time graph.
+const char *profiler_stage_name(ProfileStage stage);
+
+// Writes the recorded scopes of all threads into `path` in Chrome trace event
+// format. Threads may keep recording meanwhile, the scopes they overwrite
+// while being written out are left out. Returns 0 on success.
+int profiler_write_trace(const char *path);
+
+static inline void profiler_scope_end(ProfileScopeGuard *guard) {
+    profiler_end(guard->name, guard->begin);
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+// Records the rest of the enclosing block as the scope `name`.
+#define PROFILE_SCOPE(name)                                                    \
+    __attribute__((cleanup(profiler_scope_end)))                               \
+    ProfileScopeGuard PROFILE_CONCAT(profile_scope_, __LINE__) = {             \
+        name, profiler_begin()}
+
+#endif
@@ -3,20 +3,21 @@
 #include "analyze.h"
 #include "audio_device.h"
 #include "miniaudio.h"
+#include "profiler.h"
 
 #include <stdio.h>
 
 #define FORMAT ma_format_f32
-#define CHANNELS 2
-#define SAMPLE_RATE 48000
 
 static ma_device audio_device;
 static ma_context audio_context;
 
 static void data_callback(ma_device *device_context, void *output,
                           const void *input, ma_uint32 frame_count) {
-    analyze_feed_frames((float *)input, frame_count, CHANNELS);
-    (void)device_context;
+    profiler_set_thread_name("audio");
+    PROFILE_SCOPE("audio callback");
+    analyze_feed_frames((float *)input, frame_count,
+                        device_context->capture.channels);
     (void)output;
 }
 
@@ -38,23 +39,30 @@ static inline int get_audio_device_id(ma_context *context, int device_index,
     return 0;
 }
 
-int pulseaudio_init(int device_index) {
+int pulseaudio_init(const CaptureConfig *config) {
     if (ma_context_init(NULL, 0, NULL, &audio_context) != MA_SUCCESS) {
         printf("Failed to initialize context.\n");
         return 1;
     }
 
     ma_device_id device_id;
-    if (get_audio_device_id(&audio_context, device_index, &device_id)) {
+    if (get_audio_device_id(&audio_context, config->device_index,
+                            &device_id)) {
         ma_context_uninit(&audio_context);
         return 1;
     }
     ma_device_config deviceConfig =
         ma_device_config_init(ma_device_type_capture);
     deviceConfig.capture.format = FORMAT;
-    deviceConfig.capture.channels = CHANNELS;
+    deviceConfig.capture.channels = config->channels;
     deviceConfig.capture.pDeviceID = &device_id;
-    deviceConfig.sampleRate = SAMPLE_RATE;
+    deviceConfig.sampleRate = config->sample_rate;
+    deviceConfig.periodSizeInFrames = config->period_size;
+    deviceConfig.periods = config->periods;
+    deviceConfig.performanceProfile = ma_performance_profile_low_latency;
+    // The analysis takes any amount of frames, so there is no need for the
+    // extra buffer that makes callbacks exactly one period long
+    deviceConfig.noFixedSizedCallback = MA_TRUE;
     deviceConfig.dataCallback = &data_callback;
 
     if (ma_device_init(0, &deviceConfig, &audio_device) != MA_SUCCESS) {
@@ -62,6 +70,18 @@ int pulseaudio_init(int device_index) {
         return 1;
     }
 
+    analyze_set_sample_rate(audio_device.sampleRate);
+
+    const uint32_t period_size =
+        audio_device.capture.internalPeriodSizeInFrames;
+    const uint32_t periods = audio_device.capture.internalPeriods;
+    const uint32_t device_rate = audio_device.capture.internalSampleRate;
+    printf("INFO: Capturing %u channels at %u Hz, device buffer of %u periods "
+           "of %u frames at %u Hz (%.1f ms).\n",
+           audio_device.capture.channels, audio_device.sampleRate, periods,
+           period_size, device_rate,
+           device_rate ? 1000.0 * period_size * periods / device_rate : 0.0);
+
     if (ma_device_start(&audio_device) != MA_SUCCESS) {
         ma_device_uninit(&audio_device);
         fprintf(stderr, "ERROR: Failed to start device.\n");
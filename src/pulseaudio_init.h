@@ -1,8 +1,29 @@
 #ifndef _PULSEAUDIO_INIT
 #define _PULSEAUDIO_INIT
 
-// Initializes pulseaudio as a audio data source for analysis.
-int pulseaudio_init(int device_index);
+#include <stdint.h>
+
+#define PULSEAUDIO_DEFAULT_CHANNELS 2
+#define PULSEAUDIO_DEFAULT_SAMPLE_RATE 48000
+
+typedef struct {
+    // Index of the device as listed by audiodevice_get_interactive(), or -1
+    // to ask for one.
+    int device_index;
+    // Sample rate and amount of channels to capture at. miniaudio converts
+    // from what the device offers if needed.
+    uint32_t sample_rate;
+    uint8_t channels;
+    // Frames in each period, i.e. each callback, and amount of periods
+    // buffered by the device, or 0 to let the backend choose.
+    uint32_t period_size;
+    uint32_t periods;
+} CaptureConfig;
+
+// Initializes pulseaudio as a audio data source for analysis as described by
+// `config`, with the low latency profile of miniaudio, and prints the
+// buffering latency the device ended up with.
+int pulseaudio_init(const CaptureConfig *config);
 
 // Cleans up device context etc.
 void pulseaudio_deinit(void);
@@ -0,0 +1,201 @@
+#include "sample_ring.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// How many times a snapshot is retried if the producer overwrote the window
+// while it was being copied.
+#define SNAPSHOT_MAX_RETRIES 4
+
+int samplering_init(SampleRing *ring, size_t capacity, size_t channels) {
+    assert(channels > 0);
+
+    size_t power_of_two = 1;
+    while (power_of_two < capacity)
+        power_of_two <<= 1;
+
+    ring->data = calloc(power_of_two * channels, sizeof(float));
+    if (!ring->data)
+        return 1;
+
+    ring->capacity = power_of_two;
+    ring->channels = channels;
+    atomic_init(&ring->write_begin, 0);
+    atomic_init(&ring->write_end, 0);
+    atomic_init(&ring->write_time, 0);
+    atomic_init(&ring->end_sequence, 0);
+    return 0;
+}
+
+void samplering_free(SampleRing *ring) {
+    if (ring->data) {
+        free(ring->data);
+        ring->data = 0;
+    }
+    ring->capacity = 0;
+}
+
+// Stores the end of a finished write along with the capture `time` of its last
+// frame, see samplering_written_at().
+static inline void publish_end(SampleRing *ring, uint64_t end, uint64_t time) {
+    const uint32_t sequence =
+        atomic_load_explicit(&ring->end_sequence, memory_order_relaxed);
+    atomic_store_explicit(&ring->end_sequence, sequence + 1,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&ring->write_time, time, memory_order_relaxed);
+    atomic_store_explicit(&ring->write_end, end, memory_order_release);
+    atomic_store_explicit(&ring->end_sequence, sequence + 2,
+                          memory_order_release);
+}
+
+void samplering_write(SampleRing *ring, const float *frames, size_t count,
+                      size_t stride, uint64_t time) {
+    assert(ring->data);
+    assert(stride >= ring->channels);
+
+    uint64_t position =
+        atomic_load_explicit(&ring->write_end, memory_order_relaxed);
+    const size_t mask = ring->capacity - 1;
+
+    // Announce the region about to be overwritten before touching it, so that
+    // a concurrent snapshot can tell its copy might be torn.
+    atomic_store_explicit(&ring->write_begin, position + count,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    // Frames that would be overwritten within this same write are skipped
+    const size_t channels = ring->channels;
+    size_t skipped = 0;
+    if (count > ring->capacity)
+        skipped = count - ring->capacity;
+
+    if (stride == channels) {
+        // Frames are stored as is, so copy in at most two contiguous parts
+        size_t stored = count - skipped;
+        size_t start = (position + skipped) & mask;
+        size_t first_part = ring->capacity - start;
+        if (first_part > stored)
+            first_part = stored;
+        memcpy(ring->data + start * channels, frames + skipped * channels,
+               first_part * channels * sizeof(float));
+        memcpy(ring->data, frames + (skipped + first_part) * channels,
+               (stored - first_part) * channels * sizeof(float));
+    } else {
+        for (size_t i = skipped; i < count; i++)
+            for (size_t channel = 0; channel < channels; channel++)
+                ring->data[((position + i) & mask) * channels + channel] =
+                    frames[i * stride + channel];
+    }
+
+    publish_end(ring, position + count, time);
+}
+
+float *samplering_write_begin(SampleRing *ring, size_t *in_out_count) {
+    assert(ring->data);
+
+    uint64_t position =
+        atomic_load_explicit(&ring->write_end, memory_order_relaxed);
+    const size_t start = position & (ring->capacity - 1);
+    if (*in_out_count > ring->capacity - start)
+        *in_out_count = ring->capacity - start;
+
+    // Announced like in samplering_write()
+    atomic_store_explicit(&ring->write_begin, position + *in_out_count,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    return ring->data + start * ring->channels;
+}
+
+void samplering_write_commit(SampleRing *ring, size_t count, uint64_t time) {
+    uint64_t position =
+        atomic_load_explicit(&ring->write_end, memory_order_relaxed);
+    // Frames announced but not kept were not written either
+    atomic_store_explicit(&ring->write_begin, position + count,
+                          memory_order_relaxed);
+    if (count)
+        publish_end(ring, position + count, time);
+}
+
+static inline void copy_window(SampleRing *ring, float *out, uint64_t end,
+                               size_t count) {
+    const size_t mask = ring->capacity - 1;
+    const size_t channels = ring->channels;
+
+    // Zero-fill the part of the window from before any frames were written
+    size_t missing = 0;
+    if (end < count) {
+        missing = count - end;
+        memset(out, 0, missing * channels * sizeof(float));
+    }
+
+    size_t start = (end - (count - missing)) & mask;
+    size_t remaining = count - missing;
+    size_t first_part = ring->capacity - start;
+    if (first_part > remaining)
+        first_part = remaining;
+
+    memcpy(out + missing * channels, ring->data + start * channels,
+           first_part * channels * sizeof(float));
+    memcpy(out + (missing + first_part) * channels, ring->data,
+           (remaining - first_part) * channels * sizeof(float));
+}
+
+uint64_t samplering_written(SampleRing *ring) {
+    return atomic_load_explicit(&ring->write_end, memory_order_acquire);
+}
+
+uint64_t samplering_written_at(SampleRing *ring, uint64_t *out_time) {
+    // Only spins while the producer stores the end and time of a write
+    for (;;) {
+        const uint32_t sequence =
+            atomic_load_explicit(&ring->end_sequence, memory_order_acquire);
+        uint64_t end = samplering_written(ring);
+        *out_time = atomic_load_explicit(&ring->write_time,
+                                         memory_order_relaxed);
+        // Both must be read before the sequence is checked again
+        atomic_thread_fence(memory_order_acquire);
+        if (!(sequence & 1) &&
+            atomic_load_explicit(&ring->end_sequence, memory_order_relaxed) ==
+                sequence)
+            return end;
+    }
+}
+
+// Whether the producer has started overwriting any of the `count` frames
+// preceding `end`.
+static inline int is_overwritten(SampleRing *ring, uint64_t end,
+                                 size_t count) {
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t begin =
+        atomic_load_explicit(&ring->write_begin, memory_order_relaxed);
+    return begin > end && begin - end > ring->capacity - count;
+}
+
+int samplering_read(SampleRing *ring, float *out, uint64_t end, size_t count) {
+    assert(ring->data);
+    assert(count <= ring->capacity);
+    assert(end <= samplering_written(ring));
+
+    if (is_overwritten(ring, end, count))
+        return 1;
+    copy_window(ring, out, end, count);
+    return is_overwritten(ring, end, count);
+}
+
+uint64_t samplering_snapshot(SampleRing *ring, float *out, size_t count) {
+    assert(ring->data);
+    assert(count <= ring->capacity);
+
+    uint64_t end = 0;
+    for (int attempt = 0; attempt < SNAPSHOT_MAX_RETRIES; attempt++) {
+        end = samplering_written(ring);
+        // If the producer has since started overwriting the oldest part of
+        // the window, the copy is torn and has to be taken again.
+        if (!samplering_read(ring, out, end, count))
+            break;
+    }
+
+    return end;
+}
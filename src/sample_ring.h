@@ -0,0 +1,77 @@
+#ifndef _SAMPLE_RING
+#define _SAMPLE_RING
+
+/*
+Lock-free single-producer single-consumer ring buffer of audio frames.
+
+Frames of one or more channels are stored interleaved. The producer (an audio
+callback) only ever writes and never waits for the consumer; once the ring is
+full the oldest frames are overwritten. The consumer takes snapshots of the
+latest frames in chronological order and retries if the producer lapped it
+while copying, so it never sees a torn window.
+*/
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    float *data;
+    // Capacity in frames, always a power of two.
+    size_t capacity;
+    // Amount of samples in each frame.
+    size_t channels;
+    // Total amount of frames the producer has started writing.
+    _Atomic uint64_t write_begin;
+    // Total amount of frames the producer has finished writing.
+    _Atomic uint64_t write_end;
+    // Capture time of the last frame written, see samplering_written_at().
+    _Atomic uint64_t write_time;
+    // Odd while `write_end` and `write_time` are being updated together.
+    _Atomic uint32_t end_sequence;
+} SampleRing;
+
+// Allocates a ring that can hold at least `capacity` frames of `channels`
+// samples each. Returns 0 on success.
+int samplering_init(SampleRing *ring, size_t capacity, size_t channels);
+// Frees memory used by `ring`.
+void samplering_free(SampleRing *ring);
+
+// Producer side: writes `count` frames taken from `frames` into `ring`. The
+// frames in `frames` are `stride` samples apart, of which the first
+// `ring->channels` are stored. `time` is when the last of the frames was
+// captured, in any monotonic unit. Wait-free.
+void samplering_write(SampleRing *ring, const float *frames, size_t count,
+                      size_t stride, uint64_t time);
+
+// Producer side: starts a write of frames produced in place, e.g. read from a
+// file, instead of copied. Announces up to `*in_out_count` frames, fewer if
+// the ring wraps around first, writes the amount announced back into
+// `in_out_count` and returns where the frames go, `ring->channels` samples
+// each. Must be followed by samplering_write_commit().
+float *samplering_write_begin(SampleRing *ring, size_t *in_out_count);
+// Producer side: finishes a write started with samplering_write_begin(),
+// keeping the first `count` of the announced frames, which may be none.
+// `time` is when the last of them was captured, see samplering_write().
+void samplering_write_commit(SampleRing *ring, size_t count, uint64_t time);
+
+// Consumer side: total amount of frames written so far.
+uint64_t samplering_written(SampleRing *ring);
+// Consumer side: like samplering_written(), and writes the capture time of the
+// last written frame into `out_time`, consistent with the returned position.
+// Only waits for the producer while it stores the two, not while a write
+// started with samplering_write_begin() is in progress.
+uint64_t samplering_written_at(SampleRing *ring, uint64_t *out_time);
+
+// Consumer side: copies the `count` frames preceding the absolute position
+// `end` into `out` in chronological order, interleaved. Frames from before the
+// first write are zero. Returns 0 on success, or 1 if the window has already
+// been overwritten by the producer.
+int samplering_read(SampleRing *ring, float *out, uint64_t end, size_t count);
+
+// Consumer side: copies the latest `count` frames into `out` in chronological
+// order, interleaved. Frames that were never written are zero. Returns the
+// total amount of frames written at the end of the copied window.
+uint64_t samplering_snapshot(SampleRing *ring, float *out, size_t count);
+
+#endif
@@ -1,4 +1,7 @@
+#define _GNU_SOURCE
+
 #include "scenes.h"
+#include "profiler.h"
 #include <raylib.h>
 
 #define FIREWATCH_IMPLEMENTATION
@@ -6,14 +9,57 @@
 
 #include <assert.h>
 #include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 VEC_IMPLEMENT(Scene, SceneVector, scenevec)
 
 static SceneVector scenes = {0};
 static size_t current_scene = 0;
 
-static inline void ensure_init(void) {}
+// Scene being faded out, and how far the crossfade has got, 1.0 when done.
+static size_t previous_scene = 0;
+static float fade_progress = 1;
+static float crossfade_time = DEFAULT_CROSSFADE / 1000.0;
+
+// Render textures of the outgoing and incoming scene, the size of the screen.
+static RenderTexture2D fade_targets[2] = {0};
+// Texture of the crossfade that the scene being drawn draws into, if any.
+static RenderTexture2D *offscreen_target = 0;
+
+typedef struct {
+    // Path of the shared object file, set once when the scene is added.
+    char *filepath;
+    // Set when the file has changed, until the loader thread opens it.
+    int requested;
+    // Set while the loader thread opens the file.
+    int loading;
+    // Opened by the loader thread and waiting to replace the scene at the
+    // start of a frame, if it has a handle.
+    Scene loaded;
+} SceneReload;
+
+VEC_DECLARE(SceneReload, SceneReloadVector, scenereloadvec)
+VEC_IMPLEMENT(SceneReload, SceneReloadVector, scenereloadvec)
+
+// Reloads of each scene, shared with the loader thread and guarded by
+// `reload_lock`, which is never held while a file is being opened.
+static SceneReloadVector reloads = {0};
+static pthread_mutex_t reload_lock = PTHREAD_MUTEX_INITIALIZER;
+// Signaled when a reload is requested, and when one is done.
+static pthread_cond_t loader_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t load_done = PTHREAD_COND_INITIALIZER;
+static int loader_stopping = 0;
+static pthread_t loader_thread = 0;
+// Set when scenes are waiting to be swapped in.
+static _Atomic int reloads_ready = 0;
 
 static inline void *get_symbol(void *handle, const char *name) {
     void *symbol_func = dlsym(handle, name);
@@ -29,84 +75,363 @@ static inline void *get_symbol(void *handle, const char *name) {
     return symbol_func;
 }
 
+// Closes the shared object of `scene`, if any, and the copy it was opened
+// from.
+static void close_object(Scene *scene) {
+    if (!scene->dl_handle)
+        return;
+    dlclose(scene->dl_handle);
+    close(scene->dl_file);
+    scene->dl_handle = 0;
+}
+
 static inline void deinit_scene(Scene *scene) {
     if (scene->deinit)
         (*scene->deinit)();
-
-    if (scene->dl_handle) {
-        dlclose(scene->dl_handle);
-        scene->dl_handle = 0;
-    }
+    close_object(scene);
 }
 
-static inline void load_scene(const char *filepath, size_t scene_index) {
-    assert(scene_index < scenes.data_used);
+/*
+Opens a private copy of the shared object file at `filepath`, and returns the
+file of the copy in `out_file`. dlopen() returns the handle it already has for
+a name or file that is still open, so the new version would not be loaded while
+the old one runs.
 
-    Scene *scene = scenes.data + scene_index;
-    deinit_scene(scene);
+The copy is an anonymous file opened through /proc/self/fd, as /tmp may not
+allow executing what is mapped from it. It stays open as long as the object,
+so that no other copy gets the same path while the object is still open.
+*/
+static void *open_copy(const char *filepath, int *out_file) {
+    int source = open(filepath, O_RDONLY | O_CLOEXEC);
+    int copy = source < 0 ? -1 : memfd_create("muscini-scene", MFD_CLOEXEC);
+    int failed = copy < 0;
 
-    printf("%s\n", filepath);
-    void *handle = dlopen(filepath, RTLD_NOW);
-    if (!handle) {
-        fprintf(stderr, "WARNING: Error opening scene object file: %s\n",
-                dlerror());
-        return;
+    char buffer[65536];
+    ssize_t length = 0;
+    while (!failed && (length = read(source, buffer, sizeof(buffer))) > 0)
+        failed = write(copy, buffer, length) != length;
+    failed |= length < 0;
+    if (failed)
+        fprintf(stderr, "WARNING: Error copying scene object file: %s\n",
+                strerror(errno));
+
+    if (source >= 0)
+        close(source);
+    if (copy < 0)
+        return 0;
+
+    void *handle = 0;
+    if (!failed) {
+        char copy_path[32];
+        snprintf(copy_path, sizeof(copy_path), "/proc/self/fd/%d", copy);
+        handle = dlopen(copy_path, RTLD_NOW);
+        if (!handle)
+            fprintf(stderr,
+                    "WARNING: Error opening scene object file %s: %s\n",
+                    filepath, dlerror());
     }
+    if (!handle)
+        close(copy);
+    *out_file = copy;
+    return handle;
+}
+
+// Opens the shared object file at `filepath` and resolves the functions of
+// the scene into `out_scene`, without initializing it. Returns 0 on success.
+static int open_scene(const char *filepath, Scene *out_scene) {
+    printf("%s\n", filepath);
+    int file = -1;
+    void *handle = open_copy(filepath, &file);
+    if (!handle)
+        return 1;
     dlerror();
 
     // Get symbols from shared object
-    SceneUpdateFunction scene_update_function =
-        (SceneUpdateFunction)get_symbol(handle, "scene_update");
-    SceneInitFunction scene_init_function =
-        (SceneInitFunction)get_symbol(handle, "scene_init");
-    SceneDeinitFunction scene_deinit_function =
-        (SceneDeinitFunction)get_symbol(handle, "scene_deinit");
-
-    if (!scene_update_function || !scene_init_function ||
-        !scene_deinit_function) {
-        return;
+    Scene scene = {
+        .update = (SceneUpdateFunction)get_symbol(handle, "scene_update"),
+        .init = (SceneInitFunction)get_symbol(handle, "scene_init"),
+        .deinit = (SceneDeinitFunction)get_symbol(handle, "scene_deinit"),
+        .dl_handle = handle,
+        .dl_file = file,
+    };
+    if (!scene.update || !scene.init || !scene.deinit) {
+        close_object(&scene);
+        return 1;
     }
 
-    (*scene_init_function)();
+    // Optional
+    scene.save_state =
+        (SceneSaveStateFunction)dlsym(handle, "scene_save_state");
+    scene.restore_state =
+        (SceneRestoreStateFunction)dlsym(handle, "scene_restore_state");
+    dlerror();
 
-    *scene = (Scene){
-        .update = scene_update_function,
-        .init = scene_init_function,
-        .deinit = scene_deinit_function,
-        .dl_handle = handle,
-    };
+    *out_scene = scene;
+    return 0;
+}
+
+static void *load_loop(void *arg) {
+    profiler_set_thread_name("scene loader");
+
+    pthread_mutex_lock(&reload_lock);
+    while (!loader_stopping) {
+        size_t index = 0;
+        while (index < reloads.data_used && !reloads.data[index].requested)
+            index++;
+        if (index == reloads.data_used) {
+            pthread_cond_wait(&loader_wakeup, &reload_lock);
+            continue;
+        }
+
+        reloads.data[index].requested = 0;
+        reloads.data[index].loading = 1;
+        // Stays the same as long as the scene exists
+        const char *filepath = reloads.data[index].filepath;
+        pthread_mutex_unlock(&reload_lock);
+
+        Scene scene = {0};
+        int failed = open_scene(filepath, &scene);
+
+        pthread_mutex_lock(&reload_lock);
+        // Replaces a version that has not been swapped in yet
+        Scene replaced = reloads.data[index].loaded;
+        if (!failed)
+            reloads.data[index].loaded = scene;
+        reloads.data[index].loading = 0;
+        if (!failed)
+            atomic_store_explicit(&reloads_ready, 1, memory_order_release);
+        pthread_cond_broadcast(&load_done);
+
+        if (!failed && replaced.dl_handle) {
+            pthread_mutex_unlock(&reload_lock);
+            close_object(&replaced);
+            pthread_mutex_lock(&reload_lock);
+        }
+    }
+    pthread_mutex_unlock(&reload_lock);
+
+    (void)arg;
+    return 0;
+}
+
+// Called by firewatch on its own thread when the file of a scene has been
+// written, and once when the scene is added.
+static void request_reload(const char *filepath, uint64_t scene_index) {
+    pthread_mutex_lock(&reload_lock);
+    if (scene_index < reloads.data_used) {
+        reloads.data[scene_index].requested = 1;
+        pthread_cond_signal(&loader_wakeup);
+    }
+    pthread_mutex_unlock(&reload_lock);
+    (void)filepath;
+}
+
+// Replaces `scene` with `loaded`, carrying the state of the scene over if it
+// can be saved. If `loaded` fails to initialize, `scene` is initialized again
+// instead and keeps running.
+static void replace_scene(Scene *scene, Scene *loaded) {
+    static unsigned char state[SCENE_MAX_STATE_SIZE];
+    size_t state_size = 0;
+    if (scene->save_state)
+        state_size = (*scene->save_state)(state, sizeof(state));
+    if (scene->deinit)
+        (*scene->deinit)();
+
+    if (!(*loaded->init)()) {
+        close_object(scene);
+        *scene = *loaded;
+    } else {
+        fprintf(stderr, "WARNING: Scene failed to initialize%s\n",
+                scene->dl_handle ? ", keeping the previous version." : ".");
+        close_object(loaded);
+        if (scene->init)
+            (*scene->init)();
+    }
+
+    if (scene->restore_state && state_size)
+        (*scene->restore_state)(state, state_size);
+}
+
+// Swaps in the scenes opened by the loader thread since the previous frame.
+static void swap_reloaded_scenes(void) {
+    if (!atomic_exchange_explicit(&reloads_ready, 0, memory_order_acquire))
+        return;
+
+    for (size_t i = 0; i < scenes.data_used; i++) {
+        pthread_mutex_lock(&reload_lock);
+        Scene loaded = reloads.data[i].loaded;
+        reloads.data[i].loaded = (Scene){0};
+        pthread_mutex_unlock(&reload_lock);
+
+        if (loaded.dl_handle)
+            replace_scene(scenes.data + i, &loaded);
+    }
 }
 
 void scenes_init(void) {
     if (!scenes.data)
         scenes = scenevec_init();
+    if (!reloads.data)
+        reloads = scenereloadvec_init();
+    if (loader_thread)
+        return;
+
+    loader_stopping = 0;
+    if (pthread_create(&loader_thread, 0, &load_loop, 0)) {
+        perror("ERROR: could not create scene loader thread");
+        abort();
+    }
 }
 
 void scenes_deinit(void) {
+    pthread_mutex_lock(&reload_lock);
+    loader_stopping = 1;
+    pthread_cond_signal(&loader_wakeup);
+    pthread_mutex_unlock(&reload_lock);
+    if (loader_thread)
+        pthread_join(loader_thread, 0);
+    loader_thread = 0;
+
     for (size_t i = 0; i < scenes.data_used; i++)
         deinit_scene(scenes.data + i);
     scenevec_free(&scenes);
+    scenes = (SceneVector){0};
+
+    // firewatch may still request reloads
+    pthread_mutex_lock(&reload_lock);
+    for (size_t i = 0; i < reloads.data_used; i++) {
+        close_object(&reloads.data[i].loaded);
+        free(reloads.data[i].filepath);
+    }
+    scenereloadvec_free(&reloads);
+    reloads = (SceneReloadVector){0};
+    pthread_mutex_unlock(&reload_lock);
+    atomic_store(&reloads_ready, 0);
+
+    for (size_t i = 0; i < 2; i++)
+        if (fade_targets[i].id)
+            UnloadRenderTexture(fade_targets[i]);
+    memset(fade_targets, 0, sizeof(fade_targets));
+    current_scene = 0;
+    fade_progress = 1;
 }
 
 size_t scenes_add(const char *filepath) {
-    ensure_init();
-
     size_t scene_index = scenevec_append(&scenes, (Scene){0});
-    firewatch_new_file(filepath, scene_index, &load_scene, 0);
+    char *path = strdup(filepath);
+    if (!path)
+        abort();
+    pthread_mutex_lock(&reload_lock);
+    scenereloadvec_append(&reloads, (SceneReload){.filepath = path});
+    pthread_mutex_unlock(&reload_lock);
+
+    // Requests the first load as well
+    firewatch_new_file(filepath, scene_index, &request_reload, 1);
+
+    // Opened before the first frame, so that all scenes of a playlist are
+    // ready to be switched to
+    pthread_mutex_lock(&reload_lock);
+    while (reloads.data[scene_index].requested ||
+           reloads.data[scene_index].loading)
+        pthread_cond_wait(&load_done, &reload_lock);
+    pthread_mutex_unlock(&reload_lock);
     return scene_index;
 }
 
-void scenes_update_current(AudioMetrics *metrics) {
-    assert(current_scene < scenes.data_used);
-    firewatch_check();
+int scenes_loaded(size_t scene_index) {
+    return scene_index < scenes.data_used &&
+           scenes.data[scene_index].update != 0;
+}
+
+size_t scenes_count(void) { return scenes.data_used; }
+
+size_t scenes_current(void) { return current_scene; }
+
+void scenes_switch(size_t scene_index) {
+    if (scene_index >= scenes.data_used || scene_index == current_scene)
+        return;
+    // A crossfade that is still going on is cut short
+    previous_scene = current_scene;
+    current_scene = scene_index;
+    fade_progress = crossfade_time > 0 && fade_targets[0].id ? 0 : 1;
+}
+
+void scenes_set_crossfade(uint32_t milliseconds) {
+    crossfade_time = milliseconds / 1000.0;
+}
 
-    if (!scenes.data[current_scene].update) {
-        BeginDrawing();
+void scenes_end_texture_mode(void) {
+    EndTextureMode();
+    if (offscreen_target)
+        BeginTextureMode(*offscreen_target);
+}
+
+// Makes the render textures of crossfades match the size of the screen.
+static void prepare_fade_targets(void) {
+    const int width = GetScreenWidth();
+    const int height = GetScreenHeight();
+    if (fade_targets[0].id && fade_targets[0].texture.width == width &&
+        fade_targets[0].texture.height == height)
+        return;
+
+    for (size_t i = 0; i < 2; i++) {
+        if (fade_targets[i].id)
+            UnloadRenderTexture(fade_targets[i]);
+        fade_targets[i] = LoadRenderTexture(width, height);
+    }
+}
+
+static void draw_scene(size_t scene_index, AudioMetrics *metrics) {
+    if (!scenes.data[scene_index].update) {
         ClearBackground(BLACK);
         DrawText("error", 5, 2, 20, RED);
-        EndDrawing();
         return;
     }
+    (*scenes.data[scene_index].update)(metrics);
+}
+
+// Draws the scene at `scene_index` into `target` instead of the screen.
+static void draw_scene_offscreen(size_t scene_index, RenderTexture2D *target,
+                                 AudioMetrics *metrics) {
+    offscreen_target = target;
+    BeginTextureMode(*target);
+    draw_scene(scene_index, metrics);
+    EndTextureMode();
+    offscreen_target = 0;
+}
+
+static void draw_crossfade(AudioMetrics *metrics) {
+    fade_progress += GetFrameTime() / crossfade_time;
+    if (fade_progress > 1)
+        fade_progress = 1;
+
+    draw_scene_offscreen(previous_scene, &fade_targets[0], metrics);
+    draw_scene_offscreen(current_scene, &fade_targets[1], metrics);
+
+    // Render textures are upside down
+    const Texture2D texture = fade_targets[0].texture;
+    const Rectangle source = {0, 0, texture.width, -texture.height};
+    ClearBackground(BLACK);
+    DrawTextureRec(fade_targets[0].texture, source, (Vector2){0, 0}, WHITE);
+    DrawTextureRec(fade_targets[1].texture, source, (Vector2){0, 0},
+                   Fade(WHITE, fade_progress));
+}
+
+void scenes_update_current(AudioMetrics *metrics) {
+    assert(current_scene < scenes.data_used);
+    uint64_t begin = profiler_begin();
+    firewatch_check();
+    swap_reloaded_scenes();
+    profiler_end_stage(PROFILE_FIREWATCH, begin);
+
+    // Made ahead of switches, so that starting a crossfade allocates nothing
+    if (scenes.data_used > 1)
+        prepare_fade_targets();
 
-    (*scenes.data[current_scene].update)(metrics);
+    begin = profiler_begin();
+    if (fade_progress < 1)
+        draw_crossfade(metrics);
+    else
+        draw_scene(current_scene, metrics);
+    profiler_end_stage(PROFILE_SCENE, begin);
 }
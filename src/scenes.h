@@ -1,32 +1,96 @@
 #ifndef _SCENE_LOADING
 #define _SCENE_LOADING
 
+/*
+Scenes are shared objects with scene_init(), scene_update() and
+scene_deinit(), loaded again whenever their file changes.
+
+Loading is kept off the render thread: a loader thread opens a private copy of
+the changed file with dlopen() and resolves its functions, and the new version
+only replaces the old one at the start of the next frame, where it is
+initialized. If it fails to open or to initialize, the old version keeps
+running. Scenes that define the optional scene_save_state() and
+scene_restore_state() keep their state through reloads, so that animations do
+not start over.
+
+The scenes added with scenes_add() make up a playlist. All of them are loaded
+and initialized up front, so switching between them with scenes_switch() costs
+no more than drawing. Switches crossfade from the outgoing to the incoming
+scene: while fading, both are drawn every frame, each into a render texture
+made ahead of time, and the textures are blended on the screen.
+
+scene_update() draws the frame between BeginDrawing() and EndDrawing(), which
+the program calls around scenes_update_current(). Scenes that draw into render
+textures of their own end that with scenes_end_texture_mode() instead of
+EndTextureMode(), so that the rest of the frame goes to the texture of a
+crossfade rather than to the screen.
+*/
+
 #include "analyze.h"
 #include "vec.h"
 
+// Length of crossfades between scenes in milliseconds, and its limit.
+#define DEFAULT_CROSSFADE 1000
+#define MAX_CROSSFADE 10000
+
+// Most bytes of state a scene can keep through a reload.
+#define SCENE_MAX_STATE_SIZE 65536
+
 typedef void (*SceneUpdateFunction)(AudioMetrics *metrics);
+// Returns 0 on success.
 typedef int (*SceneInitFunction)(void);
 typedef void (*SceneDeinitFunction)(void);
+// Writes at most `size` bytes of state to `out_state` before the scene is
+// unloaded, and returns how many it wrote.
+typedef size_t (*SceneSaveStateFunction)(void *out_state, size_t size);
+// Gets the state saved by the previous version of the scene back after
+// scene_init(). Its layout may have changed with the new version, which
+// `size` helps to tell.
+typedef void (*SceneRestoreStateFunction)(const void *state, size_t size);
 
 typedef struct {
     SceneUpdateFunction update;
     SceneInitFunction init;
     SceneDeinitFunction deinit;
+    // 0 if the scene does not define them.
+    SceneSaveStateFunction save_state;
+    SceneRestoreStateFunction restore_state;
     void *dl_handle;
+    // Private copy of the file that `dl_handle` was opened from.
+    int dl_file;
 } Scene;
 
 VEC_DECLARE(Scene, SceneVector, scenevec)
 
-// Call this before any other functions in this unit.
+// Call this before any other functions in this unit. Starts the loader
+// thread.
 void scenes_init(void);
 // Deinitialize memory used by this unit.
 void scenes_deinit(void);
 
 // Calls the rendering / update function of the currently active and loaded
-// scene.
+// scene, between BeginDrawing() and EndDrawing().
 void scenes_update_current(AudioMetrics *metrics);
-// Adds and loads a new scene shared object file at `filepath` to the pool of
-// scenes. Returns index / handle of the newly added scene, or 0 on failure.
+
+// Adds a new scene shared object file at `filepath` to the pool of scenes and
+// waits for the loader thread to open it. Returns index / handle of the newly
+// added scene.
 size_t scenes_add(const char *filepath);
+// Returns 1 if the scene at `scene_index` has been loaded successfully. Scenes
+// are initialized by the first scenes_update_current() after scenes_add().
+int scenes_loaded(size_t scene_index);
+
+// Amount of scenes added.
+size_t scenes_count(void);
+// Index of the scene being shown or faded in.
+size_t scenes_current(void);
+// Starts a crossfade from the current scene to the scene at `scene_index`.
+// Does nothing if there is no such scene or it is the current one.
+void scenes_switch(size_t scene_index);
+// Sets the length of crossfades to `milliseconds`, 0 for switching at once.
+void scenes_set_crossfade(uint32_t milliseconds);
+// Ends drawing into a render texture of the scene being drawn, and goes back
+// to drawing the frame, see above.
+void scenes_end_texture_mode(void);
 
 #endif
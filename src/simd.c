@@ -0,0 +1,20 @@
+#include "simd.h"
+
+SimdLevel simd_detect(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    // Also needed before any other check in constructors, which may run
+    // before the one of libgcc
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+#endif
+    return SIMD_SSE;
+}
+
+const char *simd_name(SimdLevel level) {
+    static const char *names[] = {
+        [SIMD_SSE] = "sse",
+        [SIMD_AVX2] = "avx2",
+    };
+    return level < SIMD_LEVELS ? names[level] : "unknown";
+}
@@ -0,0 +1,24 @@
+#ifndef _SIMD
+#define _SIMD
+
+/*
+Instruction sets the vectorized kernels of dsp.c and fft_pow2.c are built for.
+
+Each set of kernels lives in its own translation unit, compiled for its
+instruction set whatever the rest of the program targets, and the modules
+point at the best set the CPU supports when the program starts.
+*/
+
+typedef enum {
+    // SSE, or plain scalar code on other architectures
+    SIMD_SSE = 0,
+    SIMD_AVX2 = 1,
+    SIMD_LEVELS
+} SimdLevel;
+
+// The best level the CPU supports.
+SimdLevel simd_detect(void);
+// Name of `level`, such as "avx2".
+const char *simd_name(SimdLevel level);
+
+#endif
@@ -0,0 +1,34 @@
+#include "triple_buffer.h"
+
+#define TRIPLEBUFFER_FRESH 4
+#define TRIPLEBUFFER_INDEX 3
+
+void triplebuffer_init(TripleBuffer *buffer, void *a, void *b, void *c) {
+    buffer->buffers[0] = a;
+    buffer->buffers[1] = b;
+    buffer->buffers[2] = c;
+    buffer->back = 0;
+    buffer->front = 1;
+    atomic_init(&buffer->middle, 2);
+}
+
+void *triplebuffer_back(TripleBuffer *buffer) {
+    return buffer->buffers[buffer->back];
+}
+
+void triplebuffer_publish(TripleBuffer *buffer) {
+    int previous = atomic_exchange_explicit(
+        &buffer->middle, buffer->back | TRIPLEBUFFER_FRESH,
+        memory_order_acq_rel);
+    buffer->back = previous & TRIPLEBUFFER_INDEX;
+}
+
+void *triplebuffer_front(TripleBuffer *buffer) {
+    if (atomic_load_explicit(&buffer->middle, memory_order_relaxed) &
+        TRIPLEBUFFER_FRESH) {
+        int previous = atomic_exchange_explicit(&buffer->middle, buffer->front,
+                                                memory_order_acq_rel);
+        buffer->front = previous & TRIPLEBUFFER_INDEX;
+    }
+    return buffer->buffers[buffer->front];
+}
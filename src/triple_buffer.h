@@ -0,0 +1,42 @@
+#ifndef _TRIPLE_BUFFER
+#define _TRIPLE_BUFFER
+
+/*
+Lock-free triple buffer for handing the latest result from one producer thread
+to one consumer thread.
+
+The producer always has a back buffer to write into and the consumer always has
+a front buffer to read from, so neither side ever blocks. Publishing swaps the
+back buffer with the middle one, and the consumer picks up the middle buffer
+only if something new was published since its last look. Intermediate results
+the consumer did not get to are skipped.
+*/
+
+#include <stdatomic.h>
+
+typedef struct {
+    void *buffers[3];
+    // Index of the buffer owned by the producer.
+    int back;
+    // Index of the buffer owned by the consumer.
+    int front;
+    // Index of the buffer in between, along with TRIPLEBUFFER_FRESH if it
+    // holds a result the consumer has not picked up yet.
+    _Atomic int middle;
+} TripleBuffer;
+
+// Sets up `buffer` to rotate between the three buffers `a`, `b` and `c`, which
+// need to stay alive as long as `buffer` is used.
+void triplebuffer_init(TripleBuffer *buffer, void *a, void *b, void *c);
+
+// Producer side: the buffer to write the next result into.
+void *triplebuffer_back(TripleBuffer *buffer);
+// Producer side: makes the back buffer available to the consumer and gets a
+// new back buffer.
+void triplebuffer_publish(TripleBuffer *buffer);
+
+// Consumer side: returns the most recently published buffer, which stays valid
+// and untouched by the producer until the next call.
+void *triplebuffer_front(TripleBuffer *buffer);
+
+#endif
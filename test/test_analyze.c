@@ -0,0 +1,165 @@
+#include "analyze.h"
+#include "unity.h"
+#include <math.h>
+
+#define SAMPLE_RATE 48000
+
+static AudioMetrics metrics = {0};
+
+void setUp(void) {
+    AnalyzeConfig config = {
+        .window = HANNING,
+        .input_size = 2048,
+        .hop_size = 512,
+        .channels = 2,
+        .log_band_count = DEFAULT_LOG_BAND_COUNT,
+        .mel_band_count = DEFAULT_MEL_BAND_COUNT,
+    };
+    analyze_init(&config);
+    analyze_set_sample_rate(SAMPLE_RATE);
+}
+
+void tearDown(void) {
+    analyze_deinit();
+}
+
+// Feeds a sine of `left` Hz on the left channel and `right` Hz on the right.
+static void feed_sines(float left, float right, size_t frame_count) {
+    static size_t phase = 0;
+    float frames[256 * 2];
+    while (frame_count > 0) {
+        size_t count = frame_count < 256 ? frame_count : 256;
+        for (size_t i = 0; i < count; i++, phase++) {
+            frames[i * 2] = sinf(2 * M_PI * left * phase / SAMPLE_RATE);
+            frames[i * 2 + 1] = sinf(2 * M_PI * right * phase / SAMPLE_RATE);
+        }
+        analyze_feed_frames(frames, count, 2);
+        frame_count -= count;
+    }
+}
+
+static void feed_sine(float frequency, size_t frame_count) {
+    feed_sines(frequency, frequency, frame_count);
+}
+
+static size_t loudest_bin(const float *frequencies) {
+    size_t loudest = 0;
+    for (size_t i = 0; i < metrics.frequency_count; i++)
+        if (frequencies[loudest] < frequencies[i])
+            loudest = i;
+    return loudest;
+}
+
+void test_every_complete_hop_is_processed(void) {
+    feed_sine(440, 512 * 3 + 100);
+    TEST_ASSERT_EQUAL(3, analyze_get_metrics(&metrics));
+    TEST_ASSERT_EQUAL(0, analyze_get_metrics(&metrics));
+
+    feed_sine(440, 412);
+    TEST_ASSERT_EQUAL(1, analyze_get_metrics(&metrics));
+}
+
+void test_delay_holds_back_hops(void) {
+    analyze_deinit();
+    AnalyzeConfig config = {
+        .window = HANNING,
+        .input_size = 1024,
+        .hop_size = 512,
+        .channels = 2,
+        .log_band_count = DEFAULT_LOG_BAND_COUNT,
+        .mel_band_count = DEFAULT_MEL_BAND_COUNT,
+        .delay = 100,
+    };
+    analyze_init(&config);
+    analyze_set_sample_rate(SAMPLE_RATE);
+
+    // 100 ms is 4800 frames, leaving 1024 frames to analyze
+    feed_sine(440, 4800 + 1024);
+    uint64_t fed = eventqueue_now();
+    TEST_ASSERT_EQUAL(2, analyze_get_metrics(&metrics));
+
+    // The window ending at frame 1024 was captured 100 ms before the newest
+    TEST_ASSERT_TRUE(metrics.capture_time <= fed);
+    TEST_ASSERT_UINT64_WITHIN(1000000, fed - 100000000, metrics.capture_time);
+    TEST_ASSERT_TRUE(metrics.analysis_time >= fed);
+}
+
+void test_bin_mapping(void) {
+    analyze_get_metrics(&metrics);
+    TEST_ASSERT_EQUAL(1024, metrics.frequency_count);
+    TEST_ASSERT_EQUAL_FLOAT(SAMPLE_RATE / 2048.0, metrics.frequency_resolution);
+    TEST_ASSERT_EQUAL(40, analyze_frequency_bin(&metrics, 937.5));
+    TEST_ASSERT_EQUAL(1023, analyze_frequency_bin(&metrics, 30000));
+    TEST_ASSERT_EQUAL_FLOAT(937.5, analyze_bin_frequency(&metrics, 40));
+}
+
+void test_sine_peaks_at_its_bin(void) {
+    feed_sine(1000, 4096);
+    analyze_get_metrics(&metrics);
+
+    TEST_ASSERT_EQUAL(analyze_frequency_bin(&metrics, 1000),
+                      loudest_bin(metrics.frequencies));
+}
+
+void test_channels_are_analyzed_separately(void) {
+    feed_sines(500, 3000, 4096);
+    analyze_get_metrics(&metrics);
+
+    TEST_ASSERT_EQUAL(2, metrics.channel_count);
+    TEST_ASSERT_EQUAL(analyze_frequency_bin(&metrics, 500),
+                      loudest_bin(metrics.channel_frequencies[0]));
+    TEST_ASSERT_EQUAL(analyze_frequency_bin(&metrics, 3000),
+                      loudest_bin(metrics.channel_frequencies[1]));
+
+    // Both tones are in the mix and in the side signal
+    size_t bin_500 = analyze_frequency_bin(&metrics, 500);
+    size_t bin_3000 = analyze_frequency_bin(&metrics, 3000);
+    TEST_ASSERT_FLOAT_WITHIN(0.05, metrics.frequencies[bin_500],
+                             metrics.frequencies[bin_3000]);
+    TEST_ASSERT_FLOAT_WITHIN(0.05, metrics.frequencies[bin_500],
+                             metrics.side_frequencies[bin_500]);
+}
+
+void test_identical_channels_have_no_side(void) {
+    feed_sine(1000, 4096);
+    analyze_get_metrics(&metrics);
+
+    size_t bin = analyze_frequency_bin(&metrics, 1000);
+    TEST_ASSERT_TRUE(metrics.frequencies[bin] > 0.5);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 0, metrics.side_frequencies[bin]);
+}
+
+void test_events_are_drained_in_time_order(void) {
+    uint64_t now = eventqueue_now();
+    Event late = {.time = now - 5000000, .type = EVENT_NOTE_OFF, .note = 1};
+    Event early = {.time = now - 20000000, .type = EVENT_NOTE_ON, .note = 2};
+    analyze_push_event(&late);
+    analyze_push_event(&early);
+
+    analyze_drain_events(&metrics);
+    TEST_ASSERT_EQUAL(2, metrics.event_count);
+    TEST_ASSERT_EQUAL(2, metrics.events[0].note);
+    TEST_ASSERT_FLOAT_WITHIN(0.005, -0.020, metrics.events[0].offset);
+    TEST_ASSERT_EQUAL(1, metrics.events[0].beat);
+    TEST_ASSERT_EQUAL(1, metrics.events[1].note);
+    TEST_ASSERT_EQUAL(0, metrics.events[1].beat);
+    TEST_ASSERT_EQUAL_FLOAT(1.0, metrics.beat);
+
+    analyze_drain_events(&metrics);
+    TEST_ASSERT_EQUAL(0, metrics.event_count);
+    TEST_ASSERT_EQUAL_FLOAT(0.0, metrics.beat);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_every_complete_hop_is_processed);
+    RUN_TEST(test_delay_holds_back_hops);
+    RUN_TEST(test_bin_mapping);
+    RUN_TEST(test_sine_peaks_at_its_bin);
+    RUN_TEST(test_channels_are_analyzed_separately);
+    RUN_TEST(test_identical_channels_have_no_side);
+    RUN_TEST(test_events_are_drained_in_time_order);
+
+    return UNITY_END();
+}
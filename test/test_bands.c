@@ -0,0 +1,89 @@
+#include "bands.h"
+#include "unity.h"
+#include <math.h>
+
+#define FREQUENCY_COUNT 1024
+#define RESOLUTION (48000.0 / 2048)
+
+static BandLayout layout = {0};
+
+void setUp(void) {}
+
+void tearDown(void) {
+    bands_free(&layout);
+}
+
+static void assert_weights_sum_to_one(void) {
+    for (uint32_t band = 0; band < layout.count; band++) {
+        float sum = 0;
+        for (uint32_t i = layout.band_starts[band];
+             i < layout.band_starts[band + 1]; i++) {
+            TEST_ASSERT_TRUE(layout.bins[i] < FREQUENCY_COUNT);
+            sum += layout.weights[i];
+        }
+        TEST_ASSERT_FLOAT_WITHIN(1e-5, 1, sum);
+    }
+}
+
+void test_log_bands_are_log_spaced(void) {
+    TEST_ASSERT_EQUAL(0, bands_create_log(&layout, 20, 30, 16000,
+                                          FREQUENCY_COUNT, RESOLUTION));
+    TEST_ASSERT_EQUAL(20, layout.count);
+    assert_weights_sum_to_one();
+
+    float ratio = layout.centers[1] / layout.centers[0];
+    for (uint32_t band = 2; band < layout.count; band++)
+        TEST_ASSERT_FLOAT_WITHIN(
+            1e-3, ratio, layout.centers[band] / layout.centers[band - 1]);
+}
+
+void test_mel_bands_cover_range(void) {
+    TEST_ASSERT_EQUAL(0, bands_create_mel(&layout, 40, 30, 16000,
+                                          FREQUENCY_COUNT, RESOLUTION));
+    assert_weights_sum_to_one();
+    TEST_ASSERT_TRUE(layout.centers[0] > 30);
+    TEST_ASSERT_TRUE(layout.centers[39] < 16000);
+}
+
+void test_third_octave_bands(void) {
+    TEST_ASSERT_EQUAL(
+        0, bands_create_third_octave(&layout, FREQUENCY_COUNT, RESOLUTION));
+    assert_weights_sum_to_one();
+    // 25 Hz to 20 kHz
+    TEST_ASSERT_EQUAL(30, layout.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 24.8, layout.centers[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1, 1000, layout.centers[16]);
+}
+
+void test_band_of_flat_spectrum_is_flat(void) {
+    bands_create_log(&layout, 16, 30, 16000, FREQUENCY_COUNT, RESOLUTION);
+    float spectrum[FREQUENCY_COUNT];
+    for (size_t i = 0; i < FREQUENCY_COUNT; i++)
+        spectrum[i] = 0.5;
+
+    float out[16];
+    bands_apply(&layout, spectrum, out);
+    for (size_t i = 0; i < 16; i++)
+        TEST_ASSERT_FLOAT_WITHIN(1e-5, 0.5, out[i]);
+}
+
+void test_prefix_sums(void) {
+    float values[] = {1, 2, 3, 4};
+    float sums[5];
+    bands_prefix_sums(values, 4, sums);
+    TEST_ASSERT_EQUAL_FLOAT(0, sums[0]);
+    TEST_ASSERT_EQUAL_FLOAT(10, sums[4]);
+    TEST_ASSERT_EQUAL_FLOAT(5, sums[3] - sums[1]);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_log_bands_are_log_spaced);
+    RUN_TEST(test_mel_bands_cover_range);
+    RUN_TEST(test_third_octave_bands);
+    RUN_TEST(test_band_of_flat_spectrum_is_flat);
+    RUN_TEST(test_prefix_sums);
+
+    return UNITY_END();
+}
@@ -0,0 +1,74 @@
+#include "cqt.h"
+#include "unity.h"
+
+#include <math.h>
+
+#define SAMPLE_RATE 48000
+// C1, so that bin 12 * k + n is the note n semitones above C of octave k + 1.
+#define MIN_FREQUENCY 32.703196f
+#define BIN_COUNT 96
+
+static ConstantQ cqt;
+static float bins[2 * BIN_COUNT];
+static float samples[SAMPLE_RATE];
+
+void setUp(void) {}
+
+void tearDown(void) { cqt_free(&cqt); }
+
+// Feeds a second of a sine wave of `amplitude` at `frequency` Hz.
+static void feed_sine(float frequency, float amplitude) {
+    for (size_t i = 0; i < SAMPLE_RATE; i++)
+        samples[i] = amplitude * sinf(2 * M_PI * frequency * i / SAMPLE_RATE);
+    cqt_feed(&cqt, samples, SAMPLE_RATE, 1);
+}
+
+static size_t loudest_bin(void) {
+    size_t loudest = 0;
+    for (size_t i = 0; i < cqt.bin_count; i++)
+        if (bins[i] > bins[loudest])
+            loudest = i;
+    return loudest;
+}
+
+void test_sine_peaks_at_its_note(void) {
+    TEST_ASSERT_EQUAL(0, cqt_init(&cqt, 12, BIN_COUNT, MIN_FREQUENCY,
+                                  SAMPLE_RATE));
+    TEST_ASSERT_EQUAL(BIN_COUNT, cqt.bin_count);
+
+    // A4 is 45 semitones above C1
+    feed_sine(440, 0.8);
+    float peak = cqt_process(&cqt, bins);
+    TEST_ASSERT_EQUAL(45, loudest_bin());
+    TEST_ASSERT_EQUAL_FLOAT(peak, bins[45]);
+    TEST_ASSERT_FLOAT_WITHIN(0.04, 0.4, peak);
+}
+
+void test_bass_notes_are_resolved(void) {
+    TEST_ASSERT_EQUAL(0, cqt_init(&cqt, 24, 2 * BIN_COUNT, MIN_FREQUENCY,
+                                  SAMPLE_RATE));
+
+    // A1, 9 semitones above C1, is well apart from its neighbour semitones,
+    // which a 1024 sample FFT puts into the same bin
+    feed_sine(55, 1);
+    cqt_process(&cqt, bins);
+    TEST_ASSERT_EQUAL(18, loudest_bin());
+    TEST_ASSERT_LESS_THAN_FLOAT(0.25 * bins[18], bins[16]);
+    TEST_ASSERT_LESS_THAN_FLOAT(0.25 * bins[18], bins[20]);
+}
+
+void test_bins_above_nyquist_are_left_out(void) {
+    TEST_ASSERT_EQUAL(0, cqt_init(&cqt, 12, BIN_COUNT, MIN_FREQUENCY, 8000));
+    TEST_ASSERT_LESS_THAN(BIN_COUNT, cqt.bin_count);
+    float top = cqt_bin_frequency(MIN_FREQUENCY, 12, cqt.bin_count - 1);
+    TEST_ASSERT_LESS_THAN_FLOAT(4000, top);
+    TEST_ASSERT_GREATER_THAN_FLOAT(3000, top);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_sine_peaks_at_its_note);
+    RUN_TEST(test_bass_notes_are_resolved);
+    RUN_TEST(test_bins_above_nyquist_are_left_out);
+    return UNITY_END();
+}
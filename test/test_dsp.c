@@ -0,0 +1,134 @@
+#include "dsp.h"
+#include "unity.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_window_table_matches_hanning(void) {
+    float *window = dsp_window_create(HANNING, 64);
+    TEST_ASSERT_NOT_NULL(window);
+    for (size_t i = 0; i < 64; i++)
+        TEST_ASSERT_FLOAT_WITHIN(
+            1e-6, 0.5 * (1.0 - cos(2.0 * M_PI * i / 63.0)), window[i]);
+    free(window);
+}
+
+void test_no_window_is_all_ones(void) {
+    float *window = dsp_window_create(NO_WINDOW, 16);
+    for (size_t i = 0; i < 16; i++)
+        TEST_ASSERT_EQUAL_FLOAT(1, window[i]);
+    free(window);
+}
+
+void test_window_from_name(void) {
+    FFTWindow type = NO_WINDOW;
+    TEST_ASSERT_EQUAL(0, dsp_window_from_name("blackman", &type));
+    TEST_ASSERT_EQUAL(BLACKMAN, type);
+    TEST_ASSERT_NOT_EQUAL(0, dsp_window_from_name("rectangle", &type));
+}
+
+void test_apply_window_in_place(void) {
+    float samples[19];
+    float window[19];
+    for (size_t i = 0; i < 19; i++) {
+        samples[i] = i;
+        window[i] = 0.5;
+    }
+    dsp_apply_window(samples, samples, window, 19);
+    for (size_t i = 0; i < 19; i++)
+        TEST_ASSERT_EQUAL_FLOAT(i * 0.5, samples[i]);
+}
+
+void test_deinterleave_window(void) {
+    // Frame count that is not a multiple of the vector width
+    float frames[21 * 2];
+    float window[21];
+    for (size_t i = 0; i < 21; i++) {
+        frames[i * 2] = i;
+        frames[i * 2 + 1] = -(float)i;
+        window[i] = i % 2 ? 2 : 1;
+    }
+
+    float left[21];
+    float right[21];
+    float *outputs[] = {left, right};
+    dsp_deinterleave_window(outputs, frames, 2, window, 21);
+    for (size_t i = 0; i < 21; i++) {
+        TEST_ASSERT_EQUAL_FLOAT(i * window[i], left[i]);
+        TEST_ASSERT_EQUAL_FLOAT(-(float)i * window[i], right[i]);
+    }
+}
+
+void test_sum_and_difference(void) {
+    float a[13];
+    float b[13];
+    float difference[13];
+    for (size_t i = 0; i < 13; i++) {
+        a[i] = i;
+        b[i] = 1;
+    }
+    dsp_half_difference(difference, a, b, 13);
+    dsp_add(a, b, 13);
+    for (size_t i = 0; i < 13; i++) {
+        TEST_ASSERT_EQUAL_FLOAT(i + 1.0, a[i]);
+        TEST_ASSERT_EQUAL_FLOAT((i - 1.0) / 2, difference[i]);
+    }
+}
+
+void test_magnitudes_match_scalar_reference(void) {
+    // Odd bin count exercises both the vectorized and the scalar tail
+    float spectrum[2 * 37];
+    for (size_t i = 0; i < 2 * 37; i++)
+        spectrum[i] = sinf(i * 1.7) * (i % 5) - 1.0;
+
+    float magnitudes[37];
+    float maximum = dsp_magnitudes(magnitudes, spectrum, 37);
+
+    float expected_maximum = fabsf(spectrum[0]);
+    TEST_ASSERT_EQUAL_FLOAT(fabsf(spectrum[0]), magnitudes[0]);
+    for (size_t k = 1; k < 37; k++) {
+        float expected = hypotf(spectrum[2 * k - 1], spectrum[2 * k]);
+        TEST_ASSERT_FLOAT_WITHIN(1e-5, expected, magnitudes[k]);
+        if (expected_maximum < expected)
+            expected_maximum = expected;
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1e-5, expected_maximum, maximum);
+}
+
+void test_scale(void) {
+    float values[11];
+    for (size_t i = 0; i < 11; i++)
+        values[i] = i;
+    dsp_scale(values, 11, 2);
+    for (size_t i = 0; i < 11; i++)
+        TEST_ASSERT_EQUAL_FLOAT(i * 2, values[i]);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_window_table_matches_hanning);
+    RUN_TEST(test_no_window_is_all_ones);
+    RUN_TEST(test_window_from_name);
+    // Every set of kernels the CPU supports, as the program only runs the best
+    for (SimdLevel level = 0; level < SIMD_LEVELS; level++) {
+        if (level > simd_detect()) {
+            printf("Skipping the %s kernels, the CPU lacks them\n",
+                   simd_name(level));
+            continue;
+        }
+        printf("With the %s kernels\n", simd_name(level));
+        dsp_use_kernels(level);
+        RUN_TEST(test_apply_window_in_place);
+        RUN_TEST(test_deinterleave_window);
+        RUN_TEST(test_sum_and_difference);
+        RUN_TEST(test_magnitudes_match_scalar_reference);
+        RUN_TEST(test_scale);
+    }
+
+    return UNITY_END();
+}
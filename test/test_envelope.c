@@ -0,0 +1,78 @@
+#include "envelope.h"
+#include "unity.h"
+
+#include <math.h>
+
+#define BAND_COUNT 2
+#define ATTACK 0.01
+#define RELEASE 0.25
+
+static EnvelopeBank bank;
+static float envelopes[BAND_COUNT];
+
+void setUp(void) {}
+
+void tearDown(void) { envelope_free(&bank); }
+
+// Follows `levels` for `seconds` in hops of `hop_duration` seconds.
+static void follow(const float *levels, float seconds, float hop_duration) {
+    for (float time = 0; time < seconds - hop_duration / 2;
+         time += hop_duration)
+        envelope_process(&bank, levels, envelopes);
+}
+
+void test_rise_and_fall_take_attack_and_release_times(void) {
+    const float hop_duration = 0.001;
+    TEST_ASSERT_EQUAL(
+        0, envelope_init(&bank, BAND_COUNT, ATTACK, RELEASE, hop_duration));
+
+    const float loud[BAND_COUNT] = {1, 1};
+    follow(loud, ATTACK, hop_duration);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 1 - expf(-1), envelopes[0]);
+    follow(loud, 1, hop_duration);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 1, envelopes[0]);
+
+    // Quiet enough for the peak to stay
+    const float quiet[BAND_COUNT] = {0, 0};
+    follow(quiet, RELEASE, hop_duration);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, expf(-1), envelopes[0]);
+}
+
+void test_envelopes_do_not_depend_on_hop_duration(void) {
+    const float levels[BAND_COUNT] = {0.5, 0.5};
+    const float quiet[BAND_COUNT] = {0.1, 0.1};
+    float results[2];
+    const float hop_durations[2] = {512 / 48000.0, 2048 / 48000.0};
+    for (int i = 0; i < 2; i++) {
+        envelope_init(&bank, BAND_COUNT, ATTACK, RELEASE, hop_durations[i]);
+        follow(levels, 1, hop_durations[i]);
+        follow(quiet, 256 / 375.0, hop_durations[i]);
+        results[i] = envelopes[0];
+        envelope_free(&bank);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.01, results[0], results[1]);
+    TEST_ASSERT_GREATER_THAN_FLOAT(0.2, results[0]);
+    TEST_ASSERT_LESS_THAN_FLOAT(0.5, results[0]);
+}
+
+void test_quiet_band_is_leveled_to_its_peak(void) {
+    TEST_ASSERT_EQUAL(0, envelope_init(&bank, BAND_COUNT, ATTACK, RELEASE,
+                                       0.01));
+    const float levels[BAND_COUNT] = {1, 0.05};
+    follow(levels, 1, 0.01);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 1, envelopes[0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 1, envelopes[1]);
+
+    // Near silence is not amplified
+    const float silence[BAND_COUNT] = {0, ENVELOPE_AGC_FLOOR / 10};
+    follow(silence, 100, 0.01);
+    TEST_ASSERT_LESS_THAN_FLOAT(0.2, envelopes[1]);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rise_and_fall_take_attack_and_release_times);
+    RUN_TEST(test_envelopes_do_not_depend_on_hop_duration);
+    RUN_TEST(test_quiet_band_is_leveled_to_its_peak);
+    return UNITY_END();
+}
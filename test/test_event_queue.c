@@ -0,0 +1,98 @@
+#include "event_queue.h"
+#include "unity.h"
+#include <pthread.h>
+
+#define PRODUCER_COUNT 4
+#define EVENTS_PER_PRODUCER 20000
+
+static EventQueue queue = {0};
+
+void setUp(void) {
+    TEST_ASSERT_EQUAL(0, eventqueue_init(&queue, 8));
+}
+
+void tearDown(void) {
+    eventqueue_free(&queue);
+}
+
+static Event note_event(uint64_t frame, uint8_t note) {
+    return (Event){.frame = frame, .type = EVENT_NOTE_ON, .note = note};
+}
+
+void test_events_come_out_in_order(void) {
+    Event event;
+    TEST_ASSERT_EQUAL(1, eventqueue_pop(&queue, &event));
+
+    for (uint64_t round = 0; round < 3; round++) {
+        for (uint64_t i = 0; i < 5; i++) {
+            event = note_event(round * 5 + i, 60);
+            TEST_ASSERT_EQUAL(0, eventqueue_push(&queue, &event));
+        }
+        for (uint64_t i = 0; i < 5; i++) {
+            TEST_ASSERT_EQUAL(0, eventqueue_pop(&queue, &event));
+            TEST_ASSERT_EQUAL(round * 5 + i, event.frame);
+            TEST_ASSERT_EQUAL(60, event.note);
+        }
+        TEST_ASSERT_EQUAL(1, eventqueue_pop(&queue, &event));
+    }
+}
+
+void test_push_to_full_queue_drops(void) {
+    Event event = note_event(0, 0);
+    for (size_t i = 0; i < 8; i++)
+        TEST_ASSERT_EQUAL(0, eventqueue_push(&queue, &event));
+    TEST_ASSERT_EQUAL(1, eventqueue_push(&queue, &event));
+    TEST_ASSERT_EQUAL(1, atomic_load(&queue.dropped));
+
+    // Popping makes room again
+    TEST_ASSERT_EQUAL(0, eventqueue_pop(&queue, &event));
+    TEST_ASSERT_EQUAL(0, eventqueue_push(&queue, &event));
+}
+
+static void *produce(void *arg) {
+    uint8_t producer = (uintptr_t)arg;
+    for (uint64_t i = 0; i < EVENTS_PER_PRODUCER; i++) {
+        Event event = note_event(i, producer);
+        // Retry until the consumer makes room
+        while (eventqueue_push(&queue, &event))
+            ;
+    }
+    return 0;
+}
+
+void test_concurrent_producers_lose_nothing(void) {
+    eventqueue_free(&queue);
+    eventqueue_init(&queue, 64);
+
+    pthread_t producers[PRODUCER_COUNT];
+    for (uintptr_t i = 0; i < PRODUCER_COUNT; i++)
+        pthread_create(&producers[i], 0, produce, (void *)i);
+
+    // Events of each producer arrive in the order they were pushed
+    uint64_t next_frame[PRODUCER_COUNT] = {0};
+    size_t received = 0;
+    while (received < PRODUCER_COUNT * EVENTS_PER_PRODUCER) {
+        Event event;
+        if (eventqueue_pop(&queue, &event))
+            continue;
+        TEST_ASSERT_TRUE(event.note < PRODUCER_COUNT);
+        TEST_ASSERT_EQUAL(next_frame[event.note], event.frame);
+        next_frame[event.note]++;
+        received++;
+    }
+
+    for (size_t i = 0; i < PRODUCER_COUNT; i++)
+        pthread_join(producers[i], 0);
+    Event event;
+    TEST_ASSERT_EQUAL(1, eventqueue_pop(&queue, &event));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_events_come_out_in_order);
+    RUN_TEST(test_push_to_full_queue_drops);
+    RUN_TEST(test_concurrent_producers_lose_nothing);
+
+    return UNITY_END();
+}
@@ -0,0 +1,125 @@
+#include "fft.h"
+#include "unity.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SIZE 8192
+
+static float signal[MAX_SIZE];
+static float expected[MAX_SIZE];
+static float actual[MAX_SIZE];
+// Second signal of the pairs
+static float other_expected[MAX_SIZE];
+static float other_actual[MAX_SIZE];
+
+void setUp(void) {
+    srand(7);
+    for (size_t i = 0; i < MAX_SIZE; i++)
+        signal[i] = sinf(0.05f * i) + 0.3f * sinf(1.7f * i) +
+                    (rand() / (float)RAND_MAX - 0.5f);
+}
+
+void tearDown(void) {}
+
+// Largest difference to the FFTPACK output, relative to its largest value.
+static float relative_error(size_t n) {
+    float peak = 0, error = 0;
+    for (size_t i = 0; i < n; i++) {
+        peak = fmaxf(peak, fabsf(expected[i]));
+        error = fmaxf(error, fabsf(actual[i] - expected[i]));
+    }
+    return error / peak;
+}
+
+void test_power_of_two_sizes_match_fftpack(void) {
+    for (size_t n = FFT_POW2_MIN_SIZE; n <= MAX_SIZE; n *= 2) {
+        for (int scaled = 0; scaled < 2; scaled++) {
+            FFTTransformer *transformer = create_fft_transformer(
+                n, scaled ? FFT_SCALED_OUTPUT : FFT_UNSCALED_OUTPUT);
+            TEST_ASSERT_NOT_NULL(transformer->pow2);
+
+            memcpy(expected, signal, n * sizeof(float));
+            __fft_real_forward(n, expected, transformer->wsave,
+                               transformer->ifac);
+            if (scaled)
+                for (size_t i = 0; i < n; i++)
+                    expected[i] /= n;
+
+            memcpy(actual, signal, n * sizeof(float));
+            fft_forward(transformer, actual);
+            TEST_ASSERT_LESS_THAN_FLOAT(1e-5f, relative_error(n));
+            free_fft_transformer(transformer);
+        }
+    }
+}
+
+void test_pairs_match_fftpack_per_signal(void) {
+    for (size_t n = FFT_POW2_MIN_SIZE; n <= MAX_SIZE; n *= 2) {
+        FFTTransformer *transformer =
+            create_fft_transformer(n, FFT_UNSCALED_OUTPUT);
+        FFTPow2Plan *plan = fft_pow2_create(2 * n);
+        TEST_ASSERT_NOT_NULL(plan);
+
+        // The second signal is the first backwards, so they differ
+        for (size_t i = 0; i < n; i++) {
+            expected[i] = actual[i] = signal[i];
+            other_expected[i] = other_actual[i] = signal[n - 1 - i];
+        }
+        __fft_real_forward(n, expected, transformer->wsave, transformer->ifac);
+        __fft_real_forward(n, other_expected, transformer->wsave,
+                           transformer->ifac);
+
+        fft_pow2_forward_pair(plan, actual, other_actual, 1);
+        TEST_ASSERT_LESS_THAN_FLOAT(1e-5f, relative_error(n));
+        memcpy(expected, other_expected, n * sizeof(float));
+        memcpy(actual, other_actual, n * sizeof(float));
+        TEST_ASSERT_LESS_THAN_FLOAT(1e-5f, relative_error(n));
+
+        fft_pow2_free(plan);
+        free_fft_transformer(transformer);
+    }
+}
+
+void test_backward_transform_restores_signal(void) {
+    const size_t n = 2048;
+    FFTTransformer *transformer = create_fft_transformer(n, FFT_SCALED_OUTPUT);
+    memcpy(actual, signal, n * sizeof(float));
+    fft_forward(transformer, actual);
+    fft_backward(transformer, actual);
+    for (size_t i = 0; i < n; i++)
+        TEST_ASSERT_FLOAT_WITHIN(1e-4f, signal[i], actual[i] / n);
+    free_fft_transformer(transformer);
+}
+
+void test_other_sizes_use_fftpack(void) {
+    FFTTransformer *transformer =
+        create_fft_transformer(1000, FFT_SCALED_OUTPUT);
+    TEST_ASSERT_NULL(transformer->pow2);
+    free_fft_transformer(transformer);
+    transformer = create_fft_transformer(8, FFT_SCALED_OUTPUT);
+    TEST_ASSERT_NULL(transformer->pow2);
+    free_fft_transformer(transformer);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    // Every set of kernels the CPU supports, as the program only runs the best
+    for (SimdLevel level = 0; level < SIMD_LEVELS; level++) {
+        if (level > simd_detect()) {
+            printf("Skipping the %s kernels, the CPU lacks them\n",
+                   simd_name(level));
+            continue;
+        }
+        printf("With the %s kernels\n", simd_name(level));
+        fft_pow2_use_kernels(level);
+        RUN_TEST(test_power_of_two_sizes_match_fftpack);
+        RUN_TEST(test_pairs_match_fftpack_per_signal);
+        RUN_TEST(test_backward_transform_restores_signal);
+    }
+    fft_pow2_use_kernels(simd_detect());
+    RUN_TEST(test_other_sizes_use_fftpack);
+    return UNITY_END();
+}
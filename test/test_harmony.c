@@ -0,0 +1,72 @@
+#include "harmony.h"
+#include "unity.h"
+
+#include <math.h>
+#include <string.h>
+
+#define FREQUENCY_COUNT 2048
+#define RESOLUTION (48000.0 / 4096)
+#define HOP_DURATION (2048 / 48000.0)
+
+static HarmonyEstimator estimator;
+static Harmony harmony;
+static float spectrum[FREQUENCY_COUNT];
+
+void setUp(void) {
+    TEST_ASSERT_EQUAL(0, harmony_init(&estimator, FREQUENCY_COUNT, RESOLUTION,
+                                      HOP_DURATION));
+    memset(&harmony, 0, sizeof(harmony));
+}
+
+void tearDown(void) { harmony_free(&estimator); }
+
+// Sets a spectrum of the pitch classes in `notes` in three octaves, and
+// processes it for `seconds`.
+static void play(const int *notes, size_t note_count, float seconds) {
+    memset(spectrum, 0, sizeof(spectrum));
+    for (size_t i = 0; i < note_count; i++)
+        for (int octave = 3; octave <= 5; octave++) {
+            int midi = 12 * (octave + 1) + notes[i];
+            float frequency = 440 * exp2f((midi - 69) / 12.0f);
+            spectrum[(size_t)(frequency / RESOLUTION + 0.5)] = 1;
+        }
+    for (float time = 0; time < seconds; time += HOP_DURATION)
+        harmony_process(&estimator, spectrum, &harmony);
+}
+
+void test_chord_is_recognized(void) {
+    const int a_minor[] = {9, 0, 4};
+    play(a_minor, 3, 1);
+    TEST_ASSERT_EQUAL_STRING("Am", harmony_name(harmony.chord));
+    TEST_ASSERT_GREATER_THAN_FLOAT(0.8, harmony.chord_confidence);
+    TEST_ASSERT_EQUAL_FLOAT(1, harmony.chroma[9]);
+    TEST_ASSERT_LESS_THAN_FLOAT(0.2, harmony.chroma[10]);
+
+    const int d_major[] = {2, 6, 9};
+    play(d_major, 3, 1);
+    TEST_ASSERT_EQUAL_STRING("D", harmony_name(harmony.chord));
+}
+
+void test_key_follows_progression(void) {
+    const int chords[][3] = {{0, 4, 7}, {5, 9, 0}, {7, 11, 2}, {0, 4, 7}};
+    for (int repeat = 0; repeat < 4; repeat++)
+        for (size_t i = 0; i < 4; i++)
+            play(chords[i], 3, 2);
+    TEST_ASSERT_EQUAL_STRING("C", harmony_name(harmony.key));
+    TEST_ASSERT_GREATER_THAN_FLOAT(0.5, harmony.key_confidence);
+}
+
+void test_silence_is_unknown(void) {
+    play(0, 0, 1);
+    TEST_ASSERT_EQUAL_FLOAT(0, harmony.chord_confidence);
+    TEST_ASSERT_EQUAL_FLOAT(0, harmony.key_confidence);
+    TEST_ASSERT_EQUAL_FLOAT(0, harmony.chroma[0]);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_chord_is_recognized);
+    RUN_TEST(test_key_follows_progression);
+    RUN_TEST(test_silence_is_unknown);
+    return UNITY_END();
+}
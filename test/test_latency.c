@@ -0,0 +1,75 @@
+#include "latency.h"
+#include "unity.h"
+
+#define MILLISECOND 1000000
+
+static LatencyStats stats;
+
+void setUp(void) {
+    stats = (LatencyStats){0};
+}
+
+void tearDown(void) {}
+
+void test_stages_are_measured_from_timestamps(void) {
+    latency_record(&stats, 10 * MILLISECOND, 25 * MILLISECOND,
+                   40 * MILLISECOND);
+    TEST_ASSERT_EQUAL(1, stats.count);
+    TEST_ASSERT_EQUAL_FLOAT(15, latency_percentile(&stats, LATENCY_ANALYSIS,
+                                                   50));
+    TEST_ASSERT_EQUAL_FLOAT(15, latency_percentile(&stats, LATENCY_PRESENT,
+                                                   50));
+    TEST_ASSERT_EQUAL_FLOAT(30, latency_percentile(&stats, LATENCY_TOTAL, 50));
+}
+
+void test_result_is_recorded_once(void) {
+    latency_record(&stats, 10 * MILLISECOND, 20 * MILLISECOND,
+                   30 * MILLISECOND);
+    latency_record(&stats, 10 * MILLISECOND, 20 * MILLISECOND,
+                   46 * MILLISECOND);
+    latency_record(&stats, 0, 0, 50 * MILLISECOND);
+    TEST_ASSERT_EQUAL(1, stats.count);
+}
+
+void test_percentiles(void) {
+    TEST_ASSERT_EQUAL_FLOAT(0, latency_percentile(&stats, LATENCY_TOTAL, 50));
+
+    // Total latencies of 1 to 100 ms, recorded out of order
+    for (uint64_t i = 0; i < 100; i++) {
+        uint64_t latency = (i * 37) % 100 + 1;
+        uint64_t capture = (i + 1) * 1000 * MILLISECOND;
+        latency_record(&stats, capture, capture,
+                       capture + latency * MILLISECOND);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(1, latency_percentile(&stats, LATENCY_TOTAL, 0));
+    TEST_ASSERT_FLOAT_WITHIN(1, 50, latency_percentile(&stats, LATENCY_TOTAL,
+                                                       50));
+    TEST_ASSERT_FLOAT_WITHIN(1, 95, latency_percentile(&stats, LATENCY_TOTAL,
+                                                       95));
+    TEST_ASSERT_EQUAL_FLOAT(100,
+                            latency_percentile(&stats, LATENCY_TOTAL, 100));
+}
+
+void test_history_keeps_latest_results(void) {
+    for (uint64_t i = 1; i <= LATENCY_HISTORY + 10; i++) {
+        // Only the last results are slow
+        uint64_t latency = i > LATENCY_HISTORY ? 100 : 1;
+        latency_record(&stats, i * MILLISECOND, i * MILLISECOND,
+                       (i + latency) * MILLISECOND);
+    }
+    TEST_ASSERT_EQUAL(LATENCY_HISTORY, stats.count);
+    TEST_ASSERT_EQUAL_FLOAT(100,
+                            latency_percentile(&stats, LATENCY_TOTAL, 100));
+    TEST_ASSERT_EQUAL_FLOAT(1, latency_percentile(&stats, LATENCY_TOTAL, 50));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_stages_are_measured_from_timestamps);
+    RUN_TEST(test_result_is_recorded_once);
+    RUN_TEST(test_percentiles);
+    RUN_TEST(test_history_keeps_latest_results);
+
+    return UNITY_END();
+}
@@ -0,0 +1,81 @@
+#include "loudness.h"
+#include "unity.h"
+
+#include <math.h>
+#include <string.h>
+
+#define SAMPLE_RATE 48000
+
+static LoudnessMeter meter;
+static Loudness levels;
+static float frames[SAMPLE_RATE * 2];
+
+void setUp(void) {
+    TEST_ASSERT_EQUAL(0, loudness_init(&meter, 2, SAMPLE_RATE));
+}
+
+void tearDown(void) {}
+
+// Feeds `seconds` of a stereo sine wave of `amplitude` at `frequency` Hz
+// starting at `phase`, in blocks of 240 frames like an audio callback.
+static void feed_sine(float frequency, float amplitude, float phase,
+                      float seconds) {
+    for (size_t i = 0; i < SAMPLE_RATE; i++) {
+        float value =
+            amplitude * sinf(2 * M_PI * frequency * i / SAMPLE_RATE + phase);
+        frames[2 * i] = frames[2 * i + 1] = value;
+    }
+    size_t frame_count = seconds * SAMPLE_RATE;
+    for (size_t fed = 0; fed < frame_count; fed += 240)
+        loudness_feed(&meter, frames + 2 * (fed % SAMPLE_RATE), 240, 2);
+}
+
+void test_k_weighting_matches_standard_at_48_khz(void) {
+    // Coefficients given in ITU-R BS.1770-4
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 1.53512485958697, meter.shelf[0].b0);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, -2.69169618940638, meter.shelf[0].b1);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 1.19839281085285, meter.shelf[0].b2);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, -1.69065929318241, meter.shelf[0].a1);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.73248077421585, meter.shelf[0].a2);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, -1.99004745483398, meter.highpass[0].a1);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.99007225036621, meter.highpass[0].a2);
+}
+
+void test_full_scale_sine_reads_reference_levels(void) {
+    TEST_ASSERT_EQUAL(1, loudness_read(&meter, 0, &levels));
+
+    // A full scale 997 Hz sine in each of two channels is 3 dB above one
+    feed_sine(997, 1, 0, 4);
+    TEST_ASSERT_EQUAL(0, loudness_read(&meter, 4 * SAMPLE_RATE, &levels));
+    TEST_ASSERT_FLOAT_WITHIN(0.1, 0, levels.momentary);
+    TEST_ASSERT_FLOAT_WITHIN(0.1, 0, levels.short_term);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, M_SQRT1_2, levels.rms);
+    TEST_ASSERT_FLOAT_WITHIN(0.02, 1, levels.true_peak);
+}
+
+void test_true_peak_is_found_between_samples(void) {
+    // Every sample of this sine is at ±0.707 of its peak
+    feed_sine(SAMPLE_RATE / 4.0, 0.5, M_PI / 4, 1);
+    loudness_read(&meter, SAMPLE_RATE, &levels);
+    TEST_ASSERT_FLOAT_WITHIN(0.03, 0.5, levels.true_peak);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 0.5 * M_SQRT1_2, levels.rms);
+}
+
+void test_levels_of_older_frames_are_kept(void) {
+    feed_sine(1000, 0, 0, 1);
+    feed_sine(1000, 0.1, 0, 1);
+    loudness_read(&meter, SAMPLE_RATE / 2, &levels);
+    TEST_ASSERT_EQUAL_FLOAT(LOUDNESS_FLOOR, levels.momentary);
+    TEST_ASSERT_EQUAL_FLOAT(0, levels.rms);
+    loudness_read(&meter, 2 * SAMPLE_RATE, &levels);
+    TEST_ASSERT_FLOAT_WITHIN(0.2, -20, levels.momentary);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_k_weighting_matches_standard_at_48_khz);
+    RUN_TEST(test_full_scale_sine_reads_reference_levels);
+    RUN_TEST(test_true_peak_is_found_between_samples);
+    RUN_TEST(test_levels_of_older_frames_are_kept);
+    return UNITY_END();
+}
@@ -0,0 +1,160 @@
+#include "metrics_shm.h"
+#include "unity.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define NAME "test"
+#define PUBLICATIONS 20000
+
+static MetricsShm publisher;
+static MetricsShm reader;
+static AudioMetrics published;
+static AudioMetrics metrics;
+static _Atomic int publishing;
+
+void setUp(void) {
+    memset(&published, 0, sizeof(published));
+    memset(&metrics, 0, sizeof(metrics));
+}
+
+void tearDown(void) {
+    metricsshm_close(&reader);
+    metricsshm_close(&publisher);
+}
+
+static void publish_event(uint8_t note, float beat) {
+    published.event_count = 1;
+    published.events[0] = (FrameEvent){.type = EVENT_NOTE_ON, .note = note};
+    published.beat = beat;
+    published.frequencies[0] = note;
+    metricsshm_publish(&publisher, &published);
+}
+
+void test_newest_metrics_come_with_all_unread_events(void) {
+    TEST_ASSERT_EQUAL(0, metricsshm_create(&publisher, NAME));
+    TEST_ASSERT_EQUAL(0, metricsshm_open(&reader, NAME));
+
+    publish_event(1, 1);
+    publish_event(2, 0);
+    publish_event(3, 0);
+    TEST_ASSERT_EQUAL(3, metricsshm_read(&reader, &metrics));
+    TEST_ASSERT_EQUAL_FLOAT(3, metrics.frequencies[0]);
+    TEST_ASSERT_EQUAL_FLOAT(1, metrics.beat);
+    TEST_ASSERT_EQUAL(3, metrics.event_count);
+    for (uint32_t i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(i + 1, metrics.events[i].note);
+        // Published just now
+        TEST_ASSERT_FLOAT_WITHIN(0.1, 0, metrics.events[i].offset);
+    }
+
+    // Nothing new keeps the metrics, but not the events
+    TEST_ASSERT_EQUAL(0, metricsshm_read(&reader, &metrics));
+    TEST_ASSERT_EQUAL_FLOAT(3, metrics.frequencies[0]);
+    TEST_ASSERT_EQUAL(0, metrics.event_count);
+    TEST_ASSERT_EQUAL_FLOAT(0, metrics.beat);
+}
+
+void test_reader_waits_for_publisher_and_follows_restarts(void) {
+    TEST_ASSERT_NOT_EQUAL(0, metricsshm_open(&reader, "a/b"));
+    TEST_ASSERT_EQUAL(0, metricsshm_open(&reader, NAME));
+    TEST_ASSERT_EQUAL(0, metricsshm_read(&reader, &metrics));
+
+    TEST_ASSERT_EQUAL(0, metricsshm_create(&publisher, NAME));
+    publish_event(1, 0);
+    reader.next_open = 0;
+    TEST_ASSERT_EQUAL(1, metricsshm_read(&reader, &metrics));
+    TEST_ASSERT_EQUAL_FLOAT(1, metrics.frequencies[0]);
+
+    metricsshm_close(&publisher);
+    TEST_ASSERT_EQUAL(0, metricsshm_create(&publisher, NAME));
+    publish_event(2, 0);
+    // Only looked for once METRICS_SHM_REOPEN_INTERVAL has passed
+    reader.next_open = 0;
+    TEST_ASSERT_EQUAL(1, metricsshm_read(&reader, &metrics));
+    TEST_ASSERT_EQUAL_FLOAT(2, metrics.frequencies[0]);
+}
+
+void test_slot_being_written_is_not_read(void) {
+    TEST_ASSERT_EQUAL(0, metricsshm_create(&publisher, NAME));
+    TEST_ASSERT_EQUAL(0, metricsshm_open(&reader, NAME));
+    publish_event(1, 1);
+
+    // As if the publisher was in the middle of writing it
+    atomic_fetch_add(&publisher.region->slots[0].sequence, 1);
+    TEST_ASSERT_EQUAL(0, metricsshm_read(&reader, &metrics));
+    TEST_ASSERT_EQUAL(0, metrics.event_count);
+    TEST_ASSERT_EQUAL_FLOAT(0, metrics.beat);
+
+    atomic_fetch_add(&publisher.region->slots[0].sequence, 1);
+    TEST_ASSERT_EQUAL(1, metricsshm_read(&reader, &metrics));
+    TEST_ASSERT_EQUAL(1, metrics.event_count);
+    TEST_ASSERT_EQUAL_FLOAT(1, metrics.beat);
+}
+
+void test_failed_reads_leave_metrics_as_they_are(void) {
+    TEST_ASSERT_EQUAL(0, metricsshm_create(&publisher, NAME));
+    TEST_ASSERT_EQUAL(0, metricsshm_open(&reader, NAME));
+    publish_event(1, 1);
+
+    // As if the publisher had moved on to another publication in the slot
+    // while it was being copied
+    publisher.region->slots[0].publication = METRICS_SHM_SLOTS;
+    TEST_ASSERT_EQUAL(0, metricsshm_read(&reader, &metrics));
+    TEST_ASSERT_EQUAL_FLOAT(0, metrics.frequencies[0]);
+    TEST_ASSERT_EQUAL(0, metrics.event_count);
+
+    publisher.region->slots[0].publication = 0;
+    TEST_ASSERT_EQUAL(1, metricsshm_read(&reader, &metrics));
+    TEST_ASSERT_EQUAL_FLOAT(1, metrics.frequencies[0]);
+}
+
+static void *publish_loop(void *arg) {
+    static AudioMetrics sent;
+    for (uint32_t i = 1; i <= PUBLICATIONS; i++) {
+        sent.frequencies[0] = i;
+        sent.frequencies[MAX_FREQUENCY_COUNT - 1] = i;
+        sent.capture_time = i;
+        metricsshm_publish(&publisher, &sent);
+    }
+    atomic_store(&publishing, 0);
+    (void)arg;
+    return 0;
+}
+
+void test_reads_during_publishing_are_never_torn(void) {
+    TEST_ASSERT_EQUAL(0, metricsshm_create(&publisher, NAME));
+    TEST_ASSERT_EQUAL(0, metricsshm_open(&reader, NAME));
+
+    atomic_store(&publishing, 1);
+    pthread_t thread;
+    TEST_ASSERT_EQUAL(0, pthread_create(&thread, 0, publish_loop, 0));
+    uint64_t newest = 0;
+    uint32_t reads = 0;
+    while (atomic_load(&publishing)) {
+        if (!metricsshm_read(&reader, &metrics))
+            continue;
+        reads++;
+        TEST_ASSERT_GREATER_OR_EQUAL(newest, metrics.capture_time);
+        newest = metrics.capture_time;
+        TEST_ASSERT_EQUAL_FLOAT(newest, metrics.frequencies[0]);
+        TEST_ASSERT_EQUAL_FLOAT(newest,
+                                metrics.frequencies[MAX_FREQUENCY_COUNT - 1]);
+    }
+    pthread_join(thread, 0);
+    TEST_ASSERT_GREATER_THAN(0, reads);
+
+    metricsshm_read(&reader, &metrics);
+    TEST_ASSERT_EQUAL(PUBLICATIONS, metrics.capture_time);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_newest_metrics_come_with_all_unread_events);
+    RUN_TEST(test_reader_waits_for_publisher_and_follows_restarts);
+    RUN_TEST(test_slot_being_written_is_not_read);
+    RUN_TEST(test_failed_reads_leave_metrics_as_they_are);
+    RUN_TEST(test_reads_during_publishing_are_never_torn);
+    return UNITY_END();
+}
@@ -0,0 +1,223 @@
+#include "feature_file.h"
+#include "miniaudio.h"
+#include "offline.h"
+#include "unity.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 48000
+#define FRAME_COUNT (SAMPLE_RATE * 3)
+#define AUDIO_PATH "/tmp/muscini_test_offline.wav"
+#define SERIAL_PATH "/tmp/muscini_test_offline_serial.feat"
+#define PARALLEL_PATH "/tmp/muscini_test_offline_parallel.feat"
+
+static const AnalyzeConfig config = {
+    .window = HANNING,
+    .input_size = 1024,
+    .hop_size = 512,
+    .channels = 2,
+    .log_band_count = DEFAULT_LOG_BAND_COUNT,
+    .mel_band_count = DEFAULT_MEL_BAND_COUNT,
+    .cqt_bins_per_octave = 12,
+};
+
+// Writes a stereo file of a 1 kHz tone with a short 60 Hz burst every half
+// second on the left channel.
+static void write_audio_file(void) {
+    static float frames[FRAME_COUNT * 2];
+    for (size_t i = 0; i < FRAME_COUNT; i++) {
+        float t = (float)(i % (SAMPLE_RATE / 2)) / SAMPLE_RATE;
+        float burst = t < 0.1 ? sinf(2 * M_PI * 60 * t) * (1 - t / 0.1) : 0;
+        float tone = 0.2 * sinf(2 * M_PI * 1000.0 * i / SAMPLE_RATE);
+        frames[i * 2] = tone + 0.7 * burst;
+        frames[i * 2 + 1] = tone;
+    }
+
+    ma_encoder encoder;
+    ma_encoder_config encoder_config = ma_encoder_config_init(
+        ma_encoding_format_wav, ma_format_f32, 2, SAMPLE_RATE);
+    TEST_ASSERT_EQUAL(MA_SUCCESS, ma_encoder_init_file(
+                                      AUDIO_PATH, &encoder_config, &encoder));
+    ma_encoder_write_pcm_frames(&encoder, frames, FRAME_COUNT, 0);
+    ma_encoder_uninit(&encoder);
+}
+
+void setUp(void) {
+    write_audio_file();
+}
+
+void tearDown(void) {
+    unlink(AUDIO_PATH);
+    unlink(SERIAL_PATH);
+    unlink(PARALLEL_PATH);
+}
+
+void test_file_describes_analysis(void) {
+    TEST_ASSERT_EQUAL(0, offline_analyze(AUDIO_PATH, SERIAL_PATH, &config, 2));
+
+    FeatureFile file = {0};
+    TEST_ASSERT_EQUAL(0, featurefile_open(&file, SERIAL_PATH));
+    const FeatureHeader *header = file.header;
+    TEST_ASSERT_EQUAL(SAMPLE_RATE, header->sample_rate);
+    TEST_ASSERT_EQUAL(2, header->channels);
+    TEST_ASSERT_EQUAL(512, header->frequency_count);
+    TEST_ASSERT_EQUAL(FRAME_COUNT, header->frame_count);
+    TEST_ASSERT_EQUAL(FRAME_COUNT / 512, header->record_count);
+    TEST_ASSERT_EQUAL(0, header->record_size % FEATURES_ALIGNMENT);
+    TEST_ASSERT_EQUAL(0, (uintptr_t)featurefile_record(&file, 1) %
+                             FEATURES_ALIGNMENT);
+
+    // The tone is the loudest part of the spectrum between bursts
+    static AudioMetrics metrics;
+    uint64_t index = (SAMPLE_RATE / 4) / 512;
+    featurefile_read_metrics(&file, index, &metrics);
+    size_t loudest = 0;
+    for (size_t i = 0; i < metrics.frequency_count; i++)
+        if (metrics.frequencies[loudest] < metrics.frequencies[i])
+            loudest = i;
+    TEST_ASSERT_EQUAL(analyze_frequency_bin(&metrics, 1000), loudest);
+    TEST_ASSERT_TRUE(metrics.frequencies[loudest] <= 1.0);
+
+    // Every burst after the first is a kick onset
+    size_t beats = 0;
+    for (uint64_t i = 0; i < header->record_count; i++) {
+        featurefile_read_metrics(&file, i, &metrics);
+        beats += metrics.beat > 0;
+    }
+    TEST_ASSERT_INT_WITHIN(1, 5, beats);
+
+    featurefile_close(&file);
+}
+
+void test_harmony_loudness_and_constant_q_are_stored(void) {
+    TEST_ASSERT_EQUAL(0, offline_analyze(AUDIO_PATH, SERIAL_PATH, &config, 2));
+
+    FeatureFile file = {0};
+    TEST_ASSERT_EQUAL(0, featurefile_open(&file, SERIAL_PATH));
+    TEST_ASSERT_EQUAL(12, file.header->cqt_bins_per_octave);
+    TEST_ASSERT_GREATER_THAN(0, file.header->cqt_bin_count);
+
+    // Late in the file, between bursts, so that everything has settled
+    static AudioMetrics metrics;
+    uint64_t index = (FRAME_COUNT - SAMPLE_RATE / 4) / 512;
+    featurefile_read_metrics(&file, index, &metrics);
+    TEST_ASSERT_EQUAL(file.header->cqt_bin_count, metrics.cqt_bin_count);
+    size_t loudest = 0;
+    for (size_t i = 0; i < metrics.cqt_bin_count; i++)
+        if (metrics.cqt_bins[loudest] < metrics.cqt_bins[i])
+            loudest = i;
+    // 1 kHz is closest to B5
+    TEST_ASSERT_FLOAT_WITHIN(30, 1000,
+                             analyze_cqt_frequency(&metrics, loudest));
+    TEST_ASSERT_EQUAL_FLOAT(1, metrics.harmony.chroma[11]);
+    TEST_ASSERT_TRUE(metrics.harmony.chord_confidence > 0);
+
+    // The tone is at 0.2 of full scale, and the last burst adds up to 0.7
+    TEST_ASSERT_FLOAT_WITHIN(0.35, 0.55, metrics.loudness.true_peak);
+    TEST_ASSERT_TRUE(metrics.loudness.momentary > LOUDNESS_FLOOR);
+    TEST_ASSERT_TRUE(metrics.loudness.short_term < 0);
+    TEST_ASSERT_TRUE(metrics.loudness.rms > 0.1);
+    TEST_ASSERT_TRUE(metrics.level_envelope > 0);
+
+    featurefile_close(&file);
+}
+
+void test_result_does_not_depend_on_threads(void) {
+    TEST_ASSERT_EQUAL(0, offline_analyze(AUDIO_PATH, SERIAL_PATH, &config, 1));
+    TEST_ASSERT_EQUAL(0,
+                      offline_analyze(AUDIO_PATH, PARALLEL_PATH, &config, 5));
+
+    FeatureFile serial = {0}, parallel = {0};
+    TEST_ASSERT_EQUAL(0, featurefile_open(&serial, SERIAL_PATH));
+    TEST_ASSERT_EQUAL(0, featurefile_open(&parallel, PARALLEL_PATH));
+    TEST_ASSERT_EQUAL(serial.size, parallel.size);
+    TEST_ASSERT_EQUAL(0, memcmp(serial.header, parallel.header, serial.size));
+    featurefile_close(&serial);
+    featurefile_close(&parallel);
+}
+
+void test_frames_map_to_records(void) {
+    TEST_ASSERT_EQUAL(0, offline_analyze(AUDIO_PATH, SERIAL_PATH, &config, 1));
+
+    FeatureFile file = {0};
+    TEST_ASSERT_EQUAL(0, featurefile_open(&file, SERIAL_PATH));
+    uint64_t index = 0;
+    TEST_ASSERT_EQUAL(1, featurefile_record_at(&file, 511, &index));
+    TEST_ASSERT_EQUAL(0, featurefile_record_at(&file, 512, &index));
+    TEST_ASSERT_EQUAL(0, index);
+    TEST_ASSERT_EQUAL(0, featurefile_record_at(&file, 512 * 10 + 100, &index));
+    TEST_ASSERT_EQUAL(9, index);
+    TEST_ASSERT_EQUAL(0, featurefile_record_at(&file, FRAME_COUNT * 2, &index));
+    TEST_ASSERT_EQUAL(file.header->record_count - 1, index);
+    featurefile_close(&file);
+}
+
+void test_invalid_files_are_rejected(void) {
+    FeatureFile file = {0};
+    TEST_ASSERT_EQUAL(1, featurefile_open(&file, AUDIO_PATH));
+    TEST_ASSERT_EQUAL(1, featurefile_open(&file, "/nonexistent.feat"));
+    TEST_ASSERT_EQUAL(1, offline_analyze("/nonexistent.wav", SERIAL_PATH,
+                                         &config, 1));
+}
+
+// Opens SERIAL_PATH with `header` written over its header.
+static int open_with_header(const FeatureHeader *header) {
+    FILE *stream = fopen(SERIAL_PATH, "r+b");
+    TEST_ASSERT_NOT_NULL(stream);
+    TEST_ASSERT_EQUAL(1, fwrite(header, sizeof(*header), 1, stream));
+    fclose(stream);
+
+    FeatureFile file = {0};
+    int result = featurefile_open(&file, SERIAL_PATH);
+    featurefile_close(&file);
+    return result;
+}
+
+void test_headers_pointing_outside_the_file_are_rejected(void) {
+    TEST_ASSERT_EQUAL(0, offline_analyze(AUDIO_PATH, SERIAL_PATH, &config, 1));
+    FeatureFile file = {0};
+    TEST_ASSERT_EQUAL(0, featurefile_open(&file, SERIAL_PATH));
+    const FeatureHeader valid = *file.header;
+    featurefile_close(&file);
+
+    FeatureHeader header = valid;
+    header.onsets_offset = valid.record_size / sizeof(float);
+    TEST_ASSERT_EQUAL(1, open_with_header(&header));
+    header = valid;
+    header.third_octave_bands_offset = UINT32_MAX;
+    TEST_ASSERT_EQUAL(1, open_with_header(&header));
+    header = valid;
+    header.hop_size = 0;
+    TEST_ASSERT_EQUAL(1, open_with_header(&header));
+    header = valid;
+    header.sample_rate = 0;
+    TEST_ASSERT_EQUAL(1, open_with_header(&header));
+    header = valid;
+    header.header_size = 0;
+    TEST_ASSERT_EQUAL(1, open_with_header(&header));
+    header = valid;
+    header.record_count++;
+    TEST_ASSERT_EQUAL(1, open_with_header(&header));
+    // Wraps around to a small size when multiplied
+    header = valid;
+    header.record_size = 1u << 31;
+    header.record_count = 1ull << 33;
+    TEST_ASSERT_EQUAL(1, open_with_header(&header));
+
+    TEST_ASSERT_EQUAL(0, open_with_header(&valid));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_file_describes_analysis);
+    RUN_TEST(test_harmony_loudness_and_constant_q_are_stored);
+    RUN_TEST(test_result_does_not_depend_on_threads);
+    RUN_TEST(test_frames_map_to_records);
+    RUN_TEST(test_invalid_files_are_rejected);
+    RUN_TEST(test_headers_pointing_outside_the_file_are_rejected);
+
+    return UNITY_END();
+}
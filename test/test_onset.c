@@ -0,0 +1,242 @@
+#include "analyze.h"
+#include "onset.h"
+#include "unity.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+Evaluates onset detection on synthetic drum tracks: kicks on beats 1 and 3,
+snares on beats 2 and 4 and hi-hats on every eighth note over steady
+background noise. The first bar is not scored, so that the normalization and
+the adaptive thresholds have settled. Each detection is matched to a hit of its
+band that started at most MATCH_TOLERANCE earlier. Unmatched detections count
+as false positives.
+*/
+
+#define SAMPLE_RATE 48000
+#define HOP_SIZE 512
+#define TEMPO 120
+#define BAR_COUNT 8
+// Background before the first hit, giving the adaptive thresholds history.
+#define LEAD_IN (SAMPLE_RATE / 2)
+#define MATCH_TOLERANCE (SAMPLE_RATE * 50 / 1000)
+#define EIGHTH_NOTE (SAMPLE_RATE * 60 / TEMPO / 2)
+#define TRACK_LENGTH (LEAD_IN + BAR_COUNT * 8 * EIGHTH_NOTE)
+#define WARM_UP (LEAD_IN + 8 * EIGHTH_NOTE)
+#define MAX_HITS (BAR_COUNT * 8)
+
+typedef struct {
+    size_t hits[MAX_HITS];
+    size_t hit_count;
+    int matched[MAX_HITS];
+    size_t detection_count;
+    size_t false_positives;
+    size_t latency_sum;
+    size_t latency_max;
+} BandScore;
+
+static float track[TRACK_LENGTH];
+static BandScore scores[ONSET_BAND_COUNT];
+static AudioMetrics metrics = {0};
+static uint32_t random_state = 1;
+
+void setUp(void) {
+    AnalyzeConfig config = {
+        .window = HANNING,
+        .input_size = DEFAULT_INPUT_SIZE,
+        .hop_size = HOP_SIZE,
+        .channels = 1,
+        .log_band_count = DEFAULT_LOG_BAND_COUNT,
+        .mel_band_count = DEFAULT_MEL_BAND_COUNT,
+    };
+    analyze_init(&config);
+    analyze_set_sample_rate(SAMPLE_RATE);
+    memset(track, 0, sizeof(track));
+    memset(scores, 0, sizeof(scores));
+    random_state = 1;
+}
+
+void tearDown(void) {
+    analyze_deinit();
+}
+
+static float noise(void) {
+    random_state = random_state * 1664525 + 1013904223;
+    return (float)random_state / UINT32_MAX * 2 - 1;
+}
+
+// Applies a band-pass biquad with center `frequency` to `count` samples.
+static void band_pass(float *samples, size_t count, float frequency, float q) {
+    float w = 2 * M_PI * frequency / SAMPLE_RATE;
+    float alpha = sinf(w) / (2 * q);
+    float a0 = 1 + alpha;
+    float b0 = alpha / a0, b2 = -alpha / a0;
+    float a1 = -2 * cosf(w) / a0, a2 = (1 - alpha) / a0;
+    float x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+    for (size_t i = 0; i < count; i++) {
+        float y = b0 * samples[i] + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1, x1 = samples[i];
+        y2 = y1, y1 = y;
+        samples[i] = y;
+    }
+}
+
+// Adds a drum hit of `band` to the track at `start`.
+static void add_hit(OnsetBand band, size_t start) {
+    static float hit[SAMPLE_RATE / 2];
+    const size_t length = sizeof(hit) / sizeof(float);
+
+    for (size_t i = 0; i < length; i++) {
+        float t = (float)i / SAMPLE_RATE;
+        switch (band) {
+        case ONSET_KICK:
+            // Pitch drops from 120 Hz to 50 Hz, with a 2 ms attack so that the
+            // kick has no click in the snare band
+            hit[i] = 0.8 * fminf(t / 0.002, 1) * expf(-t / 0.08) *
+                     sinf(2 * M_PI * (50 * t + 2.1 * (1 - expf(-t / 0.03))));
+            break;
+        case ONSET_SNARE:
+            hit[i] = 0.6 * expf(-t / 0.06) * noise();
+            break;
+        case ONSET_HAT:
+            hit[i] = 0.4 * expf(-t / 0.02) * noise();
+            break;
+        default:
+            break;
+        }
+    }
+    if (band == ONSET_SNARE) {
+        band_pass(hit, length, 1000, 0.7);
+        band_pass(hit, length, 1000, 0.7);
+    } else if (band == ONSET_HAT) {
+        band_pass(hit, length, 10000, 1.0);
+        band_pass(hit, length, 10000, 1.0);
+    }
+
+    for (size_t i = 0; i < length && start + i < TRACK_LENGTH; i++)
+        track[start + i] += hit[i];
+
+    BandScore *score = &scores[band];
+    if (start >= WARM_UP)
+        score->hits[score->hit_count++] = start;
+}
+
+static void create_drum_track(void) {
+    for (size_t i = 0; i < TRACK_LENGTH; i++)
+        track[i] = 0.01 * noise();
+
+    for (size_t eighth = 0; eighth < BAR_COUNT * 8; eighth++) {
+        size_t start = LEAD_IN + eighth * EIGHTH_NOTE;
+        add_hit(ONSET_HAT, start);
+        if (eighth % 4 == 0)
+            add_hit(ONSET_KICK, start);
+        else if (eighth % 4 == 2)
+            add_hit(ONSET_SNARE, start);
+    }
+}
+
+// Records a detection in `band` whose window ended at `position`.
+static void score_detection(OnsetBand band, size_t position) {
+    BandScore *score = &scores[band];
+    score->detection_count++;
+    for (size_t i = 0; i < score->hit_count; i++) {
+        if (score->matched[i] || position < score->hits[i] ||
+            position - score->hits[i] > MATCH_TOLERANCE)
+            continue;
+        size_t latency = position - score->hits[i];
+        score->matched[i] = 1;
+        score->latency_sum += latency;
+        if (score->latency_max < latency)
+            score->latency_max = latency;
+        return;
+    }
+    score->false_positives++;
+}
+
+// Feeds the track one hop at a time and scores onsets and beats.
+static void analyze_track(size_t *out_beats) {
+    *out_beats = 0;
+    for (size_t position = 0; position + HOP_SIZE <= TRACK_LENGTH;
+         position += HOP_SIZE) {
+        analyze_feed_frames(track + position, HOP_SIZE, 1);
+        uint32_t hops = analyze_get_metrics(&metrics);
+        analyze_drain_events(&metrics);
+        if (hops == 0 || position + HOP_SIZE < WARM_UP)
+            continue;
+        for (size_t band = 0; band < ONSET_BAND_COUNT; band++)
+            if (metrics.onsets[band] > 0)
+                score_detection(band, position + HOP_SIZE);
+        if (metrics.beat > 0)
+            (*out_beats)++;
+    }
+}
+
+static void report(const char *name, const BandScore *score) {
+    size_t matched = score->detection_count - score->false_positives;
+    char message[160];
+    snprintf(message, sizeof(message),
+             "%s: %zu/%zu hits detected, %zu false positives, "
+             "latency mean %.1f ms max %.1f ms",
+             name, matched, score->hit_count, score->false_positives,
+             matched ? 1000.0 * score->latency_sum / matched / SAMPLE_RATE : 0,
+             1000.0 * score->latency_max / SAMPLE_RATE);
+    TEST_MESSAGE(message);
+}
+
+void test_drum_track(void) {
+    static const char *names[ONSET_BAND_COUNT] = {"kick", "snare", "hat"};
+    size_t beats;
+
+    create_drum_track();
+    analyze_track(&beats);
+
+    for (size_t band = 0; band < ONSET_BAND_COUNT; band++) {
+        const BandScore *score = &scores[band];
+        size_t matched = score->detection_count - score->false_positives;
+        report(names[band], score);
+
+        TEST_ASSERT_GREATER_OR_EQUAL(score->hit_count * 95 / 100, matched);
+        TEST_ASSERT_LESS_OR_EQUAL(score->hit_count / 20,
+                                  score->false_positives);
+        // At most one hop of delay on average on top of the window
+        TEST_ASSERT_LESS_OR_EQUAL(2 * HOP_SIZE, score->latency_sum / matched);
+    }
+
+    // Beats follow the kick
+    TEST_ASSERT_EQUAL(scores[ONSET_KICK].detection_count, beats);
+}
+
+void test_steady_sound_has_no_onsets(void) {
+    for (size_t i = 0; i < TRACK_LENGTH; i++)
+        track[i] = 0.5 * sinf(2 * M_PI * 80 * i / SAMPLE_RATE) +
+                   0.2 * sinf(2 * M_PI * 1000 * i / SAMPLE_RATE) +
+                   0.05 * noise();
+    size_t beats;
+    analyze_track(&beats);
+
+    for (size_t band = 0; band < ONSET_BAND_COUNT; band++)
+        TEST_ASSERT_EQUAL(0, scores[band].detection_count);
+    TEST_ASSERT_EQUAL(0, beats);
+}
+
+void test_midi_beats_replace_kick_beats(void) {
+    analyze_set_beat_triggering_mode(1);
+    create_drum_track();
+    size_t beats;
+    analyze_track(&beats);
+    analyze_set_beat_triggering_mode(0);
+
+    TEST_ASSERT_EQUAL(0, beats);
+    TEST_ASSERT_TRUE(scores[ONSET_KICK].detection_count > 0);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_drum_track);
+    RUN_TEST(test_steady_sound_has_no_onsets);
+    RUN_TEST(test_midi_beats_replace_kick_beats);
+
+    return UNITY_END();
+}
@@ -0,0 +1,163 @@
+#include "analyze.h"
+#include "pcm_input.h"
+#include "unity.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 48000
+#define CHANNELS 2
+#define INPUT_SIZE 1024
+#define HOP_SIZE 512
+// Fits in the sample ring, so no hop is skipped.
+#define FRAME_COUNT 4096
+#define FREQUENCY 1000
+#define PATH "/tmp/muscini_test_pcm"
+
+static AudioMetrics metrics = {0};
+static float f32_frames[FRAME_COUNT * CHANNELS];
+static int16_t s16_frames[FRAME_COUNT * CHANNELS];
+
+void setUp(void) {
+    AnalyzeConfig config = {
+        .window = HANNING,
+        .input_size = INPUT_SIZE,
+        .hop_size = HOP_SIZE,
+        .channels = CHANNELS,
+        .log_band_count = DEFAULT_LOG_BAND_COUNT,
+        .mel_band_count = DEFAULT_MEL_BAND_COUNT,
+    };
+    analyze_init(&config);
+    for (size_t i = 0; i < FRAME_COUNT; i++) {
+        float value = 0.5f * sinf(2 * M_PI * FREQUENCY * i / SAMPLE_RATE);
+        for (size_t channel = 0; channel < CHANNELS; channel++) {
+            f32_frames[i * CHANNELS + channel] = value;
+            s16_frames[i * CHANNELS + channel] = value * 32767;
+        }
+    }
+    unlink(PATH);
+}
+
+void tearDown(void) {
+    pcm_input_deinit();
+    analyze_deinit();
+    unlink(PATH);
+}
+
+static void start(PcmFormat format) {
+    PcmConfig config = {
+        .path = PATH,
+        .format = format,
+        .channels = CHANNELS,
+        .sample_rate = SAMPLE_RATE,
+    };
+    TEST_ASSERT_EQUAL(0, pcm_input_init(&config));
+}
+
+// Analyzes hops until all frames have arrived, or a second has passed.
+static uint32_t analyze_all(void) {
+    uint32_t hops = 0;
+    for (int i = 0; i < 1000 && hops < FRAME_COUNT / HOP_SIZE; i++) {
+        hops += analyze_get_metrics(&metrics);
+        usleep(1000);
+    }
+    return hops;
+}
+
+static void assert_sine_analyzed(void) {
+    TEST_ASSERT_EQUAL(FRAME_COUNT / HOP_SIZE, analyze_all());
+    size_t loudest = 0;
+    for (size_t i = 0; i < metrics.frequency_count; i++)
+        if (metrics.frequencies[loudest] < metrics.frequencies[i])
+            loudest = i;
+    TEST_ASSERT_UINT_WITHIN(1, FREQUENCY * INPUT_SIZE / SAMPLE_RATE, loudest);
+}
+
+void test_s16_file_is_read_until_it_ends(void) {
+    PcmConfig missing = {.path = PATH, .channels = CHANNELS};
+    TEST_ASSERT_NOT_EQUAL(0, pcm_input_init(&missing));
+
+    FILE *file = fopen(PATH, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    fwrite(s16_frames, sizeof(s16_frames), 1, file);
+    fclose(file);
+
+    start(PCM_S16);
+    assert_sine_analyzed();
+    for (int i = 0; i < 1000 && !pcm_input_ended(); i++)
+        usleep(1000);
+    TEST_ASSERT_TRUE(pcm_input_ended());
+}
+
+void test_files_are_read_at_the_sample_rate(void) {
+    FILE *file = fopen(PATH, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    fwrite(f32_frames, sizeof(f32_frames), 1, file);
+    fclose(file);
+
+    const uint64_t begin = eventqueue_now();
+    start(PCM_F32);
+    for (int i = 0; i < 1000 && !pcm_input_ended(); i++)
+        usleep(1000);
+    TEST_ASSERT_TRUE(pcm_input_ended());
+    // Not sooner than the frames would have been captured
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT64(
+        (uint64_t)FRAME_COUNT * 1000000000 / SAMPLE_RATE,
+        eventqueue_now() - begin);
+}
+
+void test_fifo_frames_split_across_writes_are_joined(void) {
+    TEST_ASSERT_EQUAL(0, mkfifo(PATH, 0600));
+    start(PCM_F32);
+    int fifo = open(PATH, O_WRONLY);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fifo);
+
+    // Writes that end in the middle of samples
+    const char *bytes = (const char *)f32_frames;
+    for (size_t offset = 0; offset < sizeof(f32_frames); offset += 1003) {
+        size_t length = sizeof(f32_frames) - offset;
+        TEST_ASSERT_EQUAL(length < 1003 ? length : 1003,
+                          write(fifo, bytes + offset,
+                                length < 1003 ? length : 1003));
+        usleep(100);
+    }
+    assert_sine_analyzed();
+    // Writers come and go without ending the FIFO
+    close(fifo);
+    usleep(10000);
+    TEST_ASSERT_FALSE(pcm_input_ended());
+}
+
+void test_socket_is_read(void) {
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    strcpy(address.sun_path, PATH);
+    TEST_ASSERT_EQUAL(
+        0, bind(server, (struct sockaddr *)&address, sizeof(address)));
+    TEST_ASSERT_EQUAL(0, listen(server, 1));
+
+    start(PCM_F32);
+    int connection = accept(server, 0, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, connection);
+    TEST_ASSERT_EQUAL(sizeof(f32_frames),
+                      write(connection, f32_frames, sizeof(f32_frames)));
+    assert_sine_analyzed();
+
+    close(connection);
+    close(server);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_s16_file_is_read_until_it_ends);
+    RUN_TEST(test_files_are_read_at_the_sample_rate);
+    RUN_TEST(test_fifo_frames_split_across_writes_are_joined);
+    RUN_TEST(test_socket_is_read);
+    return UNITY_END();
+}
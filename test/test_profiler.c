@@ -0,0 +1,178 @@
+#include "profiler.h"
+#include "unity.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TRACE_PATH "/tmp/muscini_test_profiler.json"
+#define WORKER_SCOPES 1000
+#define SHORT_NAME "short"
+#define LONG_NAME "a scope with a long name"
+
+static _Atomic int recording;
+
+void setUp(void) {}
+
+void tearDown(void) {
+    profiler_enable(0);
+    unlink(TRACE_PATH);
+}
+
+static void *worker(void *arg) {
+    profiler_set_thread_name("worker");
+    for (size_t i = 0; i < WORKER_SCOPES; i++) {
+        PROFILE_SCOPE("work with a long name that is cut");
+    }
+    (void)arg;
+    return 0;
+}
+
+static char *read_trace(void) {
+    FILE *file = fopen(TRACE_PATH, "r");
+    TEST_ASSERT_NOT_NULL(file);
+    // Room for the full rings of a few threads
+    static char text[1 << 24];
+    size_t length = fread(text, 1, sizeof(text) - 1, file);
+    text[length] = 0;
+    fclose(file);
+    return text;
+}
+
+static size_t count(const char *text, const char *pattern) {
+    size_t found = 0;
+    for (const char *at = strstr(text, pattern); at;
+         at = strstr(at + 1, pattern))
+        found++;
+    return found;
+}
+
+void test_nothing_is_recorded_while_disabled(void) {
+    TEST_ASSERT_EQUAL(0, profiler_begin());
+    {
+        PROFILE_SCOPE("disabled");
+    }
+    TEST_ASSERT_EQUAL(0, profiler_write_trace(TRACE_PATH));
+    TEST_ASSERT_EQUAL(0, count(read_trace(), "disabled"));
+}
+
+void test_threads_are_written_to_trace(void) {
+    profiler_enable(1);
+    profiler_set_thread_name("main");
+    {
+        PROFILE_SCOPE("outer");
+        PROFILE_SCOPE("inner");
+    }
+
+    pthread_t threads[2];
+    for (size_t i = 0; i < 2; i++)
+        pthread_create(threads + i, 0, worker, 0);
+    for (size_t i = 0; i < 2; i++)
+        pthread_join(threads[i], 0);
+
+    TEST_ASSERT_EQUAL(0, profiler_write_trace(TRACE_PATH));
+    char *trace = read_trace();
+    TEST_ASSERT_EQUAL(1, count(trace, "\"outer\""));
+    TEST_ASSERT_EQUAL(1, count(trace, "\"inner\""));
+    TEST_ASSERT_EQUAL(2 * WORKER_SCOPES,
+                      count(trace, "\"work with a long name t\""));
+    TEST_ASSERT_EQUAL(1, count(trace, "{\"name\": \"main\"}"));
+    TEST_ASSERT_EQUAL(2, count(trace, "{\"name\": \"worker\"}"));
+    TEST_ASSERT_EQUAL(2 + 2 * WORKER_SCOPES, count(trace, "\"ph\": \"X\""));
+    TEST_ASSERT_EQUAL_STRING("\n]}\n", trace + strlen(trace) - 4);
+}
+
+void test_stages_are_summed_per_frame(void) {
+    profiler_enable(1);
+    profiler_end_frame();
+
+    for (size_t i = 0; i < 2; i++) {
+        uint64_t begin = profiler_begin();
+        usleep(2000);
+        profiler_end_stage(PROFILE_ANALYSIS, begin);
+    }
+    uint64_t begin = profiler_begin();
+    usleep(1000);
+    profiler_end_stage(PROFILE_SCENE, begin);
+    profiler_end_frame();
+
+    float stages[PROFILE_STAGE_COUNT];
+    float frame;
+    TEST_ASSERT_EQUAL(0, profiler_frame(0, stages, &frame));
+    TEST_ASSERT_FLOAT_WITHIN(1.5, 4, stages[PROFILE_ANALYSIS]);
+    TEST_ASSERT_FLOAT_WITHIN(1, 1, stages[PROFILE_SCENE]);
+    TEST_ASSERT_EQUAL_FLOAT(0, stages[PROFILE_PRESENT]);
+    TEST_ASSERT_TRUE(frame >= stages[PROFILE_ANALYSIS] +
+                                  stages[PROFILE_SCENE]);
+    TEST_ASSERT_EQUAL(1, profiler_frame(PROFILER_HISTORY, stages, &frame));
+}
+
+static void *busy_worker(void *arg) {
+    profiler_register_thread("busy");
+    for (uint64_t i = 0; atomic_load(&recording); i++)
+        profiler_end(i % 2 ? SHORT_NAME : LONG_NAME, profiler_begin());
+    (void)arg;
+    return 0;
+}
+
+void test_trace_written_while_recording_has_whole_scopes(void) {
+    // Those of the previous tests
+    TEST_ASSERT_EQUAL(0, profiler_write_trace(TRACE_PATH));
+    const size_t earlier_scopes = count(read_trace(), "\"ph\": \"X\"");
+
+    profiler_enable(1);
+    atomic_store(&recording, 1);
+    pthread_t thread;
+    pthread_create(&thread, 0, busy_worker, 0);
+    // Until the ring has wrapped around
+    usleep(100000);
+    TEST_ASSERT_EQUAL(0, profiler_write_trace(TRACE_PATH));
+    atomic_store(&recording, 0);
+    pthread_join(thread, 0);
+
+    char *text = read_trace();
+    size_t scopes = count(text, "\"ph\": \"X\"") - earlier_scopes;
+    size_t whole = count(text, "\"" SHORT_NAME "\"") +
+                   count(text, "\"a scope with a long nam\"");
+    TEST_ASSERT_GREATER_THAN(0, scopes);
+    TEST_ASSERT_EQUAL(scopes, whole);
+}
+
+static void *reconnected_worker(void *arg) {
+    profiler_register_thread("reconnected");
+    {
+        PROFILE_SCOPE("after reconnect");
+    }
+    (void)arg;
+    return 0;
+}
+
+void test_threads_registered_again_reuse_their_ring(void) {
+    profiler_enable(1);
+    for (size_t i = 0; i < PROFILER_MAX_THREADS + 2; i++) {
+        pthread_t thread;
+        pthread_create(&thread, 0, reconnected_worker, 0);
+        pthread_join(thread, 0);
+    }
+
+    TEST_ASSERT_EQUAL(0, profiler_write_trace(TRACE_PATH));
+    char *trace = read_trace();
+    TEST_ASSERT_EQUAL(PROFILER_MAX_THREADS + 2,
+                      count(trace, "\"after reconnect\""));
+    TEST_ASSERT_EQUAL(1, count(trace, "{\"name\": \"reconnected\"}"));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_nothing_is_recorded_while_disabled);
+    RUN_TEST(test_threads_are_written_to_trace);
+    RUN_TEST(test_stages_are_summed_per_frame);
+    RUN_TEST(test_trace_written_while_recording_has_whole_scopes);
+    RUN_TEST(test_threads_registered_again_reuse_their_ring);
+
+    return UNITY_END();
+}
@@ -0,0 +1,194 @@
+#include "sample_ring.h"
+#include "unity.h"
+#include <pthread.h>
+
+static SampleRing ring = {0};
+
+void setUp(void) {
+    TEST_ASSERT_EQUAL(0, samplering_init(&ring, 12, 1));
+}
+
+void tearDown(void) {
+    samplering_free(&ring);
+}
+
+void test_capacity_rounded_to_power_of_two(void) {
+    TEST_ASSERT_EQUAL(16, ring.capacity);
+}
+
+void test_snapshot_zero_fills_unwritten(void) {
+    float samples[] = {1, 2, 3};
+    samplering_write(&ring, samples, 3, 1, 0);
+
+    float out[5] = {-1, -1, -1, -1, -1};
+    TEST_ASSERT_EQUAL(3, samplering_snapshot(&ring, out, 5));
+
+    float expected[] = {0, 0, 1, 2, 3};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected, out, 5);
+}
+
+void test_snapshot_is_chronological_after_wrap(void) {
+    float samples[40];
+    for (size_t i = 0; i < 40; i++)
+        samples[i] = i;
+    samplering_write(&ring, samples, 13, 1, 0);
+    samplering_write(&ring, samples + 13, 27, 1, 0);
+
+    float out[10];
+    TEST_ASSERT_EQUAL(40, samplering_snapshot(&ring, out, 10));
+    for (size_t i = 0; i < 10; i++)
+        TEST_ASSERT_EQUAL_FLOAT(30 + i, out[i]);
+}
+
+void test_write_with_stride_takes_first_channel(void) {
+    float frames[] = {1, -1, 2, -2, 3, -3};
+    samplering_write(&ring, frames, 3, 2, 0);
+
+    float out[3];
+    samplering_snapshot(&ring, out, 3);
+    float expected[] = {1, 2, 3};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected, out, 3);
+}
+
+void test_multichannel_frames_stay_interleaved(void) {
+    SampleRing stereo = {0};
+    TEST_ASSERT_EQUAL(0, samplering_init(&stereo, 4, 2));
+
+    // Three channels in, of which the first two are kept
+    float frames[] = {1, -1, 9, 2, -2, 9, 3, -3, 9, 4, -4, 9, 5, -5, 9};
+    samplering_write(&stereo, frames, 5, 3, 0);
+
+    float out[6];
+    TEST_ASSERT_EQUAL(5, samplering_snapshot(&stereo, out, 3));
+    float expected[] = {3, -3, 4, -4, 5, -5};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected, out, 6);
+
+    // Contiguous writes wrap around the end of the ring
+    float more[] = {6, -6, 7, -7};
+    samplering_write(&stereo, more, 2, 2, 0);
+    TEST_ASSERT_EQUAL(7, samplering_snapshot(&stereo, out, 3));
+    float expected_wrapped[] = {5, -5, 6, -6, 7, -7};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected_wrapped, out, 6);
+
+    samplering_free(&stereo);
+}
+
+void test_read_at_position(void) {
+    float samples[20];
+    for (size_t i = 0; i < 20; i++)
+        samples[i] = i;
+    samplering_write(&ring, samples, 20, 1, 0);
+
+    float out[4];
+    TEST_ASSERT_EQUAL(0, samplering_read(&ring, out, 10, 4));
+    float expected[] = {6, 7, 8, 9};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected, out, 4);
+
+    // Position 2 has already been overwritten by position 18
+    TEST_ASSERT_NOT_EQUAL(0, samplering_read(&ring, out, 4, 4));
+}
+
+void test_write_in_place_stops_at_wrap(void) {
+    float samples[12] = {0};
+    samplering_write(&ring, samples, 12, 1, 0);
+
+    size_t count = 8;
+    float *target = samplering_write_begin(&ring, &count);
+    TEST_ASSERT_EQUAL(4, count);
+    for (size_t i = 0; i < count; i++)
+        target[i] = i + 1;
+    // Only the frames kept are written, and the rest can be announced again
+    samplering_write_commit(&ring, 3, 7);
+
+    uint64_t time = 0;
+    TEST_ASSERT_EQUAL(15, samplering_written_at(&ring, &time));
+    TEST_ASSERT_EQUAL(7, time);
+    float out[3];
+    samplering_snapshot(&ring, out, 3);
+    float expected[] = {1, 2, 3};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected, out, 3);
+
+    count = 8;
+    TEST_ASSERT_EQUAL_PTR(target + 3, samplering_write_begin(&ring, &count));
+    TEST_ASSERT_EQUAL(1, count);
+    samplering_write_commit(&ring, 0, 8);
+    TEST_ASSERT_EQUAL(15, samplering_written_at(&ring, &time));
+    TEST_ASSERT_EQUAL(7, time);
+}
+
+void test_written_at_does_not_wait_for_write_in_place(void) {
+    float samples[4] = {0};
+    samplering_write(&ring, samples, 4, 1, 3);
+
+    // As if the producer was blocked reading the frames
+    size_t count = 4;
+    samplering_write_begin(&ring, &count);
+    uint64_t time = 0;
+    TEST_ASSERT_EQUAL(4, samplering_written_at(&ring, &time));
+    TEST_ASSERT_EQUAL(3, time);
+
+    samplering_write_commit(&ring, 2, 5);
+    TEST_ASSERT_EQUAL(6, samplering_written_at(&ring, &time));
+    TEST_ASSERT_EQUAL(5, time);
+}
+
+static _Atomic int producer_done = 0;
+
+static void *produce_ramp(void *arg) {
+    SampleRing *shared = arg;
+    float block[64];
+    float value = 0;
+    for (size_t i = 0; i < 20000; i++) {
+        for (size_t j = 0; j < 64; j++)
+            block[j] = value++;
+        // Stamp each write with its end position to check consistency
+        samplering_write(shared, block, 64, 1, (i + 1) * 64);
+    }
+    producer_done = 1;
+    return 0;
+}
+
+void test_concurrent_snapshots_and_times_are_never_torn(void) {
+    SampleRing shared = {0};
+    TEST_ASSERT_EQUAL(0, samplering_init(&shared, 4096, 1));
+
+    pthread_t producer;
+    pthread_create(&producer, 0, produce_ramp, &shared);
+
+    float window[1024];
+    size_t torn = 0;
+    while (!producer_done) {
+        uint64_t end = samplering_snapshot(&shared, window, 1024);
+        if (end < 1024)
+            continue;
+        for (size_t i = 1; i < 1024; i++)
+            if (window[i] != window[i - 1] + 1)
+                torn++;
+        if (window[1023] != (float)(end - 1))
+            torn++;
+
+        uint64_t time;
+        if (samplering_written_at(&shared, &time) != time)
+            torn++;
+    }
+
+    pthread_join(producer, 0);
+    samplering_free(&shared);
+    TEST_ASSERT_EQUAL(0, torn);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_capacity_rounded_to_power_of_two);
+    RUN_TEST(test_snapshot_zero_fills_unwritten);
+    RUN_TEST(test_snapshot_is_chronological_after_wrap);
+    RUN_TEST(test_write_with_stride_takes_first_channel);
+    RUN_TEST(test_multichannel_frames_stay_interleaved);
+    RUN_TEST(test_read_at_position);
+    RUN_TEST(test_write_in_place_stops_at_wrap);
+    RUN_TEST(test_written_at_does_not_wait_for_write_in_place);
+    RUN_TEST(test_concurrent_snapshots_and_times_are_never_torn);
+
+    return UNITY_END();
+}
@@ -0,0 +1,48 @@
+#include "triple_buffer.h"
+#include "unity.h"
+
+static int a, b, c;
+static TripleBuffer buffer = {0};
+
+void setUp(void) {
+    a = b = c = 0;
+    triplebuffer_init(&buffer, &a, &b, &c);
+}
+
+void tearDown(void) {}
+
+void test_front_is_stable_without_publish(void) {
+    int *front = triplebuffer_front(&buffer);
+    TEST_ASSERT_EQUAL_PTR(front, triplebuffer_front(&buffer));
+    TEST_ASSERT_NOT_EQUAL(front, triplebuffer_back(&buffer));
+}
+
+void test_consumer_gets_latest_published(void) {
+    for (int i = 1; i <= 3; i++) {
+        *(int *)triplebuffer_back(&buffer) = i;
+        triplebuffer_publish(&buffer);
+    }
+    TEST_ASSERT_EQUAL(3, *(int *)triplebuffer_front(&buffer));
+    TEST_ASSERT_EQUAL(3, *(int *)triplebuffer_front(&buffer));
+}
+
+void test_back_and_front_never_alias(void) {
+    for (int i = 0; i < 10; i++) {
+        *(int *)triplebuffer_back(&buffer) = i;
+        triplebuffer_publish(&buffer);
+        if (i % 3 == 0)
+            triplebuffer_front(&buffer);
+        TEST_ASSERT_NOT_EQUAL(triplebuffer_back(&buffer),
+                              buffer.buffers[buffer.front]);
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_front_is_stable_without_publish);
+    RUN_TEST(test_consumer_gets_latest_published);
+    RUN_TEST(test_back_and_front_never_alias);
+
+    return UNITY_END();
+}
@@ -0,0 +1,491 @@
+/*
+muscini-bench-scene: renders a scene shared object for a number of frames in a
+hidden window and reports what each call of its scene_update costs, so that
+scenes can be checked against the frame budget without a display or GPU (e.g.
+under Mesa llvmpipe).
+
+The scene is loaded through scenes.c like in muscini. It is fed metrics
+analyzed from a synthetic drum loop, or read from a feature file made with
+`muscini --analyze`.
+
+This executable is linked with -rdynamic and defines the rlgl draw functions,
+the raylib shader uniform functions, and malloc() and friends, itself. The
+references to them from the scene, and from within a shared raylib, resolve
+here first, so they are counted before being forwarded to raylib and libc.
+Draw calls are counted where they reach the GPU: at each flush of the rlgl
+batch, which all shapes, text and immediate mode geometry go through, and at
+each draw of a mesh's own vertex arrays.
+
+The hidden window still needs a display server. Without one, e.g. on CI, run
+the benchmark under Xvfb with `xvfb-run -a`.
+*/
+
+#define _GNU_SOURCE
+
+#include "analyzer.h"
+#include "clargs.h"
+#include "feature_file.h"
+#include "scenes.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <raylib.h>
+#include <rlgl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_FRAMES 600
+#define DEFAULT_RATE 60
+#define DEFAULT_WIDTH 1280
+#define DEFAULT_HEIGHT 720
+// Frames rendered before measuring, the first of which loads the scene.
+#define WARMUP_FRAMES 10
+#define SAMPLE_RATE 48000
+// Length of the synthetic loop: one bar at 120 BPM.
+#define LOOP_FRAMES (SAMPLE_RATE * 2)
+
+typedef enum {
+    COUNTER_DRAWS = 0,
+    COUNTER_UNIFORMS,
+    COUNTER_TEXTURE_UPLOADS,
+    COUNTER_ALLOCATIONS,
+    COUNTER_ALLOCATED_BYTES,
+    COUNTER_COUNT,
+} Counter;
+
+static const char *counter_names[COUNTER_COUNT] = {
+    [COUNTER_DRAWS] = "draw calls",
+    [COUNTER_UNIFORMS] = "uniform uploads",
+    [COUNTER_TEXTURE_UPLOADS] = "texture uploads",
+    [COUNTER_ALLOCATIONS] = "allocations",
+    [COUNTER_ALLOCATED_BYTES] = "allocated bytes",
+};
+
+// Counts of the current frame. Only calls on the render thread while the scene
+// is updating are counted, not those of e.g. the threads of llvmpipe.
+static uint64_t counters[COUNTER_COUNT];
+static _Thread_local int counting = 0;
+
+// --- Counting wrappers ---
+
+// The function `name` of the library after this executable.
+static void *next_function(const char *name) {
+    void *function = dlsym(RTLD_NEXT, name);
+    if (!function) {
+        fprintf(stderr, "ERROR: %s not found, raylib must be a shared "
+                        "library.\n",
+                name);
+        abort();
+    }
+    return function;
+}
+
+// Defines raylib function `name`, which counts into `counter` and calls the
+// real one.
+#define COUNTED(counter, name, parameters, arguments)                          \
+    void name parameters {                                                     \
+        static void(*real) parameters = 0;                                    \
+        if (!real)                                                             \
+            *(void **)&real = next_function(#name);                            \
+        if (counting)                                                          \
+            counters[counter]++;                                               \
+        real arguments;                                                        \
+    }
+
+// Issues one draw call for each of the draws in `batch` with vertices.
+void rlDrawRenderBatch(rlRenderBatch *batch) {
+    static void (*real)(rlRenderBatch *) = 0;
+    if (!real)
+        *(void **)&real = next_function("rlDrawRenderBatch");
+    if (counting)
+        for (int i = 0; i < batch->drawCounter; i++)
+            counters[COUNTER_DRAWS] += batch->draws[i].vertexCount > 0;
+    real(batch);
+}
+
+COUNTED(COUNTER_DRAWS, rlDrawVertexArray, (int offset, int count),
+        (offset, count))
+COUNTED(COUNTER_DRAWS, rlDrawVertexArrayElements,
+        (int offset, int count, const void *buffer), (offset, count, buffer))
+COUNTED(COUNTER_DRAWS, rlDrawVertexArrayInstanced,
+        (int offset, int count, int instances), (offset, count, instances))
+COUNTED(COUNTER_DRAWS, rlDrawVertexArrayElementsInstanced,
+        (int offset, int count, const void *buffer, int instances),
+        (offset, count, buffer, instances))
+
+COUNTED(COUNTER_UNIFORMS, SetShaderValue,
+        (Shader s, int location, const void *value, int type),
+        (s, location, value, type))
+COUNTED(COUNTER_UNIFORMS, SetShaderValueV,
+        (Shader s, int location, const void *value, int type, int count),
+        (s, location, value, type, count))
+COUNTED(COUNTER_UNIFORMS, SetShaderValueMatrix,
+        (Shader s, int location, Matrix m), (s, location, m))
+COUNTED(COUNTER_UNIFORMS, SetShaderValueTexture,
+        (Shader s, int location, Texture2D t), (s, location, t))
+
+COUNTED(COUNTER_TEXTURE_UPLOADS, UpdateTexture,
+        (Texture2D t, const void *pixels), (t, pixels))
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *pointer);
+
+static inline void count_allocation(size_t size) {
+    if (counting) {
+        counters[COUNTER_ALLOCATIONS]++;
+        counters[COUNTER_ALLOCATED_BYTES] += size;
+    }
+}
+
+void *malloc(size_t size) {
+    count_allocation(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    count_allocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    count_allocation(size);
+    return __libc_realloc(pointer, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    count_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    count_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **out_pointer, size_t alignment, size_t size) {
+    if (alignment < sizeof(void *) || alignment & (alignment - 1))
+        return EINVAL;
+    count_allocation(size);
+    void *pointer = __libc_memalign(alignment, size);
+    if (!pointer)
+        return ENOMEM;
+    *out_pointer = pointer;
+    return 0;
+}
+
+void free(void *pointer) {
+    __libc_free(pointer);
+}
+
+// --- Metrics ---
+
+typedef struct {
+    // Synthetic source
+    Analyzer analyzer;
+    float *loop;
+    uint32_t window_end;
+    // Recorded source, used if `features.header` is set
+    FeatureFile features;
+
+    uint32_t frames_per_update;
+} MetricsSource;
+
+// Fills `loop` with a stereo bar of kicks, snares on the backbeat, eighth note
+// hats and a sustained chord.
+static void create_loop(float *loop) {
+    srand(1);
+    for (size_t i = 0; i < LOOP_FRAMES; i++) {
+        float t = (float)i / SAMPLE_RATE;
+        float beat = fmodf(t, 0.5);
+        float eighth = fmodf(t, 0.25);
+        int backbeat = (int)(t / 0.5) % 2;
+        float noise = rand() / (float)RAND_MAX - 0.5;
+
+        float kick = sinf(2 * M_PI * (50 + 100 * expf(-beat * 30)) * beat) *
+                     expf(-beat * 12);
+        float snare = backbeat ? noise * expf(-beat * 20) : 0;
+        float hat = noise * expf(-eighth * 80) * 0.3;
+        float chord = 0.1 * (sinf(2 * M_PI * 220 * t) +
+                             sinf(2 * M_PI * 277.2 * t) +
+                             sinf(2 * M_PI * 329.6 * t));
+
+        loop[i * 2] = 0.6 * kick + 0.4 * snare + hat + chord;
+        loop[i * 2 + 1] = 0.6 * kick + 0.4 * snare - hat + chord;
+    }
+}
+
+static void add_onset_events(AudioMetrics *metrics) {
+    metrics->event_count = 0;
+    metrics->beat = 0;
+    for (uint8_t band = 0; band < ONSET_BAND_COUNT; band++) {
+        if (metrics->onsets[band] <= 0)
+            continue;
+        int beat = band == ONSET_KICK;
+        if (beat)
+            metrics->beat = 1;
+        metrics->events[metrics->event_count++] = (FrameEvent){
+            .type = EVENT_ONSET,
+            .note = band,
+            .velocity = 1 + metrics->onsets[band] * 126,
+            .beat = beat,
+        };
+    }
+}
+
+static void next_metrics(MetricsSource *source, uint64_t update,
+                         AudioMetrics *metrics) {
+    if (source->features.header) {
+        const FeatureHeader *header = source->features.header;
+        uint64_t frame = (update + 1) * source->frames_per_update;
+        uint64_t index;
+        if (featurefile_record_at(&source->features,
+                                  frame % header->frame_count, &index))
+            index = 0;
+        featurefile_read_metrics(&source->features, index, metrics);
+    } else {
+        // Windows never wrap around the end of the loop
+        const uint32_t input_size = source->analyzer.input_size;
+        source->window_end += source->frames_per_update;
+        if (source->window_end > LOOP_FRAMES)
+            source->window_end = input_size;
+        float strengths[ONSET_BAND_COUNT];
+        memset(metrics->onsets, 0, sizeof(metrics->onsets));
+        analyzer_process(&source->analyzer,
+                         source->loop + (source->window_end - input_size) * 2,
+                         metrics, strengths);
+    }
+    add_onset_events(metrics);
+}
+
+// --- Report ---
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, size_t count, double p) {
+    return sorted[(size_t)(p / 100 * (count - 1) + 0.5)];
+}
+
+static double now(clockid_t clock) {
+    struct timespec time;
+    clock_gettime(clock, &time);
+    return time.tv_sec * 1e3 + time.tv_nsec / 1e6;
+}
+
+int main(int argc, char **argv) {
+    char *scene = 0;
+    char *frames_arg = 0;
+    char *rate_arg = 0;
+    char *width_arg = 0;
+    char *height_arg = 0;
+    char *features_path = 0;
+    char *budget_arg = 0;
+    char *json_path = 0;
+
+    CLARG {
+        help("Usage: muscini-bench-scene [scene file]\n\n\
+Renders a scene in a hidden window and reports the cost of each call of its\n\
+scene_update.\n\n\
+Options:\n\
+--help, -h\t\tPrint this message and exit.\n\
+-n [frames]\t\tAmount of measured frames (default 600).\n\
+--rate [fps]\t\tFrame rate the metrics advance at (default 60).\n\
+--width [pixels]\tWidth of the window (default 1280).\n\
+--height [pixels]\tHeight of the window (default 720).\n\
+--features [file]\tFeed metrics from a feature file made with --analyze\n\
+\t\t\tinstead of a synthetic drum loop.\n\
+--budget [ms]\t\tExit with an error if the 99th percentile CPU time of\n\
+\t\t\tscene_update exceeds this.\n\
+--json [file]\t\tAlso write the results into a file as JSON.\n\n");
+
+        flag_value(frames_arg, "-n");
+        flag_value(rate_arg, "--rate");
+        flag_value(width_arg, "--width");
+        flag_value(height_arg, "--height");
+        flag_value(features_path, "--features");
+        flag_value(budget_arg, "--budget");
+        flag_value(json_path, "--json");
+
+        file(scene);
+    }
+
+    if (!scene) {
+        fprintf(stderr, "Usage: muscini-bench-scene [scene file]\n\
+Use --help for more information.\n");
+        return 1;
+    }
+
+    const uint32_t frame_count =
+        frames_arg ? strtol(frames_arg, 0, 10) : DEFAULT_FRAMES;
+    const uint32_t rate = rate_arg ? strtol(rate_arg, 0, 10) : DEFAULT_RATE;
+    if (frame_count < 1 || rate < 1) {
+        fprintf(stderr, "ERROR: frame count and rate must be positive.\n");
+        return 1;
+    }
+
+    static AudioMetrics metrics;
+    MetricsSource source = {0};
+    if (features_path) {
+        if (featurefile_open(&source.features, features_path)) {
+            fprintf(stderr, "ERROR: could not read feature file '%s'.\n",
+                    features_path);
+            return 1;
+        }
+        source.frames_per_update = source.features.header->sample_rate / rate;
+    } else {
+        AnalyzeConfig config = {
+            .window = HANNING,
+            .input_size = MIN_INPUT_SIZE,
+            .hop_size = SAMPLE_RATE / rate,
+            .channels = 2,
+            .log_band_count = DEFAULT_LOG_BAND_COUNT,
+            .mel_band_count = DEFAULT_MEL_BAND_COUNT,
+        };
+        while (config.input_size < config.hop_size)
+            config.input_size *= 2;
+        if (config.input_size > MAX_INPUT_SIZE) {
+            fprintf(stderr, "ERROR: rate must be at least %d.\n",
+                    SAMPLE_RATE / MAX_INPUT_SIZE + 1);
+            return 1;
+        }
+        source.loop = malloc(LOOP_FRAMES * 2 * sizeof(float));
+        if (!source.loop)
+            abort();
+        create_loop(source.loop);
+        if (analyzer_init(&source.analyzer, &config, SAMPLE_RATE))
+            return 1;
+        source.window_end = config.input_size;
+        source.frames_per_update = config.hop_size;
+    }
+
+    SetTraceLogLevel(LOG_WARNING);
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(width_arg ? strtol(width_arg, 0, 10) : DEFAULT_WIDTH,
+               height_arg ? strtol(height_arg, 0, 10) : DEFAULT_HEIGHT,
+               "muscini-bench-scene");
+    if (!IsWindowReady()) {
+        fprintf(stderr, "ERROR: could not open a window. Without a display, "
+                        "run under Xvfb with 'xvfb-run -a'.\n");
+        return 1;
+    }
+    SetTargetFPS(0);
+
+    scenes_init();
+    size_t scene_index = scenes_add(scene);
+
+    double *cpu_times = malloc(frame_count * sizeof(double));
+    double *wall_times = malloc(frame_count * sizeof(double));
+    uint64_t(*frame_counters)[COUNTER_COUNT] =
+        malloc(frame_count * sizeof(*frame_counters));
+    if (!cpu_times || !wall_times || !frame_counters)
+        abort();
+
+    for (uint64_t update = 0; update < WARMUP_FRAMES + frame_count;
+         update++) {
+        next_metrics(&source, update, &metrics);
+
+        memset(counters, 0, sizeof(counters));
+        double cpu_start = now(CLOCK_THREAD_CPUTIME_ID);
+        double wall_start = now(CLOCK_MONOTONIC);
+        counting = 1;
+        BeginDrawing();
+        scenes_update_current(&metrics);
+        EndDrawing();
+        counting = 0;
+
+        if (update == 0 && !scenes_loaded(scene_index)) {
+            fprintf(stderr, "ERROR: could not load scene '%s'.\n", scene);
+            return 1;
+        }
+        if (update < WARMUP_FRAMES)
+            continue;
+        size_t frame = update - WARMUP_FRAMES;
+        cpu_times[frame] = now(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+        wall_times[frame] = now(CLOCK_MONOTONIC) - wall_start;
+        memcpy(frame_counters[frame], counters, sizeof(counters));
+    }
+
+    double counter_means[COUNTER_COUNT] = {0};
+    uint64_t counter_maxima[COUNTER_COUNT] = {0};
+    for (size_t frame = 0; frame < frame_count; frame++) {
+        for (size_t i = 0; i < COUNTER_COUNT; i++) {
+            counter_means[i] += (double)frame_counters[frame][i] / frame_count;
+            if (counter_maxima[i] < frame_counters[frame][i])
+                counter_maxima[i] = frame_counters[frame][i];
+        }
+    }
+    qsort(cpu_times, frame_count, sizeof(double), compare_doubles);
+    qsort(wall_times, frame_count, sizeof(double), compare_doubles);
+
+    const double *times[2] = {cpu_times, wall_times};
+    const char *time_names[2] = {"cpu", "wall"};
+    printf("%s: %u frames at %dx%d\n", scene, frame_count, GetScreenWidth(),
+           GetScreenHeight());
+    for (size_t t = 0; t < 2; t++)
+        printf("  %-16s p50 %8.3f  p95 %8.3f  p99 %8.3f  max %8.3f ms\n",
+               time_names[t], percentile(times[t], frame_count, 50),
+               percentile(times[t], frame_count, 95),
+               percentile(times[t], frame_count, 99),
+               times[t][frame_count - 1]);
+    for (size_t i = 0; i < COUNTER_COUNT; i++)
+        printf("  %-16s mean %10.2f  max %10" PRIu64 " per frame\n",
+               counter_names[i], counter_means[i], counter_maxima[i]);
+
+    FILE *json = json_path ? fopen(json_path, "w") : 0;
+    if (json_path && !json)
+        fprintf(stderr, "ERROR: could not open '%s'.\n", json_path);
+    if (json) {
+        fprintf(json, "{\"scene\": \"%s\", \"frames\": %u", scene,
+                frame_count);
+        for (size_t t = 0; t < 2; t++)
+            fprintf(json,
+                    ", \"%s_ms\": {\"p50\": %.4f, \"p95\": %.4f, "
+                    "\"p99\": %.4f, \"max\": %.4f}",
+                    time_names[t], percentile(times[t], frame_count, 50),
+                    percentile(times[t], frame_count, 95),
+                    percentile(times[t], frame_count, 99),
+                    times[t][frame_count - 1]);
+        for (size_t i = 0; i < COUNTER_COUNT; i++) {
+            fprintf(json, ", \"");
+            for (const char *c = counter_names[i]; *c; c++)
+                fputc(*c == ' ' ? '_' : *c, json);
+            fprintf(json, "\": {\"mean\": %.2f, \"max\": %" PRIu64 "}",
+                    counter_means[i], counter_maxima[i]);
+        }
+        fprintf(json, "}\n");
+        fclose(json);
+    }
+
+    int result = 0;
+    double p99 = percentile(cpu_times, frame_count, 99);
+    if (budget_arg && p99 > strtod(budget_arg, 0)) {
+        fprintf(stderr,
+                "ERROR: 99th percentile CPU time %.3f ms exceeds the budget of "
+                "%s ms.\n",
+                p99, budget_arg);
+        result = 1;
+    }
+
+    scenes_deinit();
+    CloseWindow();
+    if (source.features.header)
+        featurefile_close(&source.features);
+    else {
+        analyzer_free(&source.analyzer);
+        free(source.loop);
+    }
+    free(cpu_times);
+    free(wall_times);
+    free(frame_counters);
+    return result;
+}